@@ -0,0 +1,447 @@
+/**
+ * Throughput of process_file_content on synthetic templates. Workloads vary
+ * one axis at a time around a base workload: template size, key count, hit
+ * density, count and nesting of meta blocks, and ANSI vs UTF-16 encoding.
+ * Rendering of one template by chunks is measured on the largest size by
+ * count of threads.
+ * For each workload wall time and peak resident memory of phases (load,
+ * meta, replace, write) are reported as JSON, so results of releases may be
+ * compared. Peak memory is measured per phase on Linux, elsewhere it is the
+ * peak of the process.
+ *
+ * Build:  cmake -S . -B build && cmake --build build --target process_benchmark
+ * Usage:  process_benchmark [--sizes=1K,1M] [--keys=1,100] [--hits=1,16] [--meta=0,64]
+ *                           [--nesting=1,4] [--encodings=ansi,utf16] [--threads=1,8] [--repeats=3]
+ *                           [--dir=work directory] [--output=results.json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "file_processing.h"
+#include "phase_stats.h"
+
+
+namespace {
+
+/**
+ * \brief  Parameters of one synthetic template and its replace table
+ */
+struct Workload {
+  uint64_t size = 1 << 20;     // template size in bytes
+  size_t keys_count = 100;     // keys in replace table
+  size_t hits_per_kb = 4;      // keys in template per KB of text
+  size_t meta_blocks = 0;      // IFSET/IFNOTSET blocks in template
+  size_t nesting = 1;          // depth of each meta block
+  size_t threads_count = 1;    // threads for rendering by chunks
+  bool is_utf16 = false;
+};
+
+struct BenchmarkOptions {
+  std::vector<uint64_t> sizes;
+  std::vector<size_t> keys_counts;
+  std::vector<size_t> hits_per_kb;
+  std::vector<size_t> meta_blocks;
+  std::vector<size_t> nestings;
+  std::vector<size_t> threads_counts;
+  std::vector<bool> encodings;   // is_utf16
+  int repeats = 3;
+  std::string directory;
+  std::string output = kStdStreamName;
+};
+
+std::string get_key(size_t index) {
+  return "!(KEY" + std::to_string(index) + ")";
+}
+
+std::string get_unset_key(size_t index) {
+  return "!(UNSET" + std::to_string(index) + ")";
+}
+
+/**
+ * \brief  Writes template text by blocks, in UTF-16 LE with byte order mark when needed
+ */
+class TemplateWriter {
+public:
+  TemplateWriter(FILE* file, bool is_utf16) : file_(file), is_utf16_(is_utf16), written_(0) {
+    if (is_utf16_)
+      fwrite(kUtf16LeBom, 1, sizeof(kUtf16LeBom), file_);
+  }
+
+  ~TemplateWriter() {
+    flush();
+  }
+
+  void append(const std::string& text) {
+    buffer_ += text;
+    written_ += text.size() * (is_utf16_ ? 2 : 1);
+    if (buffer_.size() >= kBlockSize)
+      flush();
+  }
+
+  uint64_t written() const {
+    return written_;
+  }
+
+private:
+  static constexpr size_t kBlockSize = 1 << 20;
+  static constexpr char kUtf16LeBom[2] = { '\xFF', '\xFE' };
+
+  void flush() {
+    if (is_utf16_) {
+      // generated text is ASCII
+      wide_.resize(buffer_.size() * 2);
+      for (size_t i = 0; i < buffer_.size(); i++) {
+        wide_[2 * i] = buffer_[i];
+        wide_[2 * i + 1] = 0;
+      }
+      fwrite(wide_.data(), 1, wide_.size(), file_);
+    } else {
+      fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    }
+    buffer_.clear();
+  }
+
+  FILE* file_;
+  bool is_utf16_;
+  uint64_t written_;
+  std::string buffer_;
+  std::string wide_;
+};
+
+/**
+ * \brief  Generate template of words with keys at random distances, and meta
+ *         blocks at even distances. Half of blocks have a true condition
+ * \return false when file cannot be written
+ */
+bool generate_template(const Workload& workload, const std::string& filename) {
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(filename.c_str(), "wb"), fclose);
+  if (!file)
+    return false;
+
+  std::mt19937_64 random(1);
+  TemplateWriter writer(file.get(), workload.is_utf16);
+  uint64_t hit_distance = workload.hits_per_kb ? std::max<uint64_t>(1024 / workload.hits_per_kb, 1) : 0;
+  uint64_t meta_distance = workload.meta_blocks ? workload.size / workload.meta_blocks : 0;
+  uint64_t next_hit = hit_distance ? random() % (2 * hit_distance) : UINT64_MAX;
+  uint64_t next_meta = meta_distance ? meta_distance / 2 : UINT64_MAX;
+  size_t blocks = 0;
+  size_t words = 0;
+  std::string word;
+
+  while (writer.written() < workload.size) {
+    if (writer.written() >= next_meta) {
+      for (size_t depth = 0; depth < workload.nesting; depth++) {
+        bool is_true = !(blocks % 2) || depth;
+        bool is_if_set = random() % 2;
+        std::string key = is_true == is_if_set ? get_key(random() % workload.keys_count) : get_unset_key(depth);
+        writer.append((is_if_set ? kAnsiIfSetToken : kAnsiIfNotSetToken) + key + kAnsiBracketCloseToken + "block text ");
+      }
+      writer.append(get_key(random() % workload.keys_count));
+      for (size_t depth = 0; depth < workload.nesting; depth++)
+        writer.append(" end" + kAnsiEndIfToken);
+
+      blocks++;
+      next_meta += meta_distance;
+      continue;
+    }
+
+    if (writer.written() >= next_hit) {
+      writer.append(get_key(random() % workload.keys_count));
+      next_hit += 1 + random() % (2 * hit_distance);
+      continue;
+    }
+
+    word.assign(3 + random() % 6, ' ');
+    for (size_t i = 0; i < word.size(); i++)
+      word[i] = static_cast<char>('a' + random() % 26);
+    writer.append(word + (++words % 12 ? " " : "\r\n"));
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Values are words without keys, so the second pass finds nothing
+ */
+template<typename TString>
+void make_replace_table(const Workload& workload, std::map<TString, TString>& replace_table) {
+  replace_table.clear();
+  for (size_t i = 0; i < workload.keys_count; i++) {
+    TString key;
+    TString value;
+    convert_value(get_key(i), key);
+    convert_value("value" + std::to_string(i), value);
+    replace_table[key] = value;
+  }
+}
+
+struct BenchmarkResult {
+  PhaseStats stats;
+  double seconds = 0;
+  uint64_t output_size = 0;
+};
+
+template<typename TString, typename TParserParams>
+bool run_workload(const Workload& workload, const std::string& in_filename, const std::string& out_filename,
+  int repeats, BenchmarkResult& result) {
+
+  std::map<TString, TString> values;
+  make_replace_table(workload, values);
+  ReplaceTable<TString, TParserParams> replace_table(std::move(values), true);
+
+  for (int repeat = 0; repeat < repeats; repeat++) {
+    PhaseStats stats;
+    std::stringstream error_text;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!process_file_content(in_filename, out_filename, replace_table, workload.threads_count, error_text, &stats)) {
+      fprintf(stderr, "%s", error_text.str().c_str());
+      return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!repeat || seconds < result.seconds) {
+      result.stats = stats;
+      result.seconds = seconds;
+    }
+  }
+
+  std::error_code error;
+  result.output_size = std::filesystem::file_size(out_filename, error);
+  return true;
+}
+
+std::string format_size(uint64_t size) {
+  if (size >= (1 << 30) && !(size % (1 << 30)))
+    return std::to_string(size >> 30) + "G";
+  if (size >= (1 << 20) && !(size % (1 << 20)))
+    return std::to_string(size >> 20) + "M";
+  if (size >= (1 << 10) && !(size % (1 << 10)))
+    return std::to_string(size >> 10) + "K";
+  return std::to_string(size);
+}
+
+void write_result(FILE* out, const Workload& workload, const BenchmarkResult& result, bool is_last) {
+  const PhaseStats& stats = result.stats;
+  fprintf(out, "    {\n");
+  fprintf(out, "      \"size\": %llu,\n", static_cast<unsigned long long>(workload.size));
+  fprintf(out, "      \"keys\": %zu,\n", workload.keys_count);
+  fprintf(out, "      \"hits_per_kb\": %zu,\n", workload.hits_per_kb);
+  fprintf(out, "      \"meta_blocks\": %zu,\n", workload.meta_blocks);
+  fprintf(out, "      \"nesting\": %zu,\n", workload.nesting);
+  fprintf(out, "      \"threads\": %zu,\n", workload.threads_count);
+  fprintf(out, "      \"encoding\": \"%s\",\n", workload.is_utf16 ? "utf16" : "ansi");
+  fprintf(out, "      \"output_size\": %llu,\n", static_cast<unsigned long long>(result.output_size));
+  fprintf(out, "      \"passes\": %zu,\n", stats.passes_count);
+  fprintf(out, "      \"replacements\": %llu,\n", static_cast<unsigned long long>(stats.replaces_count));
+  fprintf(out, "      \"seconds\": %.6f,\n", result.seconds);
+  fprintf(out, "      \"throughput_mb_s\": %.2f,\n", workload.size / result.seconds / 1e6);
+  fprintf(out, "      \"replacements_per_second\": %.0f,\n", stats.replaces_count / result.seconds);
+  fprintf(out, "      \"phases\": {\n");
+  for (int phase = 0; phase < kPhasesCount; phase++) {
+    double seconds = stats.seconds[phase];
+    fprintf(out, "        \"%s\": { \"seconds\": %.6f, \"throughput_mb_s\": %.2f, \"peak_rss\": %zu }%s\n",
+      get_phase_name(static_cast<ProcessPhase>(phase)), seconds, seconds > 0 ? workload.size / seconds / 1e6 : 0.0,
+      stats.peak_memory[phase], phase + 1 < kPhasesCount ? "," : "");
+  }
+  fprintf(out, "      }\n");
+  fprintf(out, "    }%s\n", is_last ? "" : ",");
+}
+
+/**
+ * \brief  Parse size with optional K, M or G suffix
+ */
+uint64_t parse_size(const std::string& text) {
+  char* end;
+  uint64_t size = strtoull(text.c_str(), &end, 10);
+  switch (*end) {
+  case 'K': case 'k': return size << 10;
+  case 'M': case 'm': return size << 20;
+  case 'G': case 'g': return size << 30;
+  default: return size;
+  }
+}
+
+template<typename T>
+std::vector<T> parse_list(const std::string& text) {
+  std::vector<T> values;
+  std::stringstream items(text);
+  std::string item;
+  while (std::getline(items, item, ','))
+    values.push_back(static_cast<T>(parse_size(item)));
+  return values;
+}
+
+bool parse_options(int argc, char* argv[], BenchmarkOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::string::size_type equal_token_pos = arg.find('=');
+    if (equal_token_pos == std::string::npos)
+      return false;
+
+    std::string name = arg.substr(0, equal_token_pos);
+    std::string value = arg.substr(equal_token_pos + 1);
+    if (name == "--sizes") {
+      options.sizes = parse_list<uint64_t>(value);
+    } else if (name == "--keys") {
+      options.keys_counts = parse_list<size_t>(value);
+    } else if (name == "--hits") {
+      options.hits_per_kb = parse_list<size_t>(value);
+    } else if (name == "--meta") {
+      options.meta_blocks = parse_list<size_t>(value);
+    } else if (name == "--nesting") {
+      options.nestings = parse_list<size_t>(value);
+    } else if (name == "--threads") {
+      options.threads_counts = parse_list<size_t>(value);
+    } else if (name == "--encodings") {
+      options.encodings.clear();
+      std::stringstream items(value);
+      std::string item;
+      while (std::getline(items, item, ','))
+        options.encodings.push_back(item == "utf16");
+    } else if (name == "--repeats") {
+      options.repeats = atoi(value.c_str());
+    } else if (name == "--dir") {
+      options.directory = value;
+    } else if (name == "--output") {
+      options.output = value;
+    } else {
+      return false;
+    }
+  }
+
+  return options.repeats > 0;
+}
+
+/**
+ * \brief  Workloads vary one axis at a time, other parameters are of the base workload
+ */
+std::vector<Workload> make_workloads(const BenchmarkOptions& options) {
+  std::vector<Workload> workloads;
+  const Workload kBase;
+
+  for (uint64_t size : options.sizes) {
+    Workload workload = kBase;
+    workload.size = size;
+    workloads.push_back(workload);
+  }
+  for (size_t keys_count : options.keys_counts) {
+    Workload workload = kBase;
+    workload.keys_count = std::max<size_t>(keys_count, 1);
+    workloads.push_back(workload);
+  }
+  for (size_t hits_per_kb : options.hits_per_kb) {
+    Workload workload = kBase;
+    workload.hits_per_kb = hits_per_kb;
+    workloads.push_back(workload);
+  }
+  for (size_t meta_blocks : options.meta_blocks) {
+    for (size_t nesting : options.nestings) {
+      Workload workload = kBase;
+      workload.meta_blocks = meta_blocks;
+      workload.nesting = std::max<size_t>(nesting, 1);
+      workloads.push_back(workload);
+    }
+  }
+  for (size_t threads_count : options.threads_counts) {
+    Workload workload = kBase;
+    workload.size = options.sizes.empty() ? kBase.size : *std::max_element(options.sizes.begin(), options.sizes.end());
+    workload.threads_count = threads_count;
+    workloads.push_back(workload);
+  }
+
+  // each workload is also run in other encodings
+  std::vector<Workload> encoded_workloads;
+  for (bool is_utf16 : options.encodings) {
+    for (Workload workload : workloads) {
+      workload.is_utf16 = is_utf16;
+      encoded_workloads.push_back(workload);
+    }
+  }
+
+  return encoded_workloads;
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions options;
+  options.sizes = { 1 << 10, 64 << 10, 1 << 20, 16 << 20 };
+  options.keys_counts = { 1, 100, 10000, 100000 };
+  options.hits_per_kb = { 0, 1, 16, 128 };
+  options.meta_blocks = { 16, 1024 };
+  options.nestings = { 1, 8 };
+  options.encodings = { false, true };
+
+  if (!parse_options(argc, argv, options)) {
+    fprintf(stderr, "Usage: process_benchmark [--sizes=1K,1M,4G] [--keys=1,100,100000] [--hits=0,16]\n"
+      "                         [--meta=0,1024] [--nesting=1,8] [--encodings=ansi,utf16] [--threads=1,8]\n"
+      "                         [--repeats=3]\n"
+      "                         [--dir=work directory] [--output=results.json]\n");
+    return 255;
+  }
+
+  std::error_code error;
+  std::filesystem::path directory = options.directory.empty()
+    ? std::filesystem::temp_directory_path(error) / "filereplace-benchmark"
+    : std::filesystem::path(options.directory);
+  std::filesystem::create_directories(directory, error);
+  std::string in_filename = (directory / "template.txt").string();
+  std::string out_filename = (directory / "output.txt").string();
+
+  std::unique_ptr<FILE, int (*)(FILE*)> out_file(nullptr, fclose);
+  FILE* out = stdout;
+  if (options.output != kStdStreamName) {
+    out_file.reset(fopen(options.output.c_str(), "w"));
+    if (!out_file) {
+      fprintf(stderr, "Cannot create output %s\n", options.output.c_str());
+      return 254;
+    }
+    out = out_file.get();
+  }
+
+  std::vector<Workload> workloads = make_workloads(options);
+  fprintf(out, "{\n");
+  fprintf(out, "  \"scan_kernel\": \"%s\",\n", get_scan_kernel_name(get_scan_kernel()));
+  fprintf(out, "  \"repeats\": %d,\n", options.repeats);
+  fprintf(out, "  \"results\": [\n");
+
+  for (size_t i = 0; i < workloads.size(); i++) {
+    const Workload& workload = workloads[i];
+    fprintf(stderr, "size %s keys %zu hits/KB %zu meta %zu nesting %zu threads %zu %s\n", format_size(workload.size).c_str(),
+      workload.keys_count, workload.hits_per_kb, workload.meta_blocks, workload.nesting, workload.threads_count,
+      workload.is_utf16 ? "utf16" : "ansi");
+
+    if (!generate_template(workload, in_filename)) {
+      fprintf(stderr, "Cannot create template %s\n", in_filename.c_str());
+      return 252;
+    }
+
+    BenchmarkResult result;
+    bool is_done = workload.is_utf16
+      ? run_workload<std::u16string, ParserParamsUtf16>(workload, in_filename, out_filename, options.repeats, result)
+      : run_workload<std::string, ParserParamsAnsi>(workload, in_filename, out_filename, options.repeats, result);
+    if (!is_done)
+      return 252;
+
+    write_result(out, workload, result, i + 1 == workloads.size());
+  }
+
+  fprintf(out, "  ]\n");
+  fprintf(out, "}\n");
+
+  std::filesystem::remove(in_filename, error);
+  std::filesystem::remove(out_filename, error);
+  return 0;
+}
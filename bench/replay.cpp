@@ -0,0 +1,481 @@
+/**
+ * Replay of invocations recorded by filereplace --record=<dir>. Each recorded
+ * command line is run in-process by the same code as filereplace, with the
+ * template and value files taken from the corpus, serially or on several
+ * threads. Outputs and exit codes are compared with the recorded ones, so a
+ * change of the engine may be checked for speed and for byte-identical results
+ * on a real workload.
+ * Latency percentiles of each invocation and of all runs, throughput and
+ * allocation counts are reported as JSON. Allocations of one invocation are
+ * exact in serial replay; with several threads only allocations of the thread
+ * which runs the invocation are counted for it, the total counts all threads.
+ *
+ * Build:  cmake -S . -B build && cmake --build build --target replay
+ * Usage:  replay <corpus> [--threads=1] [--repeats=3] [--dir=work directory] [--output=results.json]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif /*_WIN32*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "file_processing.h"
+#include "filereplace.h"
+#include "invocation_record.h"
+#include "thread_pool.h"
+
+
+// releasing functions are not inlined into operator delete: otherwise the compiler sees free()
+// of memory from operator new in inlined code and warns about mismatched allocation
+#ifdef _MSC_VER
+#define REPLAY_NOINLINE __declspec(noinline)
+#else  /*_MSC_VER*/
+#define REPLAY_NOINLINE __attribute__((noinline))
+#endif /*_MSC_VER*/
+
+namespace {
+
+std::atomic<uint64_t> allocations_count(0);
+thread_local uint64_t thread_allocations_count = 0;
+
+/**
+ * \brief  Count allocation and allocate memory, which is released by free()
+ * \return Memory, nullptr when it cannot be allocated
+ */
+void* allocate(size_t size) noexcept {
+  ++allocations_count;
+  ++thread_allocations_count;
+  return malloc(size ? size : 1);
+}
+
+/**
+ * \brief  Count allocation and allocate aligned memory, which is released by free_aligned()
+ * \return Memory, nullptr when it cannot be allocated
+ */
+void* allocate_aligned(size_t size, std::align_val_t alignment) noexcept {
+  ++allocations_count;
+  ++thread_allocations_count;
+  size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+  return _aligned_malloc(size ? size : 1, align);
+#else  /*_WIN32*/
+  // aligned_alloc() takes only sizes which are multiples of the alignment
+  return aligned_alloc(align, size ? (size + align - 1) / align * align : align);
+#endif /*_WIN32*/
+}
+
+/**
+ * \brief  Release memory of allocate()
+ */
+REPLAY_NOINLINE void release(void* data) noexcept {
+  free(data);
+}
+
+/**
+ * \brief  Release memory of allocate_aligned()
+ */
+REPLAY_NOINLINE void free_aligned(void* data) noexcept {
+#ifdef _WIN32
+  _aligned_free(data);
+#else  /*_WIN32*/
+  free(data);
+#endif /*_WIN32*/
+}
+
+}  // namespace
+
+// all forms of new and delete are replaced, so each allocation is counted once
+// and memory is released by the function which matches its allocation
+void* operator new(size_t size) {
+  void* data = allocate(size);
+  if (!data)
+    throw std::bad_alloc();
+  return data;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  void* data = allocate_aligned(size, alignment);
+  if (!data)
+    throw std::bad_alloc();
+  return data;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocate_aligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* data) noexcept {
+  release(data);
+}
+
+void operator delete[](void* data) noexcept {
+  release(data);
+}
+
+void operator delete(void* data, size_t) noexcept {
+  release(data);
+}
+
+void operator delete[](void* data, size_t) noexcept {
+  release(data);
+}
+
+void operator delete(void* data, const std::nothrow_t&) noexcept {
+  release(data);
+}
+
+void operator delete[](void* data, const std::nothrow_t&) noexcept {
+  release(data);
+}
+
+void operator delete(void* data, std::align_val_t) noexcept {
+  free_aligned(data);
+}
+
+void operator delete[](void* data, std::align_val_t) noexcept {
+  free_aligned(data);
+}
+
+void operator delete(void* data, size_t, std::align_val_t) noexcept {
+  free_aligned(data);
+}
+
+void operator delete[](void* data, size_t, std::align_val_t) noexcept {
+  free_aligned(data);
+}
+
+void operator delete(void* data, std::align_val_t, const std::nothrow_t&) noexcept {
+  free_aligned(data);
+}
+
+void operator delete[](void* data, std::align_val_t, const std::nothrow_t&) noexcept {
+  free_aligned(data);
+}
+
+
+namespace {
+
+struct ReplayOptions {
+  std::string corpus;
+  size_t threads_count = 1;
+  int repeats = 3;
+  std::string directory;
+  std::string output = kStdStreamName;
+};
+
+/**
+ * \brief  Results of all runs of one recorded invocation
+ */
+struct ReplayResult {
+  std::vector<double> seconds;     // by repeat
+  uint64_t allocations = 0;        // of all repeats
+  uint64_t input_size = 0;
+  uint64_t output_size = 0;
+  bool is_identical = true;
+  std::string difference;          // first difference from recorded run
+};
+
+/**
+ * \brief  Stream buffer which drops output, info output of runs is not reported
+ */
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override {
+    return c;
+  }
+};
+
+/**
+ * \brief  Command line of recorded invocation with files of the corpus
+ */
+std::vector<std::string> make_arguments(const RecordCorpus& corpus, const InvocationRecord& record, const std::string& out_filename) {
+  std::vector<std::string> arguments(1, "filereplace");
+  if (!record.mode.empty())
+    arguments.push_back(record.mode);
+  arguments.push_back(corpus.get_object_filename(record.input_object));
+  arguments.push_back(out_filename);
+  arguments.insert(arguments.end(), record.options.begin(), record.options.end());
+
+  for (const RecordedValue& value : record.values) {
+    if (value.object.empty())
+      arguments.push_back(value.key + "=" + value.value);
+    else
+      arguments.push_back(value.key + "=" + value.value[0] + corpus.get_object_filename(value.object));
+  }
+
+  return arguments;
+}
+
+/**
+ * \brief  Compare exit code and output of run with the recorded ones
+ * \return Description of the first difference, empty when they are the same
+ */
+std::string compare_run(const RecordCorpus& corpus, const InvocationRecord& record, int status, const std::string& out_filename,
+  uint64_t& output_size) {
+
+  if (status != record.status)
+    return "exit code " + std::to_string(status) + ", recorded " + std::to_string(record.status);
+  if (record.output_object.empty())
+    return std::string();
+
+  std::vector<char> output;
+  std::vector<char> recorded;
+  if (!RecordCorpus::read_file(out_filename, output))
+    return "cannot read output";
+  if (!RecordCorpus::read_file(corpus.get_object_filename(record.output_object), recorded))
+    return "cannot read recorded output";
+
+  output_size = output.size();
+  size_t offset = std::mismatch(output.begin(), output.begin() + std::min(output.size(), recorded.size()), recorded.begin()).first - output.begin();
+  if (offset == output.size() && offset == recorded.size())
+    return std::string();
+
+  return "output differs at byte " + std::to_string(offset) + ", size " + std::to_string(output.size())
+    + ", recorded " + std::to_string(recorded.size());
+}
+
+/**
+ * \brief  Run invocation once
+ * \param  is_serial  true when no other invocation runs, so all allocations of the process are counted
+ */
+void run_invocation(const RecordCorpus& corpus, const InvocationRecord& record, const std::string& out_filename, bool is_serial,
+  ReplayResult& result) {
+
+  std::vector<std::string> arguments = make_arguments(corpus, record, out_filename);
+  std::vector<char*> argv;
+  for (std::string& argument : arguments)
+    argv.push_back(&argument[0]);
+  argv.push_back(nullptr);
+
+  uint64_t allocations_start = is_serial ? allocations_count.load() : thread_allocations_count;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int status = run_command_line(static_cast<int>(arguments.size()), argv.data());
+  result.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  result.allocations += (is_serial ? allocations_count.load() : thread_allocations_count) - allocations_start;
+
+  std::string difference = compare_run(corpus, record, status, out_filename, result.output_size);
+  if (!difference.empty() && result.is_identical) {
+    result.is_identical = false;
+    result.difference = difference;
+  }
+}
+
+/**
+ * \brief  Nearest-rank percentile of sorted samples
+ */
+double get_percentile(const std::vector<double>& sorted_samples, double percentile) {
+  if (sorted_samples.empty())
+    return 0;
+
+  size_t rank = static_cast<size_t>(percentile / 100 * sorted_samples.size() + 0.999999);
+  return sorted_samples[std::min(std::max<size_t>(rank, 1), sorted_samples.size()) - 1];
+}
+
+void write_latency(FILE* out, std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  fprintf(out, "{ \"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f, \"max\": %.6f }",
+    samples.empty() ? 0.0 : samples.front(), get_percentile(samples, 50), get_percentile(samples, 90), get_percentile(samples, 99),
+    samples.empty() ? 0.0 : samples.back());
+}
+
+std::string escape_json(const std::string& text) {
+  std::string result;
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      result += '\\';
+    result += c;
+  }
+  return result;
+}
+
+bool parse_options(int argc, char* argv[], ReplayOptions& options) {
+  if (argc < 2 || argv[1][0] == '-')
+    return false;
+  options.corpus = argv[1];
+
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    std::string::size_type equal_token_pos = arg.find('=');
+    if (equal_token_pos == std::string::npos)
+      return false;
+
+    std::string name = arg.substr(0, equal_token_pos);
+    std::string value = arg.substr(equal_token_pos + 1);
+    if (name == "--threads") {
+      options.threads_count = strtoul(value.c_str(), nullptr, 10);
+    } else if (name == "--repeats") {
+      options.repeats = atoi(value.c_str());
+    } else if (name == "--dir") {
+      options.directory = value;
+    } else if (name == "--output") {
+      options.output = value;
+    } else {
+      return false;
+    }
+  }
+
+  return options.repeats > 0 && options.threads_count > 0;
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+  ReplayOptions options;
+  if (!parse_options(argc, argv, options)) {
+    fprintf(stderr, "Usage: replay <corpus> [--threads=1] [--repeats=3] [--dir=work directory] [--output=results.json]\n");
+    return 255;
+  }
+
+  RecordCorpus corpus(options.corpus);
+  std::vector<InvocationRecord> records;
+  if (!corpus.load(records, std::cerr))
+    return 254;
+
+  std::error_code error;
+  std::filesystem::path directory = options.directory.empty()
+    ? std::filesystem::temp_directory_path(error) / "filereplace-replay"
+    : std::filesystem::path(options.directory);
+  std::filesystem::create_directories(directory, error);
+
+  std::unique_ptr<FILE, int (*)(FILE*)> out_file(nullptr, fclose);
+  FILE* out = stdout;
+  if (options.output != kStdStreamName) {
+    out_file.reset(fopen(options.output.c_str(), "w"));
+    if (!out_file) {
+      fprintf(stderr, "Cannot create output %s\n", options.output.c_str());
+      return 254;
+    }
+    out = out_file.get();
+  }
+
+  // outputs keep the recorded file name, so compression by extension is the same
+  std::vector<std::string> out_filenames;
+  std::vector<ReplayResult> results(records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    out_filenames.push_back((directory / (std::to_string(i) + "-"
+      + std::filesystem::path(records[i].output_filename).filename().string())).string());
+    uint64_t input_size = std::filesystem::file_size(corpus.get_object_filename(records[i].input_object), error);
+    results[i].input_size = error ? 0 : input_size;
+  }
+
+  fprintf(stderr, "Replaying %zu invocations, %d repeats on %zu threads\n", records.size(), options.repeats, options.threads_count);
+
+  NullBuffer null_buffer;
+  std::streambuf* cout_buffer = std::cout.rdbuf(&null_buffer);
+  std::streambuf* cerr_buffer = std::cerr.rdbuf(&null_buffer);
+
+  bool is_serial = options.threads_count == 1;
+  uint64_t allocations_start = allocations_count;
+  double seconds = 0;
+
+  for (int repeat = 0; repeat < options.repeats; repeat++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (is_serial) {
+      for (size_t i = 0; i < records.size(); i++)
+        run_invocation(corpus, records[i], out_filenames[i], true, results[i]);
+    } else {
+      WorkStealingPool pool(options.threads_count);
+      for (size_t i = 0; i < records.size(); i++)
+        pool.submit([&, i]() { run_invocation(corpus, records[i], out_filenames[i], false, results[i]); });
+      pool.wait();
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  uint64_t allocations = allocations_count - allocations_start;
+  std::cout.rdbuf(cout_buffer);
+  std::cerr.rdbuf(cerr_buffer);
+
+  std::vector<double> samples;
+  uint64_t input_size = 0;
+  uint64_t output_size = 0;
+  size_t mismatches = 0;
+
+  fprintf(out, "{\n");
+  fprintf(out, "  \"scan_kernel\": \"%s\",\n", get_scan_kernel_name(get_scan_kernel()));
+  fprintf(out, "  \"threads\": %zu,\n", options.threads_count);
+  fprintf(out, "  \"repeats\": %d,\n", options.repeats);
+  fprintf(out, "  \"invocations\": [\n");
+
+  for (size_t i = 0; i < records.size(); i++) {
+    const ReplayResult& result = results[i];
+    samples.insert(samples.end(), result.seconds.begin(), result.seconds.end());
+    input_size += result.input_size * options.repeats;
+    output_size += result.output_size * options.repeats;
+
+    if (!result.is_identical) {
+      ++mismatches;
+      fprintf(stderr, "%s: %s\n", records[i].name.c_str(), result.difference.c_str());
+    }
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"record\": \"%s\",\n", escape_json(records[i].name).c_str());
+    fprintf(out, "      \"mode\": \"%s\",\n", records[i].mode.empty() ? "process" : escape_json(records[i].mode.substr(2)).c_str());
+    fprintf(out, "      \"status\": %d,\n", records[i].status);
+    fprintf(out, "      \"input_size\": %llu,\n", static_cast<unsigned long long>(result.input_size));
+    fprintf(out, "      \"output_size\": %llu,\n", static_cast<unsigned long long>(result.output_size));
+    fprintf(out, "      \"identical\": %s,\n", result.is_identical ? "true" : "false");
+    if (!result.is_identical)
+      fprintf(out, "      \"difference\": \"%s\",\n", escape_json(result.difference).c_str());
+    fprintf(out, "      \"allocations\": %llu,\n", static_cast<unsigned long long>(result.allocations / options.repeats));
+    fprintf(out, "      \"seconds\": ");
+    write_latency(out, result.seconds);
+    fprintf(out, "\n    }%s\n", i + 1 < records.size() ? "," : "");
+
+    std::filesystem::remove(out_filenames[i], error);
+  }
+
+  size_t runs = records.size() * options.repeats;
+  fprintf(out, "  ],\n");
+  fprintf(out, "  \"total\": {\n");
+  fprintf(out, "    \"runs\": %zu,\n", runs);
+  fprintf(out, "    \"mismatches\": %zu,\n", mismatches);
+  fprintf(out, "    \"seconds\": %.6f,\n", seconds);
+  fprintf(out, "    \"invocations_per_second\": %.2f,\n", seconds > 0 ? runs / seconds : 0.0);
+  fprintf(out, "    \"input_mb_s\": %.2f,\n", seconds > 0 ? input_size / seconds / 1e6 : 0.0);
+  fprintf(out, "    \"output_mb_s\": %.2f,\n", seconds > 0 ? output_size / seconds / 1e6 : 0.0);
+  fprintf(out, "    \"allocations\": %llu,\n", static_cast<unsigned long long>(allocations));
+  fprintf(out, "    \"allocations_per_run\": %llu,\n", static_cast<unsigned long long>(runs ? allocations / runs : 0));
+  fprintf(out, "    \"latency\": ");
+  write_latency(out, samples);
+  fprintf(out, "\n  }\n");
+  fprintf(out, "}\n");
+
+  if (mismatches)
+    fprintf(stderr, "%zu of %zu invocations differ from the recorded runs\n", mismatches, records.size());
+
+  return mismatches ? 252 : 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * Throughput of scan kernels used by KeyMatcher to skip text between
+ * candidate positions. For each kernel supported by the CPU, 8-bit and
+ * 16-bit code units and sets of 1, 2, 4 and 8 units are scanned, results are
+ * checked against the scalar kernel.
+ *
+ * Build:  g++ -std=c++17 -O2 -I../src scan_benchmark.cpp ../src/scan_kernels.cpp -o scan_benchmark
+ * Usage:  scan_benchmark [text size in MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+#include "scan_kernels.h"
+
+
+namespace {
+
+const size_t kCandidateDistance = 4096;   // average distance between found units
+
+/**
+ * \brief  Scan the whole text from candidate to candidate, as a matcher does
+ * \return Count of found candidates
+ */
+template<typename TUnit>
+size_t scan_text(const std::vector<TUnit>& text, const TUnit* units, size_t units_count) {
+  size_t found = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    i += scan_units(text.data() + i, text.size() - i, units, units_count);
+    if (i < text.size())
+      ++found;
+  }
+
+  return found;
+}
+
+template<typename TUnit>
+void run_benchmark(size_t size, const char* name) {
+  const TUnit kUnits[kMaxScanUnits] = { '!', '%', '@', '$', '#', '{', '[', '<' };
+
+  std::vector<TUnit> text(size / sizeof(TUnit));
+  srand(1);
+  for (size_t i = 0; i < text.size(); i++)
+    text[i] = static_cast<TUnit>('a' + rand() % 26);
+  for (size_t i = rand() % kCandidateDistance; i < text.size(); i += 1 + rand() % (2 * kCandidateDistance))
+    text[i] = kUnits[rand() % kMaxScanUnits];
+
+  for (size_t units_count = 1; units_count <= kMaxScanUnits; units_count *= 2) {
+    set_scan_kernel(kScanKernelScalar);
+    size_t expected = scan_text(text, kUnits, units_count);
+
+    for (int kernel = kScanKernelScalar; kernel < kScanKernelsCount; kernel++) {
+      if (!set_scan_kernel(static_cast<ScanKernel>(kernel)))
+        continue;
+
+      const int kRepeats = 5;
+      double best_time = 0;
+      size_t found = 0;
+      for (int repeat = 0; repeat < kRepeats; repeat++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        found = scan_text(text, kUnits, units_count);
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!repeat || time < best_time)
+          best_time = time;
+      }
+
+      printf("%-6s %-7s units %zu: %8.2f GB/s%s\n", name, get_scan_kernel_name(static_cast<ScanKernel>(kernel)),
+        units_count, size / best_time / 1e9, found == expected ? "" : "  MISMATCH");
+    }
+  }
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+  size_t size = (argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 64) << 20;
+  if (!size) {
+    printf("Usage: scan_benchmark [text size in MB]\n");
+    return 1;
+  }
+
+  ScanKernel best_kernel = get_scan_kernel();
+  printf("Text size %zu MB, default kernel %s\n", size >> 20, get_scan_kernel_name(best_kernel));
+
+  run_benchmark<uint8_t>(size, "8-bit");
+  run_benchmark<uint16_t>(size, "16-bit");
+
+  set_scan_kernel(best_kernel);
+  return 0;
+}
@@ -0,0 +1,439 @@
+#ifndef FILEREPLACE_COMPILED_TEMPLATE_H_
+#define FILEREPLACE_COMPILED_TEMPLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <ostream>
+#include <vector>
+
+#include "key_matcher.h"
+#include "meta_parser.h"
+
+
+/**
+ * Compiled template file layout. All numbers are in host byte order:
+ *
+ *   CompiledTemplateHeader
+ *   CompiledSpan          keys[keys_count]      key names in text pool
+ *   CompiledBlock         blocks[blocks_count]  meta block headers
+ *   CompiledOp            ops[ops_count]        template in text order
+ *   code units            text[text_size]       literal text, names and tokens
+ *
+ * A block op is followed by the ops of its content and keeps the index of the
+ * op after its content, so rendering is one walk which jumps over false blocks.
+ * Blocks with the same header and equal strings are stored once.
+ */
+static const char kCompiledTemplateMagic[8] = { 'F', 'R', 'T', 'P', 'L', '0', '0', '1' };
+
+struct CompiledTemplateHeader {
+  char magic[8];
+  uint32_t char_size;
+  uint32_t reserved;
+  uint64_t keys_count;
+  uint64_t blocks_count;
+  uint64_t ops_count;
+  uint64_t text_size;
+};
+
+struct CompiledSpan {
+  uint64_t offset;   // in text pool code units
+  uint64_t size;
+};
+
+struct CompiledBlock {
+  uint32_t type;     // MetaBlockType
+  uint32_t reserved;
+  CompiledSpan tpl;
+  CompiledSpan token;
+};
+
+enum CompiledOpType {
+  kCompiledOpText,   // literal text span
+  kCompiledOpKey,    // value of key
+  kCompiledOpBlock   // meta block, content follows
+};
+
+struct CompiledOp {
+  uint64_t offset;   // text offset, or index of the op after block content
+  uint32_t value;    // text size, key index or block index
+  uint32_t type;     // CompiledOpType
+};
+
+
+/**
+ * \brief  Compiler of template text to compiled template.
+ *
+ * Keys and meta tokens are found as in stream mode: with one automaton in one
+ * scan, meta blocks are nested and each !%@ENDIF% closes the innermost block.
+ * Keys must be known at compile time, values and conditions are left for rendering.
+ */
+template<typename TString, typename TParserParams>
+class TemplateCompiler {
+public:
+  typedef typename TString::value_type CharType;
+
+  /**
+   * \param  keys              Keys which are replaced at rendering
+   * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+   */
+  TemplateCompiler(const std::vector<TString>& keys, bool is_meta_enabled, const TParserParams& parser_params)
+    : parser_params_(parser_params) {
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (keys[i].empty())
+        continue;
+
+      matcher_.add_pattern(keys[i].data(), keys[i].size());
+      keys_.push_back(keys[i]);
+    }
+
+    if (is_meta_enabled) {
+      add_meta_pattern(parser_params.if_set_token_);
+      add_meta_pattern(parser_params.if_not_set_token_);
+      add_meta_pattern(parser_params.if_contains_token_);
+      add_meta_pattern(parser_params.end_if_token_);
+    }
+
+    matcher_.build();
+  }
+
+  /**
+   * \brief  Compile template text
+   * \param  text              Template text
+   * \param  size              Text size in code units
+   * \param  compiled [out]    Compiled template file content
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false on meta syntax error
+   */
+  bool compile(const CharType* text, size_t size, std::vector<char>& compiled, std::ostream& error_text) {
+    std::vector<CompiledSpan> keys;
+    std::vector<CompiledBlock> blocks;
+    std::vector<CompiledOp> ops;
+    std::vector<CharType> pool;
+    std::vector<std::pair<size_t, size_t> > open_blocks;   // op index and line, innermost last
+    std::map<TString, CompiledSpan> strings;
+    std::map<std::pair<uint32_t, std::pair<TString, TString> >, uint32_t> block_indexes;
+    size_t first_text_op = 0;          // text ops before block start or end are not extended
+
+    for (size_t i = 0; i < keys_.size(); i++)
+      keys.push_back(add_string(pool, strings, keys_[i]));
+
+    typename KeyMatcher<CharType>::Match match;
+    size_t offset = 0;
+    size_t line = 1;
+    size_t counted = 0;   // newlines are counted up to this position
+
+    while (matcher_.find(text, size, offset, true, match) == KeyMatcher<CharType>::kFound) {
+      if (match.pattern < keys_.size()) {
+        add_text(ops, pool, text + offset, match.position - offset, first_text_op);
+        CompiledOp op = { 0, static_cast<uint32_t>(match.pattern), kCompiledOpKey };
+        ops.push_back(op);
+        offset = match.position + match.length;
+        continue;
+      }
+
+      MetaBlockType type = static_cast<MetaBlockType>(match.pattern - keys_.size());
+      if (match.pattern - keys_.size() == kEndIfPattern) {
+        if (open_blocks.empty()) {
+          add_text(ops, pool, text + offset, match.position + match.length - offset, first_text_op);  // not opened block, left as is
+        } else {
+          add_text(ops, pool, text + offset, match.position - offset, first_text_op);
+          ops[open_blocks.back().first].offset = ops.size();
+          open_blocks.pop_back();
+          first_text_op = ops.size();
+        }
+        offset = match.position + match.length;
+        continue;
+      }
+
+      add_text(ops, pool, text + offset, match.position - offset, first_text_op);
+      line += std::count(text + counted, text + match.position, CharType('\n'));
+      counted = match.position;
+
+      MetaHeader<TString> header;
+      header.type = type;
+      if (parse_meta_header(text, size, match.position, true, parser_params_, header) != kMetaHeaderOk) {
+        error_text << get_meta_block_name(type) << " macro syntax error on line " << line << std::endl;
+        return false;
+      }
+
+      uint32_t& block_index = block_indexes[std::make_pair(static_cast<uint32_t>(type), std::make_pair(header.tpl, header.token))];
+      if (!block_index) {   // stored with index + 1
+        CompiledBlock block = { static_cast<uint32_t>(type), 0, add_string(pool, strings, header.tpl), add_string(pool, strings, header.token) };
+        blocks.push_back(block);
+        block_index = static_cast<uint32_t>(blocks.size());
+      }
+
+      CompiledOp op = { 0, block_index - 1, kCompiledOpBlock };
+      open_blocks.push_back(std::make_pair(ops.size(), line));
+      ops.push_back(op);
+      first_text_op = ops.size();
+      offset = match.position + header.size;
+    }
+
+    add_text(ops, pool, text + offset, size - offset, first_text_op);
+
+    for (size_t i = 0; i < open_blocks.size(); i++) {
+      CompiledOp& op = ops[open_blocks[i].first];
+      MetaBlockType type = static_cast<MetaBlockType>(blocks[op.value].type);
+      if (type != kMetaIfContains) {  // IFCONTAINS block without end lasts up to the end of text
+        error_text << get_meta_block_name(type) << " macro end not found, syntax error on line " << open_blocks[i].second << std::endl;
+        return false;
+      }
+      op.offset = ops.size();
+    }
+
+    CompiledTemplateHeader header;
+    memcpy(header.magic, kCompiledTemplateMagic, sizeof(header.magic));
+    header.char_size = sizeof(CharType);
+    header.reserved = 0;
+    header.keys_count = keys.size();
+    header.blocks_count = blocks.size();
+    header.ops_count = ops.size();
+    header.text_size = pool.size();
+
+    compiled.clear();
+    append(compiled, &header, sizeof(header));
+    append(compiled, keys.data(), keys.size() * sizeof(CompiledSpan));
+    append(compiled, blocks.data(), blocks.size() * sizeof(CompiledBlock));
+    append(compiled, ops.data(), ops.size() * sizeof(CompiledOp));
+    append(compiled, pool.data(), pool.size() * sizeof(CharType));
+    return true;
+  }
+
+private:
+  static const size_t kEndIfPattern = 3;   // index after meta block types
+  static const uint32_t kMaxTextSize = 0xFFFFFFFF;
+
+  void add_meta_pattern(const TString& token) {
+    matcher_.add_pattern(token.data(), token.size());
+  }
+
+  static CompiledSpan add_string(std::vector<CharType>& pool, std::map<TString, CompiledSpan>& strings, const TString& text) {
+    typename std::map<TString, CompiledSpan>::const_iterator item = strings.find(text);
+    if (item != strings.end())
+      return item->second;
+
+    CompiledSpan span = { pool.size(), text.size() };
+    pool.insert(pool.end(), text.begin(), text.end());
+    strings[text] = span;
+    return span;
+  }
+
+  static void add_text(std::vector<CompiledOp>& ops, std::vector<CharType>& pool, const CharType* text, size_t size, size_t first_text_op) {
+    if (!size)
+      return;
+
+    pool.insert(pool.end(), text, text + size);
+
+    for (size_t offset = pool.size() - size; size;) {
+      // adjacent literal text within the same block is kept in one op
+      CompiledOp* last = ops.size() > first_text_op ? &ops.back() : nullptr;
+      if (last && last->type == kCompiledOpText && last->offset + last->value == offset && last->value < kMaxTextSize) {
+        uint32_t added = static_cast<uint32_t>(std::min<size_t>(size, kMaxTextSize - last->value));
+        last->value += added;
+        offset += added;
+        size -= added;
+        continue;
+      }
+
+      CompiledOp op = { offset, 0, kCompiledOpText };
+      ops.push_back(op);
+    }
+  }
+
+  static void append(std::vector<char>& data, const void* bytes, size_t size) {
+    data.insert(data.end(), static_cast<const char*>(bytes), static_cast<const char*>(bytes) + size);
+  }
+
+  const TParserParams& parser_params_;
+  KeyMatcher<CharType> matcher_;
+  std::vector<TString> keys_;
+};
+
+
+/**
+ * \brief  Compiled template loaded from memory, usually a mapped file.
+ *
+ * Rendering does not search the text: values are taken by key index and
+ * literal text is referenced from the compiled data, so the output may be
+ * written directly from the mapped file.
+ */
+template<typename TString>
+class CompiledTemplate {
+public:
+  typedef typename TString::value_type CharType;
+
+  CompiledTemplate() : header_(nullptr), keys_(nullptr), blocks_(nullptr), ops_(nullptr), text_(nullptr) {
+  }
+
+  /**
+   * \brief  Code unit size of compiled template, 0 when data is not a compiled template
+   */
+  static size_t get_char_size(const char* data, size_t size) {
+    if (size < sizeof(CompiledTemplateHeader) || memcmp(data, kCompiledTemplateMagic, sizeof(kCompiledTemplateMagic)))
+      return 0;
+
+    CompiledTemplateHeader header;
+    memcpy(&header, data, sizeof(header));
+    return header.char_size;
+  }
+
+  /**
+   * \brief  Check and attach compiled data. Data must be aligned to 8 bytes
+   *         and must outlive the template
+   * \return true on success, false when data is not a valid compiled template
+   */
+  bool open(const char* data, size_t size) {
+    if (get_char_size(data, size) != sizeof(CharType) || reinterpret_cast<uintptr_t>(data) % sizeof(uint64_t))
+      return false;
+
+    header_ = reinterpret_cast<const CompiledTemplateHeader*>(data);
+    uint64_t keys_size = header_->keys_count * sizeof(CompiledSpan);
+    uint64_t blocks_size = header_->blocks_count * sizeof(CompiledBlock);
+    uint64_t ops_size = header_->ops_count * sizeof(CompiledOp);
+    uint64_t text_size = header_->text_size * sizeof(CharType);
+    uint64_t limit = size;
+
+    if (header_->keys_count > limit || header_->blocks_count > limit || header_->ops_count > limit || header_->text_size > limit
+      || sizeof(CompiledTemplateHeader) + keys_size + blocks_size + ops_size + text_size != size)
+      return false;
+
+    keys_ = reinterpret_cast<const CompiledSpan*>(data + sizeof(CompiledTemplateHeader));
+    blocks_ = reinterpret_cast<const CompiledBlock*>(reinterpret_cast<const char*>(keys_) + keys_size);
+    ops_ = reinterpret_cast<const CompiledOp*>(reinterpret_cast<const char*>(blocks_) + blocks_size);
+    text_ = reinterpret_cast<const CharType*>(reinterpret_cast<const char*>(ops_) + ops_size);
+
+    for (uint64_t i = 0; i < header_->keys_count; i++) {
+      if (!is_valid_span(keys_[i]))
+        return false;
+    }
+
+    for (uint64_t i = 0; i < header_->blocks_count; i++) {
+      if (blocks_[i].type > kMetaIfContains || !is_valid_span(blocks_[i].tpl) || !is_valid_span(blocks_[i].token))
+        return false;
+    }
+
+    for (uint64_t i = 0; i < header_->ops_count; i++) {
+      const CompiledOp& op = ops_[i];
+      bool is_valid = false;
+      switch (op.type) {
+      case kCompiledOpText:
+        is_valid = op.offset <= header_->text_size && op.value <= header_->text_size - op.offset;
+        break;
+      case kCompiledOpKey:
+        is_valid = op.value < header_->keys_count;
+        break;
+      case kCompiledOpBlock:
+        is_valid = op.value < header_->blocks_count && op.offset > i && op.offset <= header_->ops_count;
+        break;
+      }
+
+      if (!is_valid)
+        return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Text pool of compiled template, literal text is appended to sink from it
+   */
+  const CharType* text() const {
+    return text_;
+  }
+
+  size_t text_size() const {
+    return header_->text_size;
+  }
+
+  /**
+   * \brief  Render template in one walk over ops
+   * \param  replace_table   Table with tokens and replaces. Keys which are not in
+   *                         the table are left as is
+   * \param  sink            Output, must provide append(const CharType*, size_t)
+   * \return Replaces count
+   */
+  template<typename TSink>
+  size_t render(const std::map<TString, TString>& replace_table, TSink& sink) const {
+    static const std::map<TString, TString> no_overrides;
+    return render(replace_table, no_overrides, sink);
+  }
+
+  /**
+   * \brief  Render template with two layers of values, so sets of values which
+   *         share most of them need not be copied to one table each
+   * \param  base_table      Table with tokens and replaces
+   * \param  overrides       Values which replace or add to values of base table
+   * \param  sink            Output, must provide append(const CharType*, size_t)
+   * \return Replaces count
+   */
+  template<typename TSink>
+  size_t render(const std::map<TString, TString>& base_table, const std::map<TString, TString>& overrides, TSink& sink) const {
+    std::vector<const TString*> values(header_->keys_count);
+    for (uint64_t i = 0; i < header_->keys_count; i++)
+      values[i] = find_value(base_table, overrides, get_string(keys_[i]));
+
+    std::vector<bool> is_kept(header_->blocks_count);
+    MetaHeader<TString> header;
+    for (uint64_t i = 0; i < header_->blocks_count; i++) {
+      header.type = static_cast<MetaBlockType>(blocks_[i].type);
+      header.tpl = get_string(blocks_[i].tpl);
+      header.token = get_string(blocks_[i].token);
+      is_kept[i] = is_meta_condition_true(header, find_value(base_table, overrides, header.tpl));
+    }
+
+    size_t replaces_count = 0;
+    for (uint64_t i = 0; i < header_->ops_count;) {
+      const CompiledOp& op = ops_[i];
+
+      if (op.type == kCompiledOpBlock) {
+        i = is_kept[op.value] ? i + 1 : op.offset;
+        continue;
+      }
+
+      if (op.type == kCompiledOpText) {
+        sink.append(text_ + op.offset, op.value);
+      } else if (values[op.value]) {
+        sink.append(values[op.value]->data(), values[op.value]->size());
+        ++replaces_count;
+      } else {
+        sink.append(text_ + keys_[op.value].offset, static_cast<size_t>(keys_[op.value].size));
+      }
+      ++i;
+    }
+
+    return replaces_count;
+  }
+
+private:
+  bool is_valid_span(const CompiledSpan& span) const {
+    return span.offset <= header_->text_size && span.size <= header_->text_size - span.offset;
+  }
+
+  static const TString* find_value(const std::map<TString, TString>& base_table, const std::map<TString, TString>& overrides, const TString& key) {
+    typename std::map<TString, TString>::const_iterator item = overrides.find(key);
+    if (item != overrides.end())
+      return &item->second;
+
+    item = base_table.find(key);
+    return item == base_table.end() ? nullptr : &item->second;
+  }
+
+  TString get_string(const CompiledSpan& span) const {
+    return TString(text_ + span.offset, static_cast<size_t>(span.size));
+  }
+
+  const CompiledTemplateHeader* header_;
+  const CompiledSpan* keys_;
+  const CompiledBlock* blocks_;
+  const CompiledOp* ops_;
+  const CharType* text_;
+};
+
+#endif  // FILEREPLACE_COMPILED_TEMPLATE_H_
@@ -0,0 +1,630 @@
+#ifndef FILEREPLACE_COMPRESSED_STREAM_H_
+#define FILEREPLACE_COMPRESSED_STREAM_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef FILEREPLACE_WITH_ZLIB
+#include <zlib.h>
+#endif /*FILEREPLACE_WITH_ZLIB*/
+
+#ifdef FILEREPLACE_WITH_ZSTD
+#include <zstd.h>
+#endif /*FILEREPLACE_WITH_ZSTD*/
+
+
+/**
+ * Compressed input is detected by magic bytes, compressed output is selected
+ * by file extension. A format is supported when the build found its library
+ * (FILEREPLACE_WITH_ZLIB for gzip, FILEREPLACE_WITH_ZSTD for zstd).
+ */
+enum CompressionFormat {
+  kCompressionNone,
+  kCompressionGzip,   // .gz
+  kCompressionZstd    // .zst
+};
+
+static const size_t kCompressionMagicSize = 4;
+
+/**
+ * \brief  Compression format of data by its magic bytes
+ * \param  data  Start of data
+ * \param  size  Data size, at least kCompressionMagicSize when data is not shorter
+ */
+inline CompressionFormat detect_compression(const char* data, size_t size) {
+  if (size >= 2 && !memcmp(data, "\x1F\x8B", 2))
+    return kCompressionGzip;
+  if (size >= 4 && !memcmp(data, "\x28\xB5\x2F\xFD", 4))
+    return kCompressionZstd;
+  return kCompressionNone;
+}
+
+/**
+ * \brief  Compression format of file by its magic bytes
+ * \return kCompressionNone when file is not compressed or cannot be read
+ */
+inline CompressionFormat get_file_compression(const std::string& filename) {
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(filename.c_str(), "rb"), fclose);
+  char head[kCompressionMagicSize];
+  return file ? detect_compression(head, fread(head, 1, sizeof(head), file.get())) : kCompressionNone;
+}
+
+/**
+ * \brief  Compression format of output file by its extension
+ */
+inline CompressionFormat get_compression_by_extension(const std::string& filename) {
+  std::string::size_type dot_pos = filename.find_last_of("./\\");
+  std::string extension = dot_pos != std::string::npos && filename[dot_pos] == '.' ? filename.substr(dot_pos) : std::string();
+  if (extension == ".gz")
+    return kCompressionGzip;
+  if (extension == ".zst")
+    return kCompressionZstd;
+  return kCompressionNone;
+}
+
+inline const char* get_compression_name(CompressionFormat format) {
+  return format == kCompressionGzip ? "gzip" : format == kCompressionZstd ? "zstd" : "none";
+}
+
+/**
+ * \brief  Check whether format is supported by this build
+ */
+inline bool is_compression_supported(CompressionFormat format) {
+  switch (format) {
+  case kCompressionNone:
+    return true;
+  case kCompressionGzip:
+#ifdef FILEREPLACE_WITH_ZLIB
+    return true;
+#else  /*FILEREPLACE_WITH_ZLIB*/
+    return false;
+#endif /*FILEREPLACE_WITH_ZLIB*/
+  case kCompressionZstd:
+#ifdef FILEREPLACE_WITH_ZSTD
+    return true;
+#else  /*FILEREPLACE_WITH_ZSTD*/
+    return false;
+#endif /*FILEREPLACE_WITH_ZSTD*/
+  }
+  return false;
+}
+
+
+/**
+ * \brief  Streaming decoder of gzip or zstd data. Concatenated gzip members and
+ *         zstd frames are decoded as one stream
+ */
+class StreamDecoder {
+public:
+  StreamDecoder() : format_(kCompressionNone), is_complete_(false) {
+#ifdef FILEREPLACE_WITH_ZSTD
+    zstd_ = nullptr;
+#endif /*FILEREPLACE_WITH_ZSTD*/
+  }
+
+  ~StreamDecoder() {
+#ifdef FILEREPLACE_WITH_ZLIB
+    if (format_ == kCompressionGzip)
+      inflateEnd(&zlib_);
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+    ZSTD_freeDCtx(zstd_);
+#endif /*FILEREPLACE_WITH_ZSTD*/
+  }
+
+  StreamDecoder(const StreamDecoder&) = delete;
+  StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+  /**
+   * \brief  Start decoding
+   * \return false when format is not supported by this build
+   */
+  bool init(CompressionFormat format) {
+#ifdef FILEREPLACE_WITH_ZLIB
+    if (format == kCompressionGzip) {
+      memset(&zlib_, 0, sizeof(zlib_));
+      if (inflateInit2(&zlib_, 15 + 16) != Z_OK)   // gzip header
+        return false;
+      format_ = format;
+      return true;
+    }
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+    if (format == kCompressionZstd) {
+      zstd_ = ZSTD_createDCtx();
+      format_ = format;
+      return zstd_ != nullptr;
+    }
+#endif /*FILEREPLACE_WITH_ZSTD*/
+    return false;
+  }
+
+  /**
+   * \brief  Decode part of input
+   * \param  data            Input
+   * \param  size            Input size
+   * \param  output [in,out] Decoded data is appended
+   * \return false when input is damaged
+   */
+  bool decode(const char* data, size_t size, std::vector<char>& output) {
+#ifdef FILEREPLACE_WITH_ZLIB
+    if (format_ == kCompressionGzip) {
+      zlib_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+      zlib_.avail_in = static_cast<uInt>(size);
+
+      do {
+        size_t offset = output.size();
+        output.resize(offset + kOutputStep);
+        zlib_.next_out = reinterpret_cast<Bytef*>(output.data() + offset);
+        zlib_.avail_out = static_cast<uInt>(kOutputStep);
+        int result = inflate(&zlib_, Z_NO_FLUSH);
+        output.resize(offset + kOutputStep - zlib_.avail_out);
+
+        if (result == Z_STREAM_END) {
+          is_complete_ = true;
+          if (zlib_.avail_in && inflateReset(&zlib_) != Z_OK)
+            return false;
+          continue;
+        }
+        if (result == Z_BUF_ERROR)   // all input is consumed
+          break;
+        if (result != Z_OK)
+          return false;
+        is_complete_ = false;
+      } while (zlib_.avail_in || !zlib_.avail_out);
+
+      return true;
+    }
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+    if (format_ == kCompressionZstd) {
+      ZSTD_inBuffer input = { data, size, 0 };
+
+      while (true) {
+        size_t offset = output.size();
+        output.resize(offset + kOutputStep);
+        ZSTD_outBuffer buffer = { output.data() + offset, kOutputStep, 0 };
+        size_t result = ZSTD_decompressStream(zstd_, &buffer, &input);
+        output.resize(offset + buffer.pos);
+        if (ZSTD_isError(result))
+          return false;
+
+        is_complete_ = !result;
+        if (input.pos == input.size && buffer.pos < buffer.size)
+          return true;
+      }
+    }
+#endif /*FILEREPLACE_WITH_ZSTD*/
+    (void)data;
+    (void)size;
+    (void)output;
+    return false;
+  }
+
+  /**
+   * \brief  Check whether decoded input ends at the end of a member or frame,
+   *         otherwise input is truncated
+   */
+  bool is_complete() const {
+    return is_complete_;
+  }
+
+private:
+  static const size_t kOutputStep = 256 * 1024;
+
+  CompressionFormat format_;
+  bool is_complete_;
+#ifdef FILEREPLACE_WITH_ZLIB
+  z_stream zlib_;
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+  ZSTD_DCtx* zstd_;
+#endif /*FILEREPLACE_WITH_ZSTD*/
+};
+
+
+/**
+ * \brief  Streaming encoder to gzip or zstd data
+ */
+class StreamEncoder {
+public:
+  StreamEncoder() : format_(kCompressionNone) {
+#ifdef FILEREPLACE_WITH_ZSTD
+    zstd_ = nullptr;
+#endif /*FILEREPLACE_WITH_ZSTD*/
+  }
+
+  ~StreamEncoder() {
+#ifdef FILEREPLACE_WITH_ZLIB
+    if (format_ == kCompressionGzip)
+      deflateEnd(&zlib_);
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+    ZSTD_freeCCtx(zstd_);
+#endif /*FILEREPLACE_WITH_ZSTD*/
+  }
+
+  StreamEncoder(const StreamEncoder&) = delete;
+  StreamEncoder& operator=(const StreamEncoder&) = delete;
+
+  /**
+   * \brief  Start encoding with default compression level of format
+   * \return false when format is not supported by this build
+   */
+  bool init(CompressionFormat format) {
+#ifdef FILEREPLACE_WITH_ZLIB
+    if (format == kCompressionGzip) {
+      memset(&zlib_, 0, sizeof(zlib_));
+      if (deflateInit2(&zlib_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+      format_ = format;
+      return true;
+    }
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+    if (format == kCompressionZstd) {
+      zstd_ = ZSTD_createCCtx();
+      format_ = format;
+      return zstd_ != nullptr;
+    }
+#endif /*FILEREPLACE_WITH_ZSTD*/
+    return false;
+  }
+
+  /**
+   * \brief  Encode part of input
+   * \param  data            Input
+   * \param  size            Input size
+   * \param  is_end          true for the last part, the stream is finished
+   * \param  output [in,out] Encoded data is appended
+   * \return true on success
+   */
+  bool encode(const char* data, size_t size, bool is_end, std::vector<char>& output) {
+#ifdef FILEREPLACE_WITH_ZLIB
+    if (format_ == kCompressionGzip) {
+      zlib_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+      zlib_.avail_in = static_cast<uInt>(size);
+      int result;
+
+      do {
+        size_t offset = output.size();
+        output.resize(offset + kOutputStep);
+        zlib_.next_out = reinterpret_cast<Bytef*>(output.data() + offset);
+        zlib_.avail_out = static_cast<uInt>(kOutputStep);
+        result = deflate(&zlib_, is_end ? Z_FINISH : Z_NO_FLUSH);
+        output.resize(offset + kOutputStep - zlib_.avail_out);
+        if (result == Z_STREAM_ERROR)
+          return false;
+      } while (is_end ? result != Z_STREAM_END : !zlib_.avail_out);
+
+      return true;
+    }
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+    if (format_ == kCompressionZstd) {
+      ZSTD_inBuffer input = { data, size, 0 };
+
+      while (true) {
+        size_t offset = output.size();
+        output.resize(offset + kOutputStep);
+        ZSTD_outBuffer buffer = { output.data() + offset, kOutputStep, 0 };
+        size_t result = ZSTD_compressStream2(zstd_, &buffer, &input, is_end ? ZSTD_e_end : ZSTD_e_continue);
+        output.resize(offset + buffer.pos);
+        if (ZSTD_isError(result))
+          return false;
+
+        if (is_end ? !result : input.pos == input.size && buffer.pos < buffer.size)
+          return true;
+      }
+    }
+#endif /*FILEREPLACE_WITH_ZSTD*/
+    (void)data;
+    (void)size;
+    (void)is_end;
+    (void)output;
+    return false;
+  }
+
+private:
+  static const size_t kOutputStep = 256 * 1024;
+
+  CompressionFormat format_;
+#ifdef FILEREPLACE_WITH_ZLIB
+  z_stream zlib_;
+#endif /*FILEREPLACE_WITH_ZLIB*/
+#ifdef FILEREPLACE_WITH_ZSTD
+  ZSTD_CCtx* zstd_;
+#endif /*FILEREPLACE_WITH_ZSTD*/
+};
+
+
+/**
+ * \brief  Bounded queue of data blocks passed from one thread to another.
+ *         Closing wakes both sides: push() fails, pop() takes the rest
+ */
+class BlockQueue {
+public:
+  explicit BlockQueue(size_t capacity) : capacity_(capacity), is_closed_(false) {
+  }
+
+  /**
+   * \brief  Add block, wait while the queue is full
+   * \param  block [in,out]  Block, moved to the queue
+   * \return false when the queue is closed
+   */
+  bool push(std::vector<char>& block) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return blocks_.size() < capacity_ || is_closed_; });
+    if (is_closed_)
+      return false;
+
+    blocks_.push_back(std::move(block));
+    block.clear();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * \brief  Take block, wait while the queue is empty
+   * \param  block [out]  Block
+   * \return false when the queue is closed and empty
+   */
+  bool pop(std::vector<char>& block) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return !blocks_.empty() || is_closed_; });
+    if (blocks_.empty())
+      return false;
+
+    block = std::move(blocks_.front());
+    blocks_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+private:
+  size_t capacity_;
+  bool is_closed_;
+  std::deque<std::vector<char> > blocks_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+
+/**
+ * \brief  Reader of input which may be compressed. Compressed input is detected
+ *         by magic bytes and is read and decoded ahead by a separate thread,
+ *         so decoding overlaps with processing of decoded data. Plain input is
+ *         read directly
+ */
+class DecodingReader {
+public:
+  DecodingReader() : file_(nullptr), format_(kCompressionNone), head_size_(0), head_pos_(0),
+    queue_(kQueueCapacity), block_pos_(0), is_failed_(false) {
+  }
+
+  ~DecodingReader() {
+    queue_.close();
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  DecodingReader(const DecodingReader&) = delete;
+  DecodingReader& operator=(const DecodingReader&) = delete;
+
+  /**
+   * \brief  Start reading
+   * \param  file  File opened in binary mode, read from the current position
+   * \return false when input is compressed by format which is not supported by this build
+   */
+  bool open(FILE* file) {
+    file_ = file;
+    head_size_ = fread(head_, 1, sizeof(head_), file);
+    format_ = detect_compression(head_, head_size_);
+    if (format_ == kCompressionNone)
+      return true;
+
+    if (!decoder_.init(format_))
+      return false;
+
+    thread_ = std::thread(&DecodingReader::decode_file, this);
+    return true;
+  }
+
+  /**
+   * \brief  Read decoded data
+   * \return Count of read bytes, less than size at the end of data or on error
+   */
+  size_t read(char* buffer, size_t size) {
+    if (format_ == kCompressionNone) {
+      size_t count = std::min(size, head_size_ - head_pos_);
+      memcpy(buffer, head_ + head_pos_, count);
+      head_pos_ += count;
+      return count < size ? count + fread(buffer + count, 1, size - count, file_) : count;
+    }
+
+    size_t count = 0;
+    while (count < size) {
+      if (block_pos_ == block_.size()) {
+        block_pos_ = 0;
+        block_.clear();
+        if (!queue_.pop(block_))
+          break;
+        continue;
+      }
+
+      size_t part = std::min(size - count, block_.size() - block_pos_);
+      memcpy(buffer + count, block_.data() + block_pos_, part);
+      block_pos_ += part;
+      count += part;
+    }
+
+    return count;
+  }
+
+  /**
+   * \brief  Check whether input cannot be read or is damaged, after read() returned less than requested
+   */
+  bool is_failed() const {
+    return format_ == kCompressionNone ? ferror(file_) != 0 : is_failed_.load();
+  }
+
+  CompressionFormat format() const {
+    return format_;
+  }
+
+private:
+  static const size_t kInputSize = 64 * 1024;
+  static const size_t kBlockSize = 1024 * 1024;
+  static const size_t kQueueCapacity = 4;
+
+  void decode_file() {
+    std::vector<char> input(kInputSize);
+    std::vector<char> output;
+    memcpy(input.data(), head_, head_size_);
+    size_t input_size = head_size_ + fread(input.data() + head_size_, 1, input.size() - head_size_, file_);
+
+    while (input_size) {
+      if (!decoder_.decode(input.data(), input_size, output)) {
+        is_failed_ = true;
+        break;
+      }
+
+      if (output.size() >= kBlockSize && !queue_.push(output))
+        return;   // reader is destroyed
+
+      input_size = fread(input.data(), 1, input.size(), file_);
+    }
+
+    if (ferror(file_) || !decoder_.is_complete())
+      is_failed_ = true;
+    if (!is_failed_ && !output.empty())
+      queue_.push(output);
+    queue_.close();
+  }
+
+  FILE* file_;
+  CompressionFormat format_;
+  char head_[kCompressionMagicSize];
+  size_t head_size_;
+  size_t head_pos_;
+  StreamDecoder decoder_;
+  BlockQueue queue_;
+  std::vector<char> block_;   // taken from queue
+  size_t block_pos_;
+  std::atomic<bool> is_failed_;
+  std::thread thread_;
+};
+
+
+/**
+ * \brief  Writer of output which may be compressed. Written data is gathered
+ *         to blocks, which are encoded and written by a separate thread, so
+ *         encoding overlaps with rendering. Plain output is written directly
+ */
+class EncodingWriter {
+public:
+  /**
+   * \param  file    File opened in binary mode
+   * \param  format  Compression of output
+   */
+  EncodingWriter(FILE* file, CompressionFormat format) : file_(file), format_(format), queue_(kQueueCapacity), is_failed_(false) {
+    if (format_ == kCompressionNone)
+      return;
+
+    if (encoder_.init(format_))
+      thread_ = std::thread(&EncodingWriter::encode_blocks, this);
+    else
+      is_failed_ = true;
+  }
+
+  ~EncodingWriter() {
+    queue_.close();
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  EncodingWriter(const EncodingWriter&) = delete;
+  EncodingWriter& operator=(const EncodingWriter&) = delete;
+
+  /**
+   * \return false on error
+   */
+  bool write(const void* data, size_t size) {
+    if (format_ == kCompressionNone)
+      return fwrite(data, 1, size, file_) == size;
+
+    const char* bytes = static_cast<const char*>(data);
+    block_.insert(block_.end(), bytes, bytes + size);
+    if (block_.size() >= kBlockSize && !queue_.push(block_))
+      return false;
+
+    return !is_failed_;
+  }
+
+  /**
+   * \brief  Write the rest of data and the end of compressed stream, the file is not flushed
+   * \return false on error
+   */
+  bool finish() {
+    if (format_ == kCompressionNone)
+      return true;
+
+    if (!block_.empty())
+      queue_.push(block_);
+    queue_.close();
+    if (thread_.joinable())
+      thread_.join();
+
+    return !is_failed_;
+  }
+
+private:
+  static const size_t kBlockSize = 1024 * 1024;
+  static const size_t kQueueCapacity = 4;
+
+  void encode_blocks() {
+    std::vector<char> block;
+    std::vector<char> output;
+    bool is_end = false;
+
+    while (!is_end) {
+      is_end = !queue_.pop(block);
+      output.clear();
+      if (!encoder_.encode(block.data(), is_end ? 0 : block.size(), is_end, output)
+        || fwrite(output.data(), 1, output.size(), file_) != output.size()) {
+        is_failed_ = true;
+        queue_.close();
+        return;
+      }
+    }
+  }
+
+  FILE* file_;
+  CompressionFormat format_;
+  StreamEncoder encoder_;
+  BlockQueue queue_;
+  std::vector<char> block_;   // gathered, not queued yet
+  std::atomic<bool> is_failed_;
+  std::thread thread_;
+};
+
+#endif  // FILEREPLACE_COMPRESSED_STREAM_H_
@@ -0,0 +1,154 @@
+#ifndef FILEREPLACE_CONTENT_HASH_H_
+#define FILEREPLACE_CONTENT_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+
+/**
+ * \brief  Streaming 64-bit xxHash (XXH64) of content.
+ *
+ * Not cryptographic: used to address cached data by content, where inputs are
+ * not chosen by an attacker. Words are read in host byte order, so hashes are
+ * the same as reference XXH64 on little-endian hosts only and must not be
+ * shared between hosts of different byte order.
+ */
+class ContentHash {
+public:
+  explicit ContentHash(uint64_t seed = 0) : seed_(seed), total_size_(0), buffered_size_(0) {
+    lanes_[0] = seed + kPrime1 + kPrime2;
+    lanes_[1] = seed + kPrime2;
+    lanes_[2] = seed;
+    lanes_[3] = seed - kPrime1;
+  }
+
+  void update(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    total_size_ += size;
+
+    if (buffered_size_) {
+      size_t fill_size = size < kStripeSize - buffered_size_ ? size : kStripeSize - buffered_size_;
+      memcpy(buffer_ + buffered_size_, bytes, fill_size);
+      buffered_size_ += fill_size;
+      bytes += fill_size;
+      size -= fill_size;
+
+      if (buffered_size_ < kStripeSize)
+        return;
+
+      process_stripe(buffer_);
+      buffered_size_ = 0;
+    }
+
+    for (; size >= kStripeSize; bytes += kStripeSize, size -= kStripeSize)
+      process_stripe(bytes);
+
+    memcpy(buffer_, bytes, size);
+    buffered_size_ = size;
+  }
+
+  /**
+   * \brief  Add value of fixed size, used to separate variable size fields
+   */
+  void update_size(uint64_t value) {
+    update(&value, sizeof(value));
+  }
+
+  /**
+   * \brief  Add string with its size, so adjacent strings cannot be confused
+   */
+  template<typename TString>
+  void update_string(const TString& text) {
+    update_size(text.size());
+    update(text.data(), text.size() * sizeof(typename TString::value_type));
+  }
+
+  uint64_t digest() const {
+    uint64_t hash;
+    if (total_size_ >= kStripeSize) {
+      hash = rotate_left(lanes_[0], 1) + rotate_left(lanes_[1], 7) + rotate_left(lanes_[2], 12) + rotate_left(lanes_[3], 18);
+      for (size_t i = 0; i < 4; i++)
+        hash = (hash ^ round(0, lanes_[i])) * kPrime1 + kPrime4;
+    } else {
+      hash = seed_ + kPrime5;
+    }
+
+    hash += total_size_;
+
+    const unsigned char* bytes = buffer_;
+    size_t size = buffered_size_;
+    for (; size >= 8; bytes += 8, size -= 8)
+      hash = rotate_left(hash ^ round(0, read64(bytes)), 27) * kPrime1 + kPrime4;
+
+    if (size >= 4) {
+      hash = rotate_left(hash ^ (read32(bytes) * kPrime1), 23) * kPrime2 + kPrime3;
+      bytes += 4;
+      size -= 4;
+    }
+
+    for (; size; bytes++, size--)
+      hash = rotate_left(hash ^ (*bytes * kPrime5), 11) * kPrime1;
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+  /**
+   * \brief  Hash as 16 hex digits, used for file names
+   */
+  static std::string to_hex(uint64_t hash) {
+    const char kDigits[] = "0123456789abcdef";
+    std::string text(16, '0');
+    for (size_t i = 0; i < 16; i++, hash >>= 4)
+      text[15 - i] = kDigits[hash & 0xF];
+    return text;
+  }
+
+private:
+  static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+  static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+  static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+  static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+  static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+  static const size_t kStripeSize = 32;
+
+  static uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
+
+  static uint64_t round(uint64_t accumulator, uint64_t input) {
+    return rotate_left(accumulator + input * kPrime2, 31) * kPrime1;
+  }
+
+  static uint64_t read64(const unsigned char* bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+
+  static uint64_t read32(const unsigned char* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+
+  void process_stripe(const unsigned char* bytes) {
+    for (size_t i = 0; i < 4; i++)
+      lanes_[i] = round(lanes_[i], read64(bytes + i * 8));
+  }
+
+  uint64_t seed_;
+  uint64_t lanes_[4];
+  uint64_t total_size_;
+  unsigned char buffer_[kStripeSize];
+  size_t buffered_size_;
+};
+
+#endif  // FILEREPLACE_CONTENT_HASH_H_
@@ -0,0 +1,202 @@
+#include "file_processing.h"
+
+#include <stdio.h>
+
+#include <fstream>
+#include <memory>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif /*_WIN32*/
+
+#include "table_file.h"
+
+
+namespace {
+
+const std::streamoff kMaxFileSize = 0x100000000;
+
+/**
+ * \brief  Load whole input, compressed input is decoded while it is read
+ * \param  file         File opened in binary mode
+ * \param  text [out]   Decoded content
+ * \return true on success, false when input cannot be read, is damaged, or is too big
+ */
+bool load_decoded_file(FILE* file, std::vector<char>& text) {
+  const size_t kReadSize = 64 * 1024;
+  size_t read_size;
+  DecodingReader reader;
+  text.clear();
+  if (!reader.open(file))
+    return false;
+
+  do {
+    size_t offset = text.size();
+    if (offset > static_cast<size_t>(kMaxFileSize))
+      return false;
+    text.resize(offset + kReadSize);
+    read_size = reader.read(&text[offset], kReadSize);
+    text.resize(offset + read_size);
+  } while (read_size == kReadSize);
+
+  return !reader.is_failed();
+}
+
+}  // namespace
+
+
+TextEncoding get_template_encoding(const char* data, size_t size, const std::string&) {
+  (void)data;
+  (void)size;
+  return kTextEncodingUtf8;
+}
+
+TextEncoding get_template_encoding(const char* data, size_t size, const std::u16string&) {
+  return detect_text_encoding(data, size, kTextEncodingUtf16Le) == kTextEncodingUtf16Be ? kTextEncodingUtf16Be : kTextEncodingUtf16Le;
+}
+
+void convert_byte_order(std::string& text, TextEncoding encoding) {
+  (void)text;
+  (void)encoding;
+}
+
+void convert_byte_order(std::u16string& text, TextEncoding encoding) {
+  if (!is_host_byte_order(encoding) && !text.empty())
+    swap_byte_order(&text[0], text.size());
+}
+
+void set_binary_mode(FILE* file) {
+#ifdef _WIN32
+  _setmode(_fileno(file), _O_BINARY);
+#else  /*_WIN32*/
+  (void)file;
+#endif /*_WIN32*/
+}
+
+bool load_text_file(const std::string& filename, std::vector<char>& text) {
+  text.clear();
+
+  if (filename == kStdStreamName)
+    return load_decoded_file(stdin, text);
+
+  std::ifstream infile(filename, std::ios::in);
+  if (!infile.is_open()) {
+    return false;
+  }
+
+  char head[kCompressionMagicSize];
+  infile.read(head, sizeof(head));
+  if (detect_compression(head, static_cast<size_t>(infile.gcount())) != kCompressionNone) {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(filename.c_str(), "rb"), fclose);
+    return file && load_decoded_file(file.get(), text);
+  }
+
+  infile.clear();
+  infile.seekg(0, std::ios::end);
+  std::streamoff file_size = infile.tellg();
+  infile.seekg(0, std::ios::beg);
+
+  if (file_size < 0 || file_size > kMaxFileSize) {
+    return false;
+  }
+
+  text.resize(static_cast<size_t>(file_size));
+  infile.read(
+	  reinterpret_cast<char*>(&(*text.begin())),
+	  static_cast<std::streamsize>(file_size));
+  
+  return true;
+}
+
+bool load_binary_file(const std::string& filename, std::vector<char>& data) {
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(filename.c_str(), "rb"), fclose);
+  data.clear();
+  if (!file)
+    return false;
+
+  const size_t kReadSize = 64 * 1024;
+  size_t read_size;
+  do {
+    size_t offset = data.size();
+    data.resize(offset + kReadSize);
+    read_size = fread(&data[offset], 1, kReadSize, file.get());
+    data.resize(offset + read_size);
+  } while (read_size == kReadSize);
+
+  return !ferror(file.get());
+}
+
+CompressionFormat get_output_compression(const std::string& out_filename) {
+  return out_filename == kStdStreamName ? kCompressionNone : get_compression_by_extension(out_filename);
+}
+
+void report_infile_error(const std::string& in_filename, std::ostream& error_text) {
+  CompressionFormat compression = in_filename == kStdStreamName ? kCompressionNone : get_file_compression(in_filename);
+  if (compression == kCompressionNone)
+    error_text << "Cannot open infile " << in_filename << std::endl;
+  else if (!is_compression_supported(compression))
+    error_text << "Infile is compressed by " << get_compression_name(compression) << ", which is not supported by this build " << in_filename << std::endl;
+  else
+    error_text << "Cannot decode infile, it is damaged or too big " << in_filename << std::endl;
+}
+
+std::string normalize_path(const std::string& path) {
+  std::error_code error;
+  std::filesystem::path absolute_path = std::filesystem::absolute(path, error);
+  return (error ? std::filesystem::path(path) : absolute_path).lexically_normal().string();
+}
+
+void convert_value(const std::string& value, std::string& result) {
+  result = value;
+}
+
+void convert_value(const std::string& value, std::u16string& result) {
+  utf8_to_utf16(value.data(), value.size(), result);
+}
+
+void decode_value(const char* data, size_t size, char token, std::string& value) {
+  TextEncoding encoding = detect_text_encoding(data, size, token == '@' ? kTextEncodingUtf8 : kTextEncodingUtf16Le);
+  if (encoding == kTextEncodingUtf8) {  // load as is for ansi
+    to_str(data, size, value);
+    return;
+  }
+
+  std::u16string origin;
+  to_str(data, size, origin);
+  size_t bom_size = !origin.empty() && origin[0] == kUtf16ByteOrderMark;
+  utf16_to_utf8(origin.data() + bom_size, origin.size() - bom_size, value);
+}
+
+void decode_value(const char* data, size_t size, char token, std::u16string& value) {
+  TextEncoding encoding = detect_text_encoding(data, size, token == '@' ? kTextEncodingUtf8 : kTextEncodingUtf16Le);
+  if (encoding == kTextEncodingUtf8) {
+    std::string origin;
+    to_str(data, size, origin);
+    size_t bom_size = get_bom_size(origin.data(), origin.size(), encoding);
+    utf8_to_utf16(origin.data() + bom_size, origin.size() - bom_size, value);
+    return;
+  }
+
+  to_str(data, size, value);
+  if (!is_host_byte_order(encoding) && !value.empty() && value[0] == kUtf16ByteOrderMark)
+    value.erase(0, 1);
+}
+
+bool compile_table_file(const std::string& in_filename, const std::string& out_filename, std::ostream& error_text) {
+  std::vector<char> data;
+  if (!load_binary_file(in_filename, data)) {
+    error_text << "Cannot open infile " << in_filename << std::endl;
+    return false;
+  }
+
+  std::vector<char> compiled;
+  if (!TableFile::compile(data.data(), data.size(), in_filename, compiled, error_text))
+    return false;
+
+  return write_text_file(out_filename, std::string(compiled.begin(), compiled.end()), error_text);
+}
+
+bool is_file_value(const std::string& value) {
+  return value.size() && (value[0] == '@' || value[0] == '$');
+}
@@ -0,0 +1,1220 @@
+#ifndef FILEREPLACE_FILE_PROCESSING_H_
+#define FILEREPLACE_FILE_PROCESSING_H_
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif /*_WIN32*/
+
+#include "compiled_template.h"
+#include "compressed_stream.h"
+#include "content_hash.h"
+#include "file_stamp.h"
+#include "key_usage.h"
+#include "libfilereplace.h"
+#include "mapped_file.h"
+#include "phase_stats.h"
+#include "render_cache.h"
+#include "slice_output.h"
+#include "stream_renderer.h"
+#include "text_encoding.h"
+#include "thread_pool.h"
+
+
+/**
+ * File layer of the filereplace tool: templates and value files are loaded,
+ * rendered by the engine of libfilereplace.h and written to output files.
+ * Shared by the command line modes and the benchmarks, so they measure the
+ * same code.
+ */
+
+static const char16_t kUtf16ByteOrderMark = 0xFEFF;
+static const std::string kStdStreamName = "-";   // file name for stdin or stdout
+static const size_t kDefaultWindowSize = 4 * 1024 * 1024;
+static const size_t kMinWindowSize = 4096;
+
+/**
+ * \brief  Encoding of template: bytes for ANSI/UTF-8 text, UTF-16 byte order by
+ *         byte order mark, little endian when there is no mark
+ * \param  data     Template content, may be only its start
+ * \param  size     Content size in bytes
+ */
+TextEncoding get_template_encoding(const char* data, size_t size, const std::string&);
+TextEncoding get_template_encoding(const char* data, size_t size, const std::u16string&);
+
+/**
+ * \brief  Convert UTF-16 text between host byte order and byte order of encoding
+ */
+void convert_byte_order(std::string& text, TextEncoding encoding);
+void convert_byte_order(std::u16string& text, TextEncoding encoding);
+
+/**
+ * \brief  Convert file content to text in host byte order. Text ends at the first zero character
+ * \param  data     File content
+ * \param  size     Content size in bytes
+ * \return Encoding of content
+ */
+template<typename TString>
+TextEncoding to_str(const char* data, size_t size, TString& str) {
+  typedef typename TString::value_type CharType;
+
+  TextEncoding encoding = get_template_encoding(data, size, str);
+  str.assign(size / sizeof(CharType), CharType());
+  if (!str.empty())
+    memcpy(&str[0], data, str.size() * sizeof(CharType));
+
+  convert_byte_order(str, encoding);
+  str.resize(std::find(str.begin(), str.end(), CharType()) - str.begin());
+  return encoding;
+}
+
+template<typename TString>
+TextEncoding to_str(const std::vector<char>& text, TString& str) {
+  return to_str(text.data(), text.size(), str);
+}
+
+/**
+ * \brief  Switch standard stream to binary mode, so line ends are not converted
+ */
+void set_binary_mode(FILE* file);
+
+/**
+ * \brief  Load file content from text file. Compressed file (gzip, zstd) is decoded
+ * \param  filename            Path to file, "-" for stdin
+ * \param  text [out]          Output file contents
+ * \return true on success, false when file cannot be opened, or file is too big
+ */
+bool load_text_file(const std::string& filename, std::vector<char>& text);
+
+/**
+ * \brief  Load file content without any conversion
+ * \param  filename     Path to file
+ * \param  data [out]   File content
+ * \return true on success
+ */
+bool load_binary_file(const std::string& filename, std::vector<char>& data);
+
+/**
+ * \brief  Content of template or value file: mapped file, or loaded file where files
+ *         cannot be mapped, for stdin and for compressed files, which are decoded
+ */
+class FileContent {
+public:
+  /**
+   * \param  filename   Path to file, "-" for stdin
+   * \param  is_mapped  false for loading the file, so it may be changed while it is used
+   * \return true on success, false when file cannot be opened, or file is too big
+   */
+  bool open(const std::string& filename, bool is_mapped = true) {
+    if (is_mapped && filename != kStdStreamName && mapping_.open(filename)) {
+      if (detect_compression(mapping_.data(), mapping_.size()) == kCompressionNone)
+        return true;
+      mapping_.close();   // compressed file is decoded by loading
+    }
+    return load_text_file(filename, data_);
+  }
+
+  const char* data() const {
+    return mapping_.data() ? mapping_.data() : data_.data();
+  }
+
+  size_t size() const {
+    return mapping_.data() ? mapping_.size() : data_.size();
+  }
+
+  /**
+   * \return Descriptor of mapped file, -1 when content is loaded
+   */
+  int fd() const {
+    return mapping_.data() ? mapping_.fd() : -1;
+  }
+
+private:
+  MappedFile mapping_;
+  std::vector<char> data_;
+};
+
+/**
+ * \brief  Output sink which writes rendered text to a file in byte order of encoding
+ */
+template<typename TChar>
+class FileSink : public RenderSink<TChar> {
+public:
+  FileSink(EncodingWriter& writer, TextEncoding encoding) : writer_(writer), is_swapped_(!is_host_byte_order(encoding)) {
+  }
+
+  void append(const TChar* text, size_t size) override {
+    if constexpr (sizeof(TChar) == sizeof(char16_t)) {
+      if (is_swapped_) {
+        buffer_.assign(text, text + size);
+        swap_byte_order(reinterpret_cast<char16_t*>(buffer_.data()), size);
+        text = buffer_.data();
+      }
+    }
+
+    writer_.write(text, size * sizeof(TChar));
+  }
+
+private:
+  EncodingWriter& writer_;
+  bool is_swapped_;
+  std::vector<TChar> buffer_;
+};
+
+/**
+ * \brief  Compression of output file by its extension, stdout is not compressed
+ */
+CompressionFormat get_output_compression(const std::string& out_filename);
+
+/**
+ * \brief  Write text to output file, "-" for stdout. Output file is replaced atomically
+ *         through temporary file, so a failed write keeps the previous output. Output is
+ *         compressed by its extension
+ */
+template<typename TString>
+bool write_text_file(const std::string& out_filename, const TString& text, std::ostream& error_text) {
+  OutputFile outfile;
+  FILE* out = stdout;
+
+  if (out_filename != kStdStreamName) {
+    if (!outfile.open(out_filename, true)) {
+      error_text << "Cannot create outfile " << out_filename << std::endl;
+      return false;
+    }
+    out = outfile.file();
+  }
+
+  EncodingWriter writer(out, get_output_compression(out_filename));
+  bool is_written = writer.write(text.data(), text.size() * sizeof(typename TString::value_type)) && writer.finish();
+  if (!is_written || (out_filename == kStdStreamName ? (fflush(out) || ferror(out)) : !outfile.commit())) {
+    error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Write output slices to output file in byte order of encoding, "-" for stdout.
+ *         Output file is replaced atomically through temporary file. Output is compressed
+ *         by its extension
+ */
+template<typename TChar>
+bool write_text_file(
+  const std::string& out_filename,
+  const SliceSink<TChar>& slices,
+  TextEncoding encoding,
+  std::ostream& error_text) {
+
+  OutputFile outfile;
+  FILE* out = stdout;
+
+  if (out_filename != kStdStreamName) {
+    if (!outfile.open(out_filename, true)) {
+      error_text << "Cannot create outfile " << out_filename << std::endl;
+      return false;
+    }
+    out = outfile.file();
+  }
+
+  EncodingWriter writer(out, get_output_compression(out_filename));
+  FileSink<TChar> sink(writer, encoding);
+  for (size_t i = 0; i < slices.slices().size(); i++)
+    sink.append(slices.slices()[i].data, slices.slices()[i].size);
+
+  if (!writer.finish() || (out_filename == kStdStreamName ? (fflush(out) || ferror(out)) : !outfile.commit())) {
+    error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+#ifndef _WIN32
+
+/**
+ * \brief  Write output slices to output file, "-" for stdout. Output file is replaced
+ *         atomically through temporary file
+ * \param  source_fd     Descriptor of mapped source, -1 when source is not mapped
+ * \param  source        Start of mapped source
+ */
+template<typename TChar>
+bool write_slices_file(
+  const std::string& out_filename,
+  const SliceSink<TChar>& sink,
+  int source_fd,
+  const TChar* source,
+  std::ostream& error_text) {
+
+  OutputFile outfile;
+  int out = STDOUT_FILENO;
+  if (out_filename != kStdStreamName) {
+    if (!outfile.open(out_filename, true)) {
+      error_text << "Cannot create outfile " << out_filename << std::endl;
+      return false;
+    }
+    out = outfile.fd();
+  }
+
+  if (!write_slices(out, sink.slices(), source_fd, source) || (out_filename != kStdStreamName && !outfile.commit())) {
+    error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Write output rendered by chunks to output file, "-" for stdout. Chunks are
+ *         written concurrently, each one at its offset. Stdout is written sequentially
+ * \param  threads_count  Count of threads
+ */
+template<typename TChar>
+bool write_chunks_file(
+  const std::string& out_filename,
+  const std::vector<const SliceSink<TChar>*>& chunks,
+  size_t threads_count,
+  std::ostream& error_text) {
+
+  if (out_filename == kStdStreamName) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+      if (!write_slices(STDOUT_FILENO, chunks[i]->slices(), -1, static_cast<const TChar*>(nullptr))) {
+        error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  OutputFile outfile;
+  if (!outfile.open(out_filename, true)) {
+    error_text << "Cannot create outfile " << out_filename << std::endl;
+    return false;
+  }
+
+  std::vector<off_t> offsets(1, 0);
+  for (size_t i = 0; i < chunks.size(); i++)
+    offsets.push_back(offsets.back() + static_cast<off_t>(chunks[i]->size() * sizeof(TChar)));
+
+  std::atomic<bool> is_failed(false);
+  if (ftruncate(outfile.fd(), offsets.back())) {
+    is_failed = true;
+  } else {
+    WorkStealingPool pool(threads_count);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      pool.submit([&chunks, &offsets, &outfile, &is_failed, i]() {
+        if (!write_slices_at<TChar>(outfile.fd(), chunks[i]->slices(), offsets[i]))
+          is_failed = true;
+      });
+    }
+    pool.wait();
+  }
+
+  if (is_failed || !outfile.commit()) {
+    error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+#endif /*_WIN32*/
+
+/**
+ * \brief  Output sink which keeps rendered text as slices and writes them to output
+ *         file when rendering is finished. Slices of memory mapped source are written
+ *         without copying
+ */
+template<typename TString>
+class OutputFileSink : public RenderSink<typename TString::value_type> {
+public:
+  typedef typename TString::value_type CharType;
+
+  /**
+   * \param  out_filename      Output file path, "-" for stdout
+   * \param  source            Rendered text
+   * \param  source_size       Text size in code units
+   * \param  source_fd         Descriptor of mapped source, -1 when source is not mapped
+   * \param  encoding          Encoding of output, text is in host byte order
+   * \param  threads_count     Count of threads for writing chunks of output
+   * \param  error_text [out]  Stream for error output
+   * \param  stats [out]       Phase measurements, may be null
+   */
+  OutputFileSink(
+    const std::string& out_filename,
+    const CharType* source,
+    size_t source_size,
+    int source_fd,
+    TextEncoding encoding,
+    size_t threads_count,
+    std::ostream& error_text,
+    PhaseStats* stats)
+    : out_filename_(out_filename), slices_(source, source_size), source_(source),
+      source_fd_(source_fd), encoding_(encoding), threads_count_(threads_count), error_text_(error_text), stats_(stats),
+      is_written_(false) {
+  }
+
+  void append(const CharType* text, size_t size) override {
+    slices_.append(text, size);
+  }
+
+  void append_chunks(const std::vector<const SliceSink<CharType>*>& chunks) override {
+    chunks_.insert(chunks_.end(), chunks.begin(), chunks.end());
+  }
+
+  void finish() override {
+    PhaseTimer write_timer(stats_, kPhaseWrite);
+#ifndef _WIN32
+    bool is_plain = get_output_compression(out_filename_) == kCompressionNone;
+    if (is_plain && is_host_byte_order(encoding_) && !chunks_.empty() && !slices_.size()) {
+      is_written_ = write_chunks_file(out_filename_, chunks_, threads_count_, error_text_);
+      return;
+    }
+#endif /*_WIN32*/
+    for (size_t i = 0; i < chunks_.size(); i++) {
+      for (size_t j = 0; j < chunks_[i]->slices().size(); j++)
+        slices_.append(chunks_[i]->slices()[j].data, chunks_[i]->slices()[j].size);
+    }
+
+#ifndef _WIN32
+    if (is_plain && is_host_byte_order(encoding_)) {
+      is_written_ = write_slices_file(out_filename_, slices_, source_fd_, source_, error_text_);
+      return;
+    }
+#endif /*_WIN32*/
+    is_written_ = write_text_file(out_filename_, slices_, encoding_, error_text_);
+  }
+
+  bool is_written() const {
+    return is_written_;
+  }
+
+private:
+  const std::string& out_filename_;
+  SliceSink<CharType> slices_;
+  const CharType* source_;
+  int source_fd_;
+  TextEncoding encoding_;
+  size_t threads_count_;
+  std::vector<const SliceSink<CharType>*> chunks_;   // rendered by chunks, written instead of slices
+  std::ostream& error_text_;
+  PhaseStats* stats_;
+  bool is_written_;
+};
+
+/**
+ * \brief  Report that input file cannot be opened or read, or that it is compressed
+ *         by format which is not supported by this build
+ */
+void report_infile_error(const std::string& in_filename, std::ostream& error_text);
+
+/**
+ * \brief  Process file multipass replacing procedure. Input is rendered from memory
+ *         mapping when it is in host byte order, otherwise it is converted.
+ *         Compressed input is decoded while it is loaded
+ * \param  in_filename       Input file path
+ * \param  out_filename      Output file path. May be the same as input for overwrite
+ * \param  replace_table     Compiled replace table
+ * \param  threads_count     Count of threads for rendering the file by chunks, 1 for one thread
+ * \param  error_text [out]  Stream for error output
+ * \param  stats [out]       Phase measurements, may be null
+ * \param  content           Content of input file when it is already read, null for reading it here
+ * \return true on success, false - have errors, info placed to error stream
+ */
+template<typename TString, typename TParserParams>
+bool process_file_content(
+  const std::string& in_filename, 
+  const std::string& out_filename, 
+  const ReplaceTable<TString, TParserParams>& replace_table,
+  size_t threads_count,
+  std::ostream& error_text,
+  PhaseStats* stats = nullptr,
+  const FileContent* content = nullptr) {
+
+  typedef typename TString::value_type CharType;
+
+  PhaseTimer load_timer(stats, kPhaseLoad);
+  FileContent file;
+  if (!content) {
+    if (!file.open(in_filename)) {
+      report_infile_error(in_filename, error_text);
+      return false;
+    }
+    content = &file;
+  }
+
+#ifndef _WIN32
+  if (content->fd() >= 0 && is_host_byte_order(get_template_encoding(content->data(), content->size(), TString()))) {
+    // text ends at the first zero character
+    const CharType* source = reinterpret_cast<const CharType*>(content->data());
+    size_t size = std::find(source, source + content->size() / sizeof(CharType), CharType()) - source;
+    load_timer.stop();
+
+    OutputFileSink<TString> sink(out_filename, source, size, content->fd(), kTextEncodingUtf8, threads_count, error_text, stats);
+    return replace_table.render_parallel(source, size, sink, threads_count, error_text, stats) && sink.is_written();
+  }
+#endif /*_WIN32*/
+
+  if (!content->size())
+    return true;
+
+  TString text;
+  TextEncoding encoding = to_str(content->data(), content->size(), text);
+  if (stats)
+    stats->copied_bytes += (content->fd() < 0 ? content->size() : 0) + text.size() * sizeof(CharType);
+  load_timer.stop();
+
+  OutputFileSink<TString> sink(out_filename, text.data(), text.size(), -1, encoding, threads_count, error_text, stats);
+  return replace_table.render_parallel(text.data(), text.size(), sink, threads_count, error_text, stats) && sink.is_written();
+}
+
+/**
+ * \brief  Process file in one pass by windows of fixed size, so memory does not depend on file size
+ * \param  in_filename       Input file path, "-" for stdin
+ * \param  out_filename      Output file path, "-" for stdout
+ * \param  replace_table     Compiled replace table
+ * \param  window_size       Window size in bytes. Grows when a meta token does not fit in window
+ * \param  error_text [out]  Stream for error output
+ * \param  stats [out]       Phase measurements, may be null. Reading is measured as load,
+ *                           rendering with buffered output as replace, final flush as write
+ * \return true on success, false - have errors, info placed to error stream
+ *
+ * Unlike process_file_content, inserted values are not scanned for keys again.
+ * As in process_file_content, text ends at the
+ * first zero character. Output file is written through temporary file, which
+ * replaces it only when the whole input is rendered.
+ */
+template<typename TString, typename TParserParams>
+bool process_file_stream(
+  const std::string& in_filename,
+  const std::string& out_filename,
+  const ReplaceTable<TString, TParserParams>& replace_table,
+  size_t window_size,
+  std::ostream& error_text,
+  PhaseStats* stats = nullptr) {
+
+  typedef typename TString::value_type CharType;
+
+  std::unique_ptr<FILE, int (*)(FILE*)> infile(nullptr, fclose);
+  FILE* in = stdin;
+  if (in_filename != kStdStreamName) {
+    infile.reset(fopen(in_filename.c_str(), "rb"));
+    if (!infile) {
+      error_text << "Cannot open infile " << in_filename << std::endl;
+      return false;
+    }
+    in = infile.get();
+  }
+
+  DecodingReader reader;
+  if (!reader.open(in)) {
+    report_infile_error(in_filename, error_text);
+    return false;
+  }
+
+  OutputFile outfile;
+  FILE* out = stdout;
+  if (out_filename != kStdStreamName) {
+    if (!outfile.open(out_filename, true)) {
+      error_text << "Cannot create outfile " << out_filename << std::endl;
+      return false;
+    }
+    out = outfile.file();
+  }
+
+  PhaseTimer renderer_timer(stats, kPhaseReplace);
+  StreamRenderer<TString, TParserParams> renderer(replace_table.stream_tokens(), replace_table.values(), replace_table.parser_params());
+  if (stats)
+    renderer.set_key_replaces(stats->add_pass(replace_table.values().size()).data());
+  renderer_timer.stop();
+
+  EncodingWriter writer(out, get_output_compression(out_filename));
+  std::unique_ptr<FileSink<CharType> > sink;
+  TextEncoding encoding = kTextEncodingUtf8;
+
+  std::vector<CharType> window(std::max(window_size, kMinWindowSize) / sizeof(CharType));
+  char* window_bytes = reinterpret_cast<char*>(window.data());
+  size_t filled_bytes = 0;
+  size_t converted = 0;   // code units which are converted to host byte order
+  bool is_eof = false;
+
+  while (true) {
+    size_t window_bytes_size = window.size() * sizeof(CharType);
+    PhaseTimer load_timer(stats, kPhaseLoad);
+    while (!is_eof && filled_bytes < window_bytes_size) {
+      size_t read_size = reader.read(window_bytes + filled_bytes, window_bytes_size - filled_bytes);
+      if (stats)
+        stats->copied_bytes += read_size;
+      if (!read_size) {
+        if (reader.is_failed()) {
+          error_text << "Cannot read infile " << in_filename << std::endl;
+          return false;
+        }
+        is_eof = true;
+        break;
+      }
+
+      // text ends at the first zero character, rest of input is ignored
+      size_t first_unit = filled_bytes / sizeof(CharType);
+      filled_bytes += read_size;
+      size_t units = filled_bytes / sizeof(CharType);
+      const CharType* zero = std::find(window.data() + first_unit, window.data() + units, CharType());
+      if (zero != window.data() + units) {
+        filled_bytes = (zero - window.data()) * sizeof(CharType);
+        is_eof = true;
+      }
+    }
+
+    size_t units = filled_bytes / sizeof(CharType);
+    if (!sink) {   // encoding is detected by the start of the first window
+      encoding = get_template_encoding(window_bytes, filled_bytes, TString());
+      sink.reset(new FileSink<CharType>(writer, encoding));
+    }
+
+    if (!is_host_byte_order(encoding))
+      swap_byte_order(reinterpret_cast<char16_t*>(window.data() + converted), units - converted);
+    converted = units;
+    load_timer.stop();
+
+    PhaseTimer replace_timer(stats, kPhaseReplace);
+    size_t consumed = 0;
+    if (!renderer.process(window.data(), units, is_eof, consumed, *sink, error_text))
+      return false;
+    replace_timer.stop();
+
+    if (stats)
+      stats->scanned_bytes += (is_eof ? units : consumed) * sizeof(CharType);
+
+    if (is_eof)
+      break;
+
+    if (!consumed && filled_bytes == window_bytes_size) {  // meta token is longer than window
+      window.resize(window.size() * 2);
+      window_bytes = reinterpret_cast<char*>(window.data());
+    }
+
+    size_t consumed_bytes = consumed * sizeof(CharType);
+    memmove(window_bytes, window_bytes + consumed_bytes, filled_bytes - consumed_bytes);
+    filled_bytes -= consumed_bytes;
+    converted -= consumed;
+    if (stats)
+      stats->copied_bytes += filled_bytes;
+  }
+
+  if (stats)
+    stats->replaces_count += renderer.replaces_count();
+
+  PhaseTimer write_timer(stats, kPhaseWrite);
+  if (!writer.finish() || (out_filename == kStdStreamName ? (fflush(out) || ferror(out)) : !outfile.commit())) {
+    error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Absolute normalized path, used to compare paths
+ */
+std::string normalize_path(const std::string& path);
+
+/**
+ * \brief  Compute render key: hash of everything which defines the output
+ * \param  content           Content of input file
+ * \param  table             Compiled replace table, with loaded file values
+ * \param  is_stream         true for stream mode
+ * \return Render key
+ */
+template<typename TString, typename TParserParams>
+uint64_t get_render_key(
+  const FileContent& content,
+  const ReplaceTable<TString, TParserParams>& table,
+  bool is_stream) {
+
+  const std::map<TString, TString>& replace_table = table.values();
+  ContentHash hash;
+  hash.update_size(sizeof(typename TString::value_type));
+  hash.update_size(table.is_meta_enabled());
+  hash.update_size(is_stream);
+  hash.update_string(table.placeholders().open_token);
+  hash.update_string(table.placeholders().close_token);
+  hash.update_size(table.is_expanded());
+
+  hash.update_size(content.size());
+  hash.update(content.data(), content.size());
+
+  hash.update_size(replace_table.size());
+  for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+    i != replace_table.end();
+    i++) {
+    hash.update_string(i->first);
+    hash.update_string(i->second);
+  }
+
+  return hash.digest();
+}
+
+/**
+ * \brief  Process file in stream or multipass mode. With render cache the file
+ *         is not processed when its output is up to date, and the output is
+ *         not rewritten when its content is not changed. Compressed input is
+ *         decoded, output is compressed by its extension (.gz, .zst)
+ * \param  in_filename       Input file path, "-" for stdin
+ * \param  out_filename      Output file path, "-" for stdout
+ * \param  replace_table     Compiled replace table
+ * \param  is_stream         true for stream mode
+ * \param  window_size       Window size for stream mode
+ * \param  threads_count     Count of threads for rendering the file by chunks, 1 for one thread
+ * \param  render_cache      Render cache, nullptr when disabled
+ * \param  error_text [out]  Stream for error output
+ * \param  stats [out]       Phase measurements, may be null
+ * \param  content           Content of input file when it is already read, null for reading it
+ *                           here. Stream mode reads the file by windows anyway
+ * \return true on success, false - have errors, info placed to error stream
+ */
+template<typename TString, typename TParserParams>
+bool process_file(
+  const std::string& in_filename,
+  const std::string& out_filename,
+  const ReplaceTable<TString, TParserParams>& replace_table,
+  bool is_stream,
+  size_t window_size,
+  size_t threads_count,
+  RenderCache* render_cache,
+  std::ostream& error_text,
+  PhaseStats* stats = nullptr,
+  const FileContent* content = nullptr) {
+
+  CompressionFormat out_compression = get_output_compression(out_filename);
+  if (!is_compression_supported(out_compression)) {
+    error_text << "Outfile is compressed by " << get_compression_name(out_compression) << ", which is not supported by this build " << out_filename << std::endl;
+    return false;
+  }
+
+  // input is read once for render key and rendering
+  FileContent file;
+  bool is_cached = render_cache && in_filename != kStdStreamName && out_filename != kStdStreamName;
+  if (is_cached && !content) {
+    if (file.open(in_filename))
+      content = &file;
+    else
+      is_cached = false;   // error is reported by processing
+  }
+
+  if (!is_cached) {
+    return is_stream
+      ? process_file_stream(in_filename, out_filename, replace_table, window_size, error_text, stats)
+      : process_file_content(in_filename, out_filename, replace_table, threads_count, error_text, stats, content);
+  }
+
+  uint64_t key = get_render_key(*content, replace_table, is_stream);
+
+  std::string out_path = normalize_path(out_filename);
+  if (render_cache->lookup(key, out_path)) {
+    if (stats)
+      stats->is_cache_hit = true;
+    return true;
+  }
+
+  // render next to output and keep the output untouched when it is not changed,
+  // temporary file keeps the extension of compressed output
+  std::string extension = out_compression == kCompressionNone ? std::string() : std::filesystem::path(out_filename).extension().string();
+  std::string temp_filename = out_filename + "." + ContentHash::to_hex(key) + ".tmp" + extension;
+  bool is_processed = is_stream
+    ? process_file_stream(in_filename, temp_filename, replace_table, window_size, error_text, stats)
+    : process_file_content(in_filename, temp_filename, replace_table, threads_count, error_text, stats, content);
+
+  std::error_code error;
+  if (!is_processed || !std::filesystem::exists(temp_filename, error)) {  // empty input has no output
+    remove(temp_filename.c_str());
+    return is_processed;
+  }
+
+  if (is_same_content(temp_filename, out_filename)) {
+    remove(temp_filename.c_str());
+  } else if (!OutputFile::replace_file(temp_filename, out_filename)) {
+    remove(temp_filename.c_str());
+    error_text << "Cannot create outfile " << out_filename << std::endl;
+    return false;
+  }
+
+  render_cache->store(key, out_path);
+  return true;
+}
+
+/**
+ * \brief  Convert command line value to text format
+ */
+void convert_value(const std::string& value, std::string& result);
+void convert_value(const std::string& value, std::u16string& result);
+
+/**
+ * \brief  Build compiled replace table
+ * \param  values            Keys and values
+ * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+ * \param  parser_params     Meta tokens
+ * \param  placeholders      Placeholder mode, disabled when tokens are empty
+ * \param  is_expanded       true for resolving keys inside values when the table is built
+ * \param  error_text [out]  Stream for error output
+ * \param  content           Content of the only template which the table is built for, so only
+ *                           its keys are expanded; null for a table shared by templates
+ * \return Table, nullptr when expanded values refer to each other in a cycle, info placed to error stream
+ */
+template<typename TString, typename TParserParams>
+std::unique_ptr<ReplaceTable<TString, TParserParams> > build_replace_table(
+  std::map<TString, TString> values,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  const PlaceholderFormat<TString>& placeholders,
+  bool is_expanded,
+  std::ostream& error_text,
+  const FileContent* content = nullptr) {
+
+  if (is_expanded) {
+    TString text;
+    if (content)
+      to_str(content->data(), content->size(), text);
+    return ReplaceTable<TString, TParserParams>::create_expanded(std::move(values), is_meta_enabled, error_text, parser_params,
+      placeholders, content ? &text : nullptr);
+  }
+
+  return std::unique_ptr<ReplaceTable<TString, TParserParams> >(
+    new ReplaceTable<TString, TParserParams>(std::move(values), is_meta_enabled, parser_params, placeholders));
+}
+
+/**
+ * \brief  Decode value file content to text format. Encoding of content is
+ *         detected by byte order mark. Content is transcoded only when its
+ *         encoding differs from text format, then byte order mark is removed
+ * \param  data          File content
+ * \param  size          Content size in bytes
+ * \param  token         '@' for ANSI/UTF-8 file, '$' for UTF16 file, used when content has no byte order mark
+ * \param  value [out]   Decoded value
+ */
+void decode_value(const char* data, size_t size, char token, std::string& value);
+void decode_value(const char* data, size_t size, char token, std::u16string& value);
+
+/**
+ * \brief  Compile template file for repeated rendering
+ * \param  in_filename       Template file path, "-" for stdin
+ * \param  out_filename      Compiled template file path
+ * \param  keys              Keys which are replaced at rendering
+ * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+ * \param  error_text [out]  Stream for error output
+ * \return true on success, false - have errors, info placed to error stream
+ */
+template<typename TString, typename TParserParams>
+bool compile_template_file(
+  const std::string& in_filename,
+  const std::string& out_filename,
+  const std::vector<std::string>& keys,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  std::ostream& error_text) {
+
+  std::vector<char> data;
+  if (!load_text_file(in_filename, data)) {
+    error_text << "Cannot open infile " << in_filename << std::endl;
+    return false;
+  }
+
+  TString text;
+  to_str(data, text);
+
+  std::vector<TString> template_keys(keys.size());
+  for (size_t i = 0; i < keys.size(); i++)
+    convert_value(keys[i], template_keys[i]);
+
+  TemplateCompiler<TString, TParserParams> compiler(template_keys, is_meta_enabled, parser_params);
+  std::vector<char> compiled;
+  if (!compiler.compile(text.data(), text.size(), compiled, error_text))
+    return false;
+
+  return write_text_file(out_filename, std::string(compiled.begin(), compiled.end()), error_text);
+}
+
+/**
+ * \brief  Compile KEY=VALUE table file to hashed table, which is mapped by --table
+ * \param  in_filename       Table file path
+ * \param  out_filename      Compiled table file path
+ * \param  error_text [out]  Stream for error output
+ * \return true on success, false - have errors, info placed to error stream
+ */
+bool compile_table_file(const std::string& in_filename, const std::string& out_filename, std::ostream& error_text);
+
+/**
+ * \brief  Render compiled template file in one pass without searching text.
+ *         Literal text is written directly from the mapped file
+ * \param  in_filename       Compiled template file path
+ * \param  out_filename      Output file path, "-" for stdout
+ * \param  replace_table     Table with tokens and replaces
+ * \param  error_text [out]  Stream for error output
+ * \return true on success, false - have errors, info placed to error stream
+ */
+template<typename TString>
+bool render_template_file(
+  const std::string& in_filename,
+  const std::string& out_filename,
+  const std::map<TString, TString>& replace_table,
+  std::ostream& error_text) {
+
+  typedef typename TString::value_type CharType;
+
+  MappedFile mapping;
+  std::vector<char> data;
+  const char* compiled = nullptr;
+  size_t compiled_size = 0;
+
+  if (mapping.open(in_filename)) {
+    compiled = mapping.data();
+    compiled_size = mapping.size();
+  } else if (load_binary_file(in_filename, data)) {
+    compiled = data.data();
+    compiled_size = data.size();
+  } else {
+    error_text << "Cannot open infile " << in_filename << std::endl;
+    return false;
+  }
+
+  CompiledTemplate<TString> compiled_template;
+  if (!compiled_template.open(compiled, compiled_size)) {
+    error_text << "Infile is not a compiled template of this format " << in_filename << std::endl;
+    return false;
+  }
+
+  SliceSink<CharType> sink(compiled_template.text(), compiled_template.text_size());
+  compiled_template.render(replace_table, sink);
+
+#ifndef _WIN32
+  if (get_output_compression(out_filename) == kCompressionNone)
+    return write_slices_file(out_filename, sink, mapping.fd(), reinterpret_cast<const CharType*>(compiled), error_text);
+#endif /*_WIN32*/
+  TString text;
+  sink.materialize(text);
+  return write_text_file(out_filename, text, error_text);
+}
+
+/**
+ * \brief  Check whether command line value is a file reference: @FILENAME or $FILENAME
+ */
+bool is_file_value(const std::string& value);
+
+/**
+ * \brief  Value files loaded once for all tables which use them. Files are
+ *         identified by normalized path, so one file is loaded once under
+ *         different names. Thread-safe
+ */
+class ValueFileCache {
+public:
+  /**
+   * \param  is_validated  true for long-lived cache: a file is loaded again when its
+   *                       stamp is changed, and files are not mapped
+   * \param  max_size      Size of loaded files in bytes, above which least recently used
+   *                       files are dropped, 0 for no limit
+   */
+  explicit ValueFileCache(bool is_validated = false, uint64_t max_size = 0)
+    : is_validated_(is_validated), max_size_(max_size), size_(0) {
+  }
+
+  /**
+   * \brief  Load file or take already loaded content
+   * \param  filename  Path to file
+   * \return File content, nullptr when file cannot be loaded
+   */
+  std::shared_ptr<const FileContent> load(const std::string& filename) {
+    std::string path = normalize_path(filename);
+
+    // stamp is taken before loading, so a file changed while loading is loaded again next time
+    FileStamp stamp;
+    if (is_validated_ && !get_file_stamp(filename, stamp)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      remove_entry(path);   // removed file is not kept
+      return nullptr;
+    }
+
+    std::shared_ptr<Entry> entry;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::map<std::string, std::shared_ptr<Entry> >::iterator item = entries_.find(path);
+      if (item != entries_.end() && (!is_validated_ || item->second->stamp == stamp)) {
+        lru_.splice(lru_.begin(), lru_, item->second->position);
+        entry = item->second;
+      } else {
+        remove_entry(path);
+        entry = std::make_shared<Entry>();
+        entry->stamp = stamp;
+        lru_.push_front(path);
+        entry->position = lru_.begin();
+        entries_[path] = entry;
+      }
+    }
+
+    bool is_mapped = !is_validated_;
+    std::call_once(entry->once, [&filename, &entry, is_mapped]() {
+      std::shared_ptr<FileContent> file = std::make_shared<FileContent>();
+      if (file->open(filename, is_mapped))
+        entry->file = file;
+    });
+
+    if (max_size_ && entry->file) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::map<std::string, std::shared_ptr<Entry> >::iterator item = entries_.find(path);
+      if (item != entries_.end() && item->second == entry && !entry->is_counted) {
+        entry->is_counted = true;
+        size_ += entry->file->size();
+
+        // the file which is just loaded is kept, also when it is larger than the limit
+        while (size_ > max_size_ && lru_.size() > 1) {
+          std::string dropped_path = lru_.back();
+          remove_entry(dropped_path);
+        }
+      }
+    }
+
+    return entry->file;
+  }
+
+  /**
+   * \brief  Load files concurrently, so later load() calls take loaded content
+   * \param  filenames     Paths to files
+   * \param  threads_count Count of threads, 0 for count of hardware threads
+   */
+  void prefetch(const std::vector<std::string>& filenames, size_t threads_count) {
+    if (filenames.size() < 2) {
+      for (const std::string& filename : filenames)
+        load(filename);
+      return;
+    }
+
+    WorkStealingPool pool(std::min(filenames.size(), threads_count ? threads_count : std::max(1u, std::thread::hardware_concurrency())));
+    for (const std::string& filename : filenames)
+      pool.submit([this, &filename]() { load(filename); });
+    pool.wait();
+  }
+
+private:
+  struct Entry {
+    std::once_flag once;
+    std::shared_ptr<const FileContent> file;
+    FileStamp stamp;
+    std::list<std::string>::iterator position;   // in lru_
+    bool is_counted = false;                     // size is added to size_
+  };
+
+  /**
+   * \brief  Drop file from cache, content stays valid for its users. Must be called under lock
+   */
+  void remove_entry(const std::string& path) {
+    std::map<std::string, std::shared_ptr<Entry> >::iterator item = entries_.find(path);
+    if (item == entries_.end())
+      return;
+
+    if (item->second->is_counted)
+      size_ -= item->second->file->size();
+    lru_.erase(item->second->position);
+    entries_.erase(item);
+  }
+
+  bool is_validated_;
+  uint64_t max_size_;
+  uint64_t size_;                    // size of counted files
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<Entry> > entries_;
+  std::list<std::string> lru_;       // paths of entries, most recently used first
+};
+
+/**
+ * \brief  Load value of key from file
+ * \param  file_value             Command line value: @FILENAME or $FILENAME
+ * \param  value_files            Loaded value files
+ * \param  value [out]            Decoded value
+ * \param  failed_filename [out]  File which cannot be loaded
+ * \return true on success, false when the file cannot be loaded
+ */
+template<typename TString>
+bool load_file_value(const std::string& file_value, ValueFileCache& value_files, TString& value, std::string& failed_filename) {
+  std::string file_name = file_value.substr(1);
+  std::shared_ptr<const FileContent> file;
+  if (!file_name.size() || !(file = value_files.load(file_name))) {
+    failed_filename = file_name;
+    return false;
+  }
+
+  decode_value(file->data(), file->size(), file_value[0], value);
+  return true;
+}
+
+/**
+ * \brief  Build replace table from command line table: convert values to text
+ *         format and load values with @ or $ prefix from files
+ * \param  table                  Command line table
+ * \param  value_files            Loaded value files
+ * \param  replace_table [out]    Replace table, existing keys are overwritten
+ * \param  failed_filename [out]  File which cannot be loaded
+ * \return true on success, false when a file cannot be loaded
+ */
+template<typename TString>
+bool load_replace_table(
+  const std::map<std::string, std::string>& table,
+  ValueFileCache& value_files,
+  std::map<TString, TString>& replace_table,
+  std::string& failed_filename) {
+
+  for (const auto& item : table) {
+    TString key;
+    convert_value(item.first, key);
+    TString& value = replace_table[key];
+
+    if (!is_file_value(item.second)) {
+      convert_value(item.second, value);
+      continue;
+    }
+
+    if (!load_file_value(item.second, value_files, value, failed_filename))
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Build replace table for rendering of one template. Values with @ or $
+ *         prefix are loaded only when the template may use them (see KeyUsage),
+ *         other file keys are kept in table with empty values, as they are used
+ *         only by IFSET and IFNOTSET conditions. Files which are needed at once
+ *         are loaded concurrently
+ * \param  content                Content of template file, null when it cannot be read
+ * \param  table                  Command line table
+ * \param  is_meta_enabled        true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+ * \param  value_files            Loaded value files
+ * \param  replace_table [out]    Replace table
+ * \param  failed_filename [out]  File which cannot be loaded
+ * \param  loaded_files [out]     Value files which are loaded, may be null
+ * \return true on success, false when a file does not exist or a used file cannot be loaded
+ */
+template<typename TString, typename TParserParams>
+bool load_used_replace_table(
+  const FileContent* content,
+  const std::map<std::string, std::string>& table,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  ValueFileCache& value_files,
+  std::map<TString, TString>& replace_table,
+  std::string& failed_filename,
+  std::vector<std::string>* loaded_files = nullptr) {
+
+  std::map<TString, std::string> file_values;
+  for (const auto& item : table) {
+    TString key;
+    convert_value(item.first, key);
+    TString& value = replace_table[key];
+
+    if (!is_file_value(item.second)) {
+      convert_value(item.second, value);
+      continue;
+    }
+
+    std::error_code error;
+    std::string file_name = item.second.substr(1);
+    if (!file_name.size() || !std::filesystem::exists(file_name, error)) {
+      failed_filename = file_name;
+      return false;
+    }
+    file_values[key] = item.second;
+  }
+
+  // usage cannot be predicted, all values are loaded
+  auto load_all = [&]() {
+    if (loaded_files) {
+      for (const auto& item : file_values)
+        loaded_files->push_back(item.second.substr(1));
+    }
+    return load_replace_table(table, value_files, replace_table, failed_filename);
+  };
+
+  TString text;
+  if (file_values.empty() || !content)
+    return load_all();   // errors are reported by processing
+  to_str(content->data(), content->size(), text);
+
+  KeyUsage<TString, TParserParams> usage(replace_table, is_meta_enabled, parser_params);
+  if (!usage.parse_template(text))
+    return load_all();
+
+  std::vector<typename std::map<TString, TString>::iterator> items;
+  std::vector<bool> is_file_key;
+  for (typename std::map<TString, TString>::iterator i = replace_table.begin(); i != replace_table.end(); i++) {
+    items.push_back(i);
+    is_file_key.push_back(file_values.count(i->first) != 0);
+  }
+
+  std::vector<bool> used(items.size());
+  std::vector<bool> is_loaded(items.size());    // file value is loaded
+  std::vector<bool> is_scanned(items.size());   // value is scanned for keys
+  bool is_template_scanned = false;
+  usage.mark_condition_keys(used);
+
+  while (true) {
+    std::vector<std::string> filenames;
+    for (size_t i = 0; i < items.size(); i++) {
+      if (used[i] && is_file_key[i] && !is_loaded[i])
+        filenames.push_back(file_values[items[i]->first].substr(1));
+    }
+    value_files.prefetch(filenames, 0);
+
+    for (size_t i = 0; i < items.size(); i++) {
+      if (used[i] && is_file_key[i] && !is_loaded[i]) {
+        if (!load_file_value(file_values[items[i]->first], value_files, items[i]->second, failed_filename))
+          return false;
+        is_loaded[i] = true;
+      }
+    }
+
+    if (!is_template_scanned) {   // values of IFCONTAINS conditions are loaded
+      usage.scan_template(text, replace_table, used);
+      is_template_scanned = true;
+      continue;
+    }
+
+    std::vector<bool> candidates(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+      candidates[i] = is_file_key[i] && !used[i];
+
+    for (size_t i = 0; i < items.size(); i++) {
+      if (!used[i] || is_scanned[i])
+        continue;
+
+      is_scanned[i] = true;
+      if (!usage.scan_value(items[i]->second, candidates, used))
+        return load_all();
+    }
+
+    bool has_new_keys = false;
+    for (size_t i = 0; i < items.size(); i++)
+      has_new_keys = has_new_keys || (used[i] && !is_scanned[i]);
+
+    if (!has_new_keys) {
+      for (size_t i = 0; loaded_files && i < items.size(); i++) {
+        if (is_loaded[i])
+          loaded_files->push_back(file_values[items[i]->first].substr(1));
+      }
+      return true;
+    }
+  }
+}
+
+#endif  // FILEREPLACE_FILE_PROCESSING_H_
@@ -0,0 +1,68 @@
+#ifndef FILEREPLACE_FILE_STAMP_H_
+#define FILEREPLACE_FILE_STAMP_H_
+
+#include <stdint.h>
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif /*_WIN32*/
+
+
+/**
+ * \brief  Identity and version of file: device, inode, size and modification time.
+ *         A file replaced by rename or changed in place gets another stamp.
+ *         On Windows device and inode are not known and are 0
+ */
+struct FileStamp {
+  uint64_t device = 0;
+  uint64_t inode = 0;
+  uint64_t size = 0;
+  int64_t time = 0;    // modification time, nanoseconds on POSIX
+
+  bool operator==(const FileStamp& other) const {
+    return device == other.device && inode == other.inode && size == other.size && time == other.time;
+  }
+
+  bool operator!=(const FileStamp& other) const {
+    return !(*this == other);
+  }
+};
+
+/**
+ * \brief  Get stamp of file
+ * \param  filename     Path to file
+ * \param  stamp [out]  File stamp
+ * \return false when file does not exist
+ */
+inline bool get_file_stamp(const std::string& filename, FileStamp& stamp) {
+#ifndef _WIN32
+  struct stat file_stat;
+  if (stat(filename.c_str(), &file_stat))
+    return false;
+
+  stamp.device = static_cast<uint64_t>(file_stat.st_dev);
+  stamp.inode = static_cast<uint64_t>(file_stat.st_ino);
+  stamp.size = static_cast<uint64_t>(file_stat.st_size);
+#ifdef __APPLE__
+  stamp.time = static_cast<int64_t>(file_stat.st_mtimespec.tv_sec) * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+  stamp.time = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+#endif
+  return true;
+#else  /*_WIN32*/
+  std::error_code error;
+  stamp = FileStamp();
+  stamp.size = std::filesystem::file_size(filename, error);
+  if (error)
+    return false;
+
+  stamp.time = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+  return !error;
+#endif /*_WIN32*/
+}
+
+#endif  // FILEREPLACE_FILE_STAMP_H_
@@ -1,567 +1,2313 @@
-
-#include <string>
-#include <map>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-#include <algorithm>
-#include <memory>
-#include <vector>
-
-
-static const std::string kAnsiIfSetToken = "!%@IFSET[";
-static const std::string kAnsiEndIfToken = "!%@ENDIF%";
-static const std::string kAnsiBracketCloseToken = "]";
-
-static const std::wstring kUtf16IfSetToken = L"!%@IFSET[";
-static const std::wstring kUtf16EndIfToken = L"!%@ENDIF%";
-static const std::wstring kUtf16BracketCloseToken = L"]";
-
-static const std::string kAnsiIfNotSetToken = "!%@IFNOTSET[";
-static const std::wstring kUtf16IfNotSetToken = L"!%@IFNOTSET[";
-
-static const std::string kAnsiIfContainsToken = "!%@IFCONTAINS[";
-static const std::string kAnsiBracketOpenToken = "[";
-
-static const std::wstring kUtf16IfContainsToken = L"!%@IFCONTAINS[";
-static const std::wstring kUtf16BracketOpenToken = L"[";
-
-
-struct ParserParamsAnsi {
-  std::string bracket_open_token_ = kAnsiBracketOpenToken;
-  std::string bracket_close_token_ = kAnsiBracketCloseToken;
-
-  std::string if_set_token_ = kAnsiIfSetToken;
-  std::string end_if_token_ = kAnsiEndIfToken;
-
-  std::string if_not_set_token_ = kAnsiIfNotSetToken;
-  std::string if_contains_token_ = kAnsiIfContainsToken;
-};
-
-struct ParserParamsUtf16 {
-  std::wstring bracket_open_token_ = kUtf16BracketOpenToken;
-  std::wstring bracket_close_token_ = kUtf16BracketCloseToken;
-
-  std::wstring if_set_token_ = kUtf16IfSetToken;
-  std::wstring end_if_token_ = kUtf16EndIfToken;
-
-  std::wstring if_not_set_token_ = kUtf16IfNotSetToken;
-  std::wstring if_contains_token_ = kUtf16IfContainsToken;
-};
-
-
-static std::string wstring2string(const std::wstring& str) {
-  size_t converted_chars_count;
-
-  std::shared_ptr<char> buffer(new char[str.length() + 1], [](char* p) { delete[] p; });
-  buffer.get()[str.length()] = 0;
-
-#ifdef _WIN32
-  wcstombs_s(&converted_chars_count, buffer.get(), str.length() + 1, str.c_str(), str.length());
-#else  /*_WIN32*/
-  converted_chars_count = wcstombs(buffer.get(), str.c_str(), str.length() * sizeof(wchar_t));
-#endif /*_WIN32*/
-  (void)converted_chars_count;
-  return std::string(buffer.get(), str.length());
-}
-
-
-static std::wstring string2wstring(const std::string& str) {
-  size_t converted_chars_count;
-  std::shared_ptr<wchar_t> buffer(new wchar_t[str.length() + 1], [](wchar_t* p) { delete[] p; });
-  buffer.get()[str.length()] = 0;
-
-#ifdef _WIN32
-  mbstowcs_s(&converted_chars_count, buffer.get(), str.length() + 1, str.c_str(), str.length());
-#else  /*_WIN32*/
-  numOfConvertedChars = mbstowcs(buffer.get(), str.c_str(), str.length());
-#endif /*_WIN32*/
-  return std::wstring(buffer.get(), str.length());
-}
-
-
-/**
- * \brief   Calculate line number by index in text
- * \param   text  [in,out]      Text string
- * \param   position            Position index in string
- * \return  Line number from 1
- */
-template<typename TString>
-int get_line_number(const TString& text, size_t position) {
-  int line_num = 1;
-  for (size_t i = 0; i < std::min(position, text.size()); i++) {
-    if (text[i] == '\n')
-      ++line_num;
-  }
-
-  return line_num;
-}
-
-/**
- * \brief  Replace tokens in string. 
- * \param  text [in,out]         Text string
- * \param  find_token            Token which must be replaced in string
- * \param  replace_to_token      Token to replace with
- * \param  replaces_count [out]  Actual replaces count
- */
-template<typename TString>
-TString& replace_string(TString& text, const TString& find_token, const TString& replace_to_token, int& replaces_count) {
-  TString::size_type token_offset = 0;
-  replaces_count = 0;
-
-  while ((token_offset = text.find(find_token, token_offset)) != TString::npos) {
-    ++replaces_count;
-    text = text.replace(token_offset,find_token.size(),replace_to_token);
-    token_offset += replace_to_token.size();
-  }
-
-  text = TString(text.c_str());
-  return text;
-}
-
-static void to_str(const std::vector<char>& text, std::string& str) {
-  str = std::string(text.data(), text.size());
-  str = std::string(str.c_str());
-}
-
-static void to_str(const std::vector<char>& text, std::wstring& str) {
-  str = std::wstring(reinterpret_cast<const wchar_t*>(text.data()), text.size() / sizeof(std::wstring::value_type));
-  str = std::wstring(str.c_str());
-}
-
-/**
- * \brief  Load file content from text file
- * \param  filename            Path to file
- * \param  text [out]          Output file contents
- * \return true on success, false when file cannot be opened, or file is too big
- */
-bool load_text_file(const std::string& filename, std::vector<char>& text) {
-  static const fpos_t kMaxFileSize = 0x100000000;
-  text.clear();
-
-  std::ifstream infile(filename, std::ios::in);
-  if (!infile.is_open()) {
-    return false;
-  }
-
-  infile.seekg(0, std::ios::end);
-  fpos_t file_size = infile.tellg();
-  infile.seekg(0, std::ios::beg);
-
-  if (file_size > kMaxFileSize) {
-    return false;
-  }
-
-  text.resize(static_cast<unsigned int>(file_size));
-  infile.read(
-	  reinterpret_cast<char*>(&(*text.begin())),
-	  static_cast<std::streamsize>(file_size));
-  
-  return true;
-}
-
-
-/**
- * \brief  Process IFSET macro in text
- * \param  text [in,out]     Text string
- * \param  replace_table     Table with tokens and replaces
- * \param  error_text [out]  Stream for error output
- */
-template<typename TString, typename TParserParams>
-bool process_ifset(
-  TString& text, 
-  const std::map<TString, TString>& replace_table,
-  const TParserParams& parser_params,
-  std::ostream& error_text) {
-
-  while (true) {
-
-    TString::size_type macro_start_pos = text.find(parser_params.if_set_token_);
-    if (macro_start_pos == TString::npos)
-      break;
-
-    TString::size_type token_start_pos = macro_start_pos + parser_params.if_set_token_.size();
-    TString::size_type token_end_pos = text.find(parser_params.bracket_close_token_, token_start_pos);
-
-    if (token_end_pos == TString::npos) {
-      error_text << "IFSET macro syntax error on line " << get_line_number(text, token_start_pos) << std::endl;
-      return false;
-    }
-
-    TString tpl = text.substr(token_start_pos,token_end_pos - token_start_pos);
-
-    TString::size_type macro_end_pos = text.find(parser_params.end_if_token_, token_start_pos);
-    if (macro_end_pos == TString::npos) {
-      error_text << "IFSET macro end not found, syntax error on line " << get_line_number(text, token_start_pos) << std::endl;
-      return false;
-    }
-
-    if (replace_table.find(tpl) == replace_table.end()) {
-      text.replace(macro_start_pos, macro_end_pos - macro_start_pos + parser_params.end_if_token_.size(), TString());
-    } else {
-      text.replace(macro_end_pos, parser_params.end_if_token_.size(), TString());
-      text.replace(macro_start_pos, parser_params.if_set_token_.size() + tpl.size() + parser_params.bracket_close_token_.size(), TString());
-    }
-  }
-
-  text = TString(text.c_str()); // because string::replace does not resize output string size, it may contains '0' on the end
-
-  return true;
-}
-
-
-/**
- * \brief  Process IFNOTSET macro in text
- * \param  text [in,out]     Text string
- * \param  replace_table     Table with tokens and replaces
- * \param  error_text [out]  Stream for error output
- */
-template<typename TString, typename TParserParams>
-bool process_ifnotset(
-  TString& text, 
-  const std::map<TString, TString>& replace_table,
-  const TParserParams& parser_params,
-  std::ostream& error_text) {
-
-  while (true) {
-    TString::size_type macro_start_pos = text.find(parser_params.if_not_set_token_);
-    if (macro_start_pos == TString::npos)
-      break;
-
-    TString::size_type token_start_pos = macro_start_pos + parser_params.if_not_set_token_.size();
-    TString::size_type token_end_pos = text.find(parser_params.bracket_close_token_, token_start_pos);
-
-    if (token_end_pos == TString::npos) {
-      error_text << "IFNOTSET macro syntax error on line " << get_line_number(text, token_start_pos) << std::endl;
-      return false;
-    }
-
-    TString tpl = text.substr(token_start_pos,token_end_pos - token_start_pos);
-
-    TString::size_type macro_end_pos = text.find(parser_params.end_if_token_, token_start_pos);
-    if (macro_end_pos == TString::npos) {
-      error_text << "IFNOTSET macro end not found, syntax error on line " << get_line_number(text, token_start_pos) << std::endl;
-      return false;
-    }
-
-    if (replace_table.find(tpl) != replace_table.end()) {
-      text.replace(macro_start_pos, macro_end_pos - macro_start_pos + parser_params.end_if_token_.size(), TString());
-    }
-    else {
-      text.replace(macro_end_pos, parser_params.end_if_token_.size(), TString());
-      text.replace(macro_start_pos, parser_params.if_not_set_token_.size() + tpl.size() + parser_params.bracket_close_token_.size(), TString());
-    }
-  }
-
-  text = TString(text.c_str()); 
-
-  return true;
-}
-
-
-/**
- * \brief  Process IFCONTAINS macro in text
- * \param  text [in,out]     Text string
- * \param  replace_table     Table with tokens and replaces
- * \param  error_text [out]  Stream for error output
- */
-template<typename TString, typename TParserParams>
-bool process_ifcontains(
-  TString& text, 
-  const std::map<TString, TString>& replace_table,
-  const TParserParams& parser_params,
-  std::ostream& error_text) {
-
-
-  while (true) {
-	  TString::size_type start_pos = text.find(parser_params.if_contains_token_);
-    if (start_pos == TString::npos)
-      break;
-
-	TString::size_type token_start_pos = start_pos + parser_params.if_contains_token_.size();
-	TString::size_type token_end_pos = text.find(parser_params.bracket_close_token_, token_start_pos);
-
-    if (token_end_pos == TString::npos) {
-      error_text << "IFCONTAINS macro syntax error on line " << get_line_number(text, token_start_pos) << std::endl;
-      return false;
-    }
-
-	TString tpl = text.substr(token_start_pos,token_end_pos - token_start_pos);
-
-    if (text.size() <= token_end_pos + parser_params.bracket_close_token_.size() || text[token_end_pos + parser_params.bracket_close_token_.size()] != parser_params.bracket_open_token_[0]) {
-      error_text << "IFCONTAINS macro syntax error" << get_line_number(text, token_start_pos) << std::endl;
-      return false;
-    }
-
-	TString::size_type second_token_start_pos = token_end_pos + parser_params.bracket_close_token_.size() + parser_params.bracket_open_token_.size();
-	TString::size_type second_token_end_pos = text.find(parser_params.bracket_close_token_, second_token_start_pos);
-    if (second_token_end_pos == TString::npos) {
-      error_text << "IFCONTAINS macro syntax error" << get_line_number(text, second_token_start_pos) << std::endl;
-      return false;
-    }
-
-	TString second_tpl = text.substr(second_token_start_pos,second_token_end_pos - second_token_start_pos);
-
-    bool leave = false;
-
-    std::map<TString, TString>::const_iterator template_it = replace_table.find(tpl);
-
-    if (template_it != replace_table.end()) {
-      if (template_it->second.find(second_tpl) != TString::npos)
-        leave = true;
-    }
-
-    if (leave) {
-      text.replace(
-		  start_pos,
-		  parser_params.if_contains_token_.size() + tpl.size() + second_tpl.size() + parser_params.bracket_close_token_.size() + parser_params.bracket_open_token_.size() + parser_params.bracket_close_token_.size(),
-		  TString());
-
-	  TString::size_type end_pos = text.find(parser_params.end_if_token_, token_start_pos);
-      if (end_pos != TString::npos)
-        text.replace(end_pos, parser_params.end_if_token_.size(), TString());
-    } else {
-		TString::size_type end_pos = text.find(parser_params.end_if_token_, token_start_pos);
-      text.replace(start_pos,end_pos == TString::npos ? text.size() - start_pos : end_pos - start_pos + parser_params.end_if_token_.size(), TString());
-    }
-  }
-
-  text = TString(text.c_str());
-
-  return true;
-}
-
-/**
- * \brief  Process file multipass replacing procedure
- * \param  in_filename       Input file path
- * \param  out_filename      Output file path. May be the same as input for overwrite
- * \param  replace_table     Table with tokens and replaces
- * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
- * \param  error_text [out]  Stream for error output
- * \return true on success, false - have errors, info placed to error stream
- */
-template<typename TString, typename TParserParams>
-bool process_file_content(
-  const std::string& in_filename, 
-  const std::string& out_filename, 
-  const std::map<TString, TString>& replace_table,
-  bool is_meta_enabled,
-  const TParserParams& parser_params,
-  std::ostream& error_text) {
-
-  std::vector<char> data;
-  
-  if (!load_text_file(in_filename, data)) {
-    error_text << "Cannot open infile " << in_filename << std::endl;
-    return false;
-  }
-
-  if (!data.size())
-    return true;
-
-  TString text;
-  to_str(data, text);
-
-  while (true) {   // process multiple passes
-    int current_pass_replaces = 0;
-
-    // process meta
-    if (is_meta_enabled) {
-      if (!process_ifset(text, replace_table, parser_params, error_text)
-        || !process_ifnotset(text, replace_table, parser_params, error_text)
-        || !process_ifcontains(text, replace_table, parser_params, error_text)) {
-        return false;
-      }
-    }
-
-    // process replace table
-    for (std::map<TString, TString>::const_iterator i = replace_table.begin();
-      i != replace_table.end();
-      i++) {
-      int current_replaces;
-      text = replace_string(text, i->first, i->second, current_replaces);
-      current_pass_replaces += current_replaces;
-    }
-
-    if (!current_pass_replaces)
-      break;
-  }
-
-  std::ofstream outfile(out_filename, std::ios::out | std::ios::trunc | std::ios::binary);
-  if (!outfile.is_open()) {
-    error_text << "Cannot create outfile " << out_filename << std::endl;
-    return false;
-  }
-
-  outfile.write(reinterpret_cast<const char*>(text.c_str()), text.size() * sizeof(TString::value_type));
-  if (outfile.fail()) {
-    error_text << "Cannot write outfile, disk is full? " << out_filename << std::endl;
-    return false;
-  }
-
-  outfile.flush();
-  return true;
-}
-
-/**
- * \brief    Command line tool help
- */
-void usage() {
-  std::cout << "File token replace tool" << std::endl;
-  std::cout << "Usage: filereplace <infile> <outfile> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
-  std::cout << "File replacer can replace tokens in one or more files" << std::endl;
-  std::cout << "You can place some special tokens to template files like !(TEMPLATE)" << std::endl;
-  std::cout << "File replacer also provide some meta-constructions in template files:" << std::endl;
-  std::cout << "   !%@IFSET[TPL] ... !%@ENDIF%    - leave text block if template TPL is set to" << std::endl;
-  std::cout << "                                    any value or remove if not set" << std::endl;
-  std::cout << "   !%@IFNOTSET[TPL]... !%@ENDIF%  - leave text block if template TPL is not set" << std::endl;
-  std::cout << "                                    or remove if it set to any value" << std::endl;
-  std::cout << "   !%@IFCONTAINS[TPL][TOKEN] ... !%@ENDIF% - leave text block if template TPL" << std::endl;
-  std::cout << "                                    contains token 'TOKEN' in value." << std::endl;
-  std::cout << "                                    Compare is case-sensitive" << std::endl;
-  std::cout << "Keys:" << std::endl;
-  std::cout << "   -w or --unicode       - input file has UTF16 format (default - ANSI)" << std::endl;
-  std::cout << "   -d or --disable-meta  - disable metalanguage in processed files." << std::endl;
-  std::cout << "   -e of --enable-meta   - enable metalanguage in processed files" << std::endl;
-  std::cout << "   Metalanguate is enabled by default" << std::endl;
-  std::cout << "All template arguments are case sensitive" << std::endl;
-  std::cout << "   <arg> must be template string" << std::endl;
-  std::cout << "   <val> may be string or file path. If used file path it must be prefix" << std::endl;
-  std::cout << "         with @ or $ token: TPL=@C:\\file.txt or TPL=$C:\\file.txt" << std::endl;
-  std::cout << "         @ is used for ANSI files, $ for UTF16 files" << std::endl;
-  std::cout << "EXAMPLE:" << std::endl;
-  std::cout << "   filereplace file.txt !(TPL1)=1.0.23 \"!(TPL2)=HELLO WORLD\" !(TPL3)=MODULE_1;MODULE_2;" << std::endl;
-  std::cout << "  Source file content:" << std::endl;
-  std::cout << "VERSION=!(TPL1) STRING '!(TPL2)'" << std::endl;
-  std::cout << "!%@IFCONTAINS[!(TPL3)][MODULE_2;]MODULE2 !(TPL2)!%@ENDIF%" << std::endl;
-  std::cout << "!%@IFCONTAINS[!(TPL3)][MODULE_3;]MODULE3 !(TPL1)!%@ENDIF%" << std::endl << std::endl;
-  std::cout << "  Result file content after processing finished:" << std::endl;
-  std::cout << "VERSION=1.0.23 STRING 'HELLO WORLD'" << std::endl;
-  std::cout << "MODULE2 HELLO WORLD" << std::endl << std::endl;
-}
-
-int main(int argc, char* argv[]) {
-  if (argc < 3) {
-    usage();
-    return 255;
-  }
-
-  std::map<std::string, std::string> replace_table;
-  std::string in_filename = argv[1];
-  std::string out_filename = argv[2];
-  
-  bool is_meta_enabled = true;
-  bool is_utf16 = false;
-
-  for (int i = 3; i < argc; i++) {
-    std::string arg = argv[i];
-    std::string::size_type equal_token_pos = arg.find_first_of('=');
-
-    if (equal_token_pos == std::string::npos) {
-      if (arg.size() && arg[0] != '-') {
-        std::cerr << "command line error: equal sign is not found in <template>=<value> construction" << std::endl;
-        return 254;
-      }
-
-      arg = arg.substr(1);
-
-      if (arg == "-disable-meta" || arg == "d") {
-        std::cout << "Meta language is disabled" << std::endl;
-        is_meta_enabled = false;
-        continue;
-      }
-
-      if (arg == "-enable-meta" || arg == "e") {
-        std::cout << "Meta language is enabled" << std::endl;
-        is_meta_enabled = true;
-        continue;
-      }
-	  
-	  if (arg == "w" || arg == "-unicode") {
-		std::cout << "file format set UTF16" << std::endl;
-		is_utf16 = true;
-		continue;
-	  }
-
-      std::cerr << "Key was not recognized: " << arg << std::endl;
-    }
-
-    std::string key = arg.substr(0, equal_token_pos);
-    std::string value = arg.substr(equal_token_pos + 1);
-    replace_table[key] = value;
-  }
-  
-  std::map<std::wstring, std::wstring> replace_table_utf16;
-  std::map<std::string, std::string> replace_table_ansi;
-  
-  for (const auto& item : replace_table) {
-	if (!item.second.size() || (item.second[0] != '@' && item.second[0] != '$')) {
-		if (is_utf16)
-			replace_table_utf16.insert(std::make_pair(string2wstring(item.first), string2wstring(item.second)));
-		else
-			replace_table_ansi.insert(item);
-
-		continue;
-	}
-	
-	char token = item.second[0];
-    std::string file_name = item.second.substr(1);
-
-	std::vector<char> data;
-	if (!file_name.size() || !load_text_file(file_name, data)) {
-      std::cerr << "Cannot load file content " << file_name << std::endl;
-      return 253;
-	}
-
-	if (is_utf16) {
-		std::wstring value;
-		if (token == '@') {  // load as ansi and convert to unicode
-			std::string origin;
-			to_str(data, origin);
-			value = string2wstring(origin);
-		}
-		else if (token == '$') { // load as unicode for unicode
-			to_str(data, value);
-		}
-		replace_table_utf16.insert(std::make_pair(string2wstring(item.first), value));
-
-	}
-	else {
-		std::string value;
-
-		if (token == '@') { // load as ansi for ansi
-			to_str(data, value);
-		}
-		else if (token == '$') { // load as unicode and convert to ansi
-			std::wstring origin;
-			to_str(data, origin);
-			value = wstring2string(origin);
-		}
-		
-		replace_table_ansi.insert(std::make_pair(item.first, value));
-	}
-  }
-
-  std::stringstream error_text;
-
-  if (!is_utf16) {
-	  ParserParamsAnsi parser_params_ansi;
-
-	  if (!process_file_content(in_filename, out_filename, replace_table, is_meta_enabled, parser_params_ansi, error_text)) {
-		  std::cerr << error_text.str();
-		  return 252;
-	  }
-  }
-  else {
-	  ParserParamsUtf16 parser_params_utf16;
-
-	  if (!process_file_content(in_filename, out_filename, replace_table_utf16, is_meta_enabled, parser_params_utf16, error_text)) {
-		  std::cerr << error_text.str();
-		  return 252;
-	  }
-  }
-
-
-
-  return 0;
-}
+#include "filereplace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <map>
+#include <set>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif /*__linux__*/
+#endif /*_WIN32*/
+
+#include "compiled_template.h"
+#include "compressed_stream.h"
+#include "content_hash.h"
+#include "file_processing.h"
+#include "file_stamp.h"
+#include "invocation_record.h"
+#include "key_usage.h"
+#include "libfilereplace.h"
+#include "local_socket.h"
+#include "mapped_file.h"
+#include "path_glob.h"
+#include "phase_stats.h"
+#include "render_cache.h"
+#include "slice_output.h"
+#include "stream_renderer.h"
+#include "table_file.h"
+#include "text_encoding.h"
+#include "thread_pool.h"
+#include "tree_state.h"
+
+static const std::string kPlaceholderName = "NAME";             // name in placeholder pattern
+static const std::string kDefaultPlaceholderPattern = "!(NAME)";
+static const int kDefaultDebounceTime = 100;                     // milliseconds of watch mode
+static const std::string kTreeStateName = ".filereplace-state";  // state file in target directory of tree
+
+
+/**
+ * \brief  Placeholder format from command line pattern <open>NAME<close>
+ * \param  pattern  Pattern, empty when placeholder mode is disabled
+ */
+template<typename TString>
+static PlaceholderFormat<TString> get_placeholder_format(const std::string& pattern) {
+  PlaceholderFormat<TString> placeholders;
+  std::string::size_type name_pos = pattern.find(kPlaceholderName);
+  if (name_pos != std::string::npos) {
+    convert_value(pattern.substr(0, name_pos), placeholders.open_token);
+    convert_value(pattern.substr(name_pos + kPlaceholderName.size()), placeholders.close_token);
+  }
+  return placeholders;
+}
+
+/**
+ * \brief  Job of manifest: one input file rendered to one output file
+ */
+struct BatchJob {
+  std::string in_filename;
+  std::string out_filename;
+  std::map<std::string, std::string> table;   // overrides of shared table
+  std::vector<size_t> dependents;             // jobs which use the output of this job
+  size_t dependencies_count = 0;
+  int status = 0;
+  std::string errors;
+};
+
+/**
+ * \brief  Split manifest line to arguments. Arguments are separated by spaces,
+ *         double quotes group an argument with spaces
+ */
+static std::vector<std::string> split_arguments(const std::string& line) {
+  std::vector<std::string> arguments;
+  std::string argument;
+  bool is_quoted = false;
+  bool has_argument = false;
+
+  for (char c : line) {
+    if (c == '"') {
+      is_quoted = !is_quoted;
+      has_argument = true;
+    } else if (!is_quoted && (c == ' ' || c == '\t')) {
+      if (has_argument)
+        arguments.push_back(argument);
+      argument.clear();
+      has_argument = false;
+    } else {
+      argument += c;
+      has_argument = true;
+    }
+  }
+
+  if (has_argument)
+    arguments.push_back(argument);
+
+  return arguments;
+}
+
+/**
+ * \brief  Load manifest file. Each line is a job: <infile> <outfile> [<arg>=<val> ...]
+ *         Empty lines and lines started with # are skipped
+ * \param  filename          Manifest path
+ * \param  jobs [out]        Jobs in manifest order
+ * \param  error_text [out]  Stream for error output
+ * \return true on success
+ */
+static bool load_manifest(const std::string& filename, std::vector<BatchJob>& jobs, std::ostream& error_text) {
+  std::vector<char> data;
+  if (!load_text_file(filename, data)) {
+    error_text << "Cannot open manifest " << filename << std::endl;
+    return false;
+  }
+
+  std::string text;
+  to_str(data, text);
+  std::istringstream lines(text);
+  std::string line;
+
+  for (int line_number = 1; std::getline(lines, line); line_number++) {
+    if (line.size() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+
+    std::vector<std::string> arguments = split_arguments(line);
+    if (arguments.empty() || arguments[0][0] == '#')
+      continue;
+
+    if (arguments.size() < 2) {
+      error_text << "manifest error on line " << line_number << ": <infile> <outfile> expected" << std::endl;
+      return false;
+    }
+
+    BatchJob job;
+    job.in_filename = arguments[0];
+    job.out_filename = arguments[1];
+
+    for (size_t i = 2; i < arguments.size(); i++) {
+      std::string::size_type equal_token_pos = arguments[i].find_first_of('=');
+      if (equal_token_pos == std::string::npos) {
+        error_text << "manifest error on line " << line_number << ": equal sign is not found in <template>=<value> construction" << std::endl;
+        return false;
+      }
+
+      job.table[arguments[i].substr(0, equal_token_pos)] = arguments[i].substr(equal_token_pos + 1);
+    }
+
+    jobs.push_back(job);
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Process all jobs of manifest on thread pool. A job which uses output of
+ *         another job as infile or as @file/$file value is started after that job
+ * \param  jobs [in,out]     Jobs, status and errors are set for each job
+ * \param  shared_table      Command line table, shared by all jobs
+ * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+ * \param  is_stream         true for stream mode
+ * \param  window_size       Window size for stream mode
+ * \param  placeholders      Placeholder mode, disabled when tokens are empty
+ * \param  is_expanded       true for resolving keys inside values when tables are built
+ * \param  render_cache      Render cache, nullptr when disabled
+ * \param  threads_count     Count of threads, 0 for count of hardware threads
+ * \return Exit code: 0 when all jobs succeeded, otherwise status of the first failed job
+ */
+template<typename TString, typename TParserParams>
+int process_manifest(
+  std::vector<BatchJob>& jobs,
+  const std::map<std::string, std::string>& shared_table,
+  bool is_meta_enabled,
+  bool is_stream,
+  size_t window_size,
+  const TParserParams& parser_params,
+  const PlaceholderFormat<TString>& placeholders,
+  bool is_expanded,
+  RenderCache* render_cache,
+  size_t threads_count) {
+
+  std::map<std::string, size_t> producers;   // normalized outfile -> job
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!producers.insert(std::make_pair(normalize_path(jobs[i].out_filename), i)).second) {
+      std::cerr << "manifest error: outfile is used by several jobs " << jobs[i].out_filename << std::endl;
+      return 254;
+    }
+  }
+
+  // shared values which are not produced by jobs are loaded once
+  std::map<std::string, std::string> shared_static_table;
+  std::map<std::string, std::string> shared_produced_table;
+  for (const auto& item : shared_table) {
+    bool is_produced = is_file_value(item.second) && producers.count(normalize_path(item.second.substr(1)));
+    (is_produced ? shared_produced_table : shared_static_table).insert(item);
+  }
+
+  ValueFileCache value_files;
+  std::map<TString, TString> shared_replace_table;
+  std::string failed_filename;
+  if (!load_replace_table(shared_static_table, value_files, shared_replace_table, failed_filename)) {
+    std::cerr << "Cannot load file content " << failed_filename << std::endl;
+    return 253;
+  }
+
+  // jobs without own values render with one compiled table
+  std::unique_ptr<ReplaceTable<TString, TParserParams> > shared_compiled_table =
+    build_replace_table(shared_replace_table, is_meta_enabled, parser_params, placeholders, is_expanded, std::cerr);
+  if (!shared_compiled_table)
+    return 253;
+
+  // dependency graph
+  for (size_t i = 0; i < jobs.size(); i++) {
+    std::set<size_t> dependencies;
+    std::vector<std::string> used_files(1, jobs[i].in_filename);
+    for (const auto& item : shared_produced_table)
+      used_files.push_back(item.second.substr(1));
+    for (const auto& item : jobs[i].table) {
+      if (is_file_value(item.second))
+        used_files.push_back(item.second.substr(1));
+    }
+
+    for (const std::string& used_file : used_files) {
+      std::map<std::string, size_t>::const_iterator producer = producers.find(normalize_path(used_file));
+      if (producer != producers.end() && producer->second != i)
+        dependencies.insert(producer->second);
+    }
+
+    for (size_t dependency : dependencies)
+      jobs[dependency].dependents.push_back(i);
+    jobs[i].dependencies_count = dependencies.size();
+  }
+
+  // jobs in dependency cycles and jobs which depend on them are never ready
+  std::vector<size_t> ready;
+  std::vector<size_t> waiting_count(jobs.size());
+  for (size_t i = 0; i < jobs.size(); i++) {
+    waiting_count[i] = jobs[i].dependencies_count;
+    if (!waiting_count[i])
+      ready.push_back(i);
+  }
+
+  std::vector<bool> is_schedulable(jobs.size());
+  for (size_t i = 0; i < ready.size(); i++) {
+    is_schedulable[ready[i]] = true;
+    for (size_t dependent : jobs[ready[i]].dependents) {
+      if (!--waiting_count[dependent])
+        ready.push_back(dependent);
+    }
+  }
+
+  std::unique_ptr<std::atomic<size_t>[]> pending(new std::atomic<size_t>[jobs.size()]);
+  std::unique_ptr<std::atomic<bool>[]> is_dependency_failed(new std::atomic<bool>[jobs.size()]);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    pending[i] = jobs[i].dependencies_count;
+    is_dependency_failed[i] = false;
+
+    if (!is_schedulable[i]) {
+      jobs[i].status = 253;
+      jobs[i].errors = "Cannot load file content, dependency cycle for outfile " + jobs[i].out_filename + "\n";
+    }
+  }
+
+  WorkStealingPool pool(threads_count);
+
+  std::function<void(size_t)> run_job = [&](size_t index) {
+    BatchJob& job = jobs[index];
+    std::stringstream error_text;
+
+    if (is_dependency_failed[index]) {
+      job.status = 253;
+      error_text << "Cannot load file content, dependency failed for outfile " << job.out_filename << std::endl;
+    } else {
+      std::unique_ptr<ReplaceTable<TString, TParserParams> > job_compiled_table;
+      const ReplaceTable<TString, TParserParams>* replace_table = shared_compiled_table.get();
+
+      if (!shared_produced_table.empty() || !job.table.empty()) {
+        std::map<TString, TString> job_replace_table = shared_replace_table;
+        std::string job_failed_filename;
+        if (!load_replace_table(shared_produced_table, value_files, job_replace_table, job_failed_filename)
+          || !load_replace_table(job.table, value_files, job_replace_table, job_failed_filename)) {
+          job.status = 253;
+          error_text << "Cannot load file content " << job_failed_filename << std::endl;
+        } else {
+          job_compiled_table = build_replace_table(std::move(job_replace_table), is_meta_enabled, parser_params, placeholders, is_expanded, error_text);
+          replace_table = job_compiled_table.get();
+          if (!replace_table)
+            job.status = 253;
+        }
+      }
+
+      if (!job.status) {
+        if (!process_file(job.in_filename, job.out_filename, *replace_table, is_stream, window_size, 1, render_cache, error_text))
+          job.status = 252;
+      }
+    }
+
+    job.errors = error_text.str();
+
+    for (size_t dependent : job.dependents) {
+      if (job.status)
+        is_dependency_failed[dependent] = true;
+      if (!--pending[dependent])
+        pool.submit(std::bind(run_job, dependent));
+    }
+  };
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (is_schedulable[i] && !jobs[i].dependencies_count)
+      pool.submit(std::bind(run_job, i));
+  }
+
+  pool.wait();
+
+  int exit_code = 0;
+  for (const BatchJob& job : jobs) {
+    std::cout << "[" << job.status << "] " << job.in_filename << " -> " << job.out_filename << std::endl;
+    std::cerr << job.errors;
+    if (job.status && !exit_code)
+      exit_code = job.status;
+  }
+
+  if (render_cache)
+    render_cache->print_stats(std::cout);
+
+  return exit_code;
+}
+
+/**
+ * \brief  Named set of values of matrix mode and its result
+ */
+struct MatrixVariant {
+  std::string name;
+  std::map<std::string, std::string> table;   // overrides of shared values
+  std::string out_filename;
+  int status;
+  std::string errors;
+};
+
+/**
+ * \brief  Load variants file of matrix mode. <arg>=<val> lines before the first
+ *         [<name>] line are shared by all variants, lines after it are values of
+ *         the variant. Empty lines and lines started with # are skipped
+ * \param  filename            Variants file path
+ * \param  shared_table [out]  Shared values, added to existing values
+ * \param  variants [out]      Variants in file order
+ * \param  error_text [out]    Stream for error output
+ * \return true on success
+ */
+static bool load_variants(
+  const std::string& filename,
+  std::map<std::string, std::string>& shared_table,
+  std::vector<MatrixVariant>& variants,
+  std::ostream& error_text) {
+
+  std::vector<char> data;
+  if (!load_text_file(filename, data)) {
+    error_text << "Cannot open variants file " << filename << std::endl;
+    return false;
+  }
+
+  std::string text;
+  to_str(data, text);
+  std::istringstream lines(text);
+  std::string line;
+  std::set<std::string> names;
+
+  for (int line_number = 1; std::getline(lines, line); line_number++) {
+    if (line.size() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    if (line[0] == '[') {
+      if (line.size() < 3 || line[line.size() - 1] != ']') {
+        error_text << "variants error on line " << line_number << ": [<name>] expected" << std::endl;
+        return false;
+      }
+
+      MatrixVariant variant;
+      variant.name = line.substr(1, line.size() - 2);
+      variant.status = 0;
+      if (!names.insert(variant.name).second) {
+        error_text << "variants error on line " << line_number << ": variant is already defined " << variant.name << std::endl;
+        return false;
+      }
+      variants.push_back(variant);
+      continue;
+    }
+
+    std::string::size_type equal_token_pos = line.find_first_of('=');
+    if (equal_token_pos == std::string::npos) {
+      error_text << "variants error on line " << line_number << ": equal sign is not found in <template>=<value> construction" << std::endl;
+      return false;
+    }
+
+    std::map<std::string, std::string>& table = variants.empty() ? shared_table : variants.back().table;
+    table[line.substr(0, equal_token_pos)] = line.substr(equal_token_pos + 1);
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Render one template with each variant of values on thread pool. The
+ *         template is parsed once: keys and meta blocks are compiled in memory
+ *         and each variant renders the compiled template, as --render does.
+ *         Shared values are loaded once and each variant keeps only its own
+ *         values on top of them, large values are written by reference
+ * \param  in_filename       Template file path
+ * \param  variants_filename Variants file path, see load_variants
+ * \param  out_pattern       Output file path, NAME is replaced by variant name
+ * \param  table             Command line table, shared by all variants
+ * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+ * \param  threads_count     Count of threads, 0 for count of hardware threads
+ * \return Exit code: 0 when all variants succeeded, otherwise status of the first failed variant
+ */
+template<typename TString, typename TParserParams>
+int process_matrix(
+  const std::string& in_filename,
+  const std::string& variants_filename,
+  const std::string& out_pattern,
+  const std::map<std::string, std::string>& table,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  size_t threads_count) {
+
+  typedef typename TString::value_type CharType;
+
+  std::string::size_type name_pos = out_pattern.find(kPlaceholderName);
+  if (name_pos == std::string::npos) {
+    std::cerr << "command line error: outfile pattern must contain " << kPlaceholderName << std::endl;
+    return 254;
+  }
+
+  std::map<std::string, std::string> shared_table = table;
+  std::vector<MatrixVariant> variants;
+  if (!load_variants(variants_filename, shared_table, variants, std::cerr))
+    return 254;
+
+  ValueFileCache value_files;
+  std::map<TString, TString> shared_replace_table;
+  std::string failed_filename;
+  if (!load_replace_table(shared_table, value_files, shared_replace_table, failed_filename)) {
+    std::cerr << "Cannot load file content " << failed_filename << std::endl;
+    return 253;
+  }
+
+  // keys of all variants are compiled, a variant leaves keys which it does not set as is
+  std::set<TString> key_set;
+  for (const auto& item : shared_replace_table)
+    key_set.insert(item.first);
+  for (MatrixVariant& variant : variants) {
+    variant.out_filename = std::string(out_pattern).replace(name_pos, kPlaceholderName.size(), variant.name);
+    for (const auto& item : variant.table) {
+      TString key;
+      convert_value(item.first, key);
+      key_set.insert(key);
+    }
+  }
+
+  std::vector<char> data;
+  if (!load_text_file(in_filename, data)) {
+    report_infile_error(in_filename, std::cerr);
+    return 252;
+  }
+
+  TString text;
+  TextEncoding encoding = to_str(data, text);
+  std::vector<char>().swap(data);
+
+  std::vector<char> compiled;
+  TemplateCompiler<TString, TParserParams> compiler(std::vector<TString>(key_set.begin(), key_set.end()), is_meta_enabled, parser_params);
+  if (!compiler.compile(text.data(), text.size(), compiled, std::cerr))
+    return 252;
+  TString().swap(text);
+
+  CompiledTemplate<TString> compiled_template;
+  if (!compiled_template.open(compiled.data(), compiled.size())) {
+    std::cerr << "Cannot open compiled template of infile " << in_filename << std::endl;
+    return 252;
+  }
+
+  WorkStealingPool pool(threads_count);
+  for (MatrixVariant& variant : variants) {
+    pool.submit([&]() {
+      std::stringstream error_text;
+      std::map<TString, TString> overrides;
+      std::string variant_failed_filename;
+
+      if (!load_replace_table(variant.table, value_files, overrides, variant_failed_filename)) {
+        variant.status = 253;
+        error_text << "Cannot load file content " << variant_failed_filename << std::endl;
+      } else {
+        SliceSink<CharType> sink(compiled_template.text(), compiled_template.text_size());
+        compiled_template.render(shared_replace_table, overrides, sink);
+
+        bool is_written;
+#ifndef _WIN32
+        if (is_host_byte_order(encoding) && get_output_compression(variant.out_filename) == kCompressionNone)
+          is_written = write_slices_file(variant.out_filename, sink, -1, compiled_template.text(), error_text);
+        else
+#endif /*_WIN32*/
+          is_written = write_text_file(variant.out_filename, sink, encoding, error_text);
+
+        if (!is_written)
+          variant.status = 252;
+      }
+
+      variant.errors = error_text.str();
+    });
+  }
+
+  pool.wait();
+
+  int exit_code = 0;
+  for (const MatrixVariant& variant : variants) {
+    std::cout << "[" << variant.status << "] " << variant.name << " -> " << variant.out_filename << std::endl;
+    std::cerr << variant.errors;
+    if (variant.status && !exit_code)
+      exit_code = variant.status;
+  }
+
+  return exit_code;
+}
+
+/**
+ * \brief  Result of one file of tree
+ */
+struct TreeFile {
+  std::string source_filename;
+  std::string target_filename;
+  int status;
+  std::string errors;
+};
+
+/**
+ * \brief  Render source tree to target tree on thread pool. Directories are
+ *         walked in parallel, selected files are rendered with one shared table,
+ *         other files are copied (reflink or copy_file_range when supported).
+ *         A file whose source and output are not changed since the last run
+ *         with the same settings is skipped, see TreeState. Symbolic links to
+ *         directories are not followed, target directory inside the source
+ *         tree is not walked
+ * \param  source_root       Source directory
+ * \param  target_root       Target directory, created when it does not exist
+ * \param  filter            Files to render, other files are copied
+ * \param  state_filename    State file, empty for state file in target directory
+ * \param  table             Command line table
+ * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+ * \param  is_stream         true for stream mode
+ * \param  window_size       Window size for stream mode
+ * \param  placeholders      Placeholder mode, disabled when tokens are empty
+ * \param  is_expanded       true for resolving keys inside values when the table is built
+ * \param  render_cache      Render cache, nullptr when disabled
+ * \param  threads_count     Count of threads, 0 for count of hardware threads
+ * \return Exit code: 0 when all files succeeded, otherwise status of the first failed file
+ */
+template<typename TString, typename TParserParams>
+int process_tree(
+  const std::string& source_root,
+  const std::string& target_root,
+  const PathFilter& filter,
+  const std::string& state_filename,
+  const std::map<std::string, std::string>& table,
+  bool is_meta_enabled,
+  bool is_stream,
+  size_t window_size,
+  const TParserParams& parser_params,
+  const PlaceholderFormat<TString>& placeholders,
+  bool is_expanded,
+  RenderCache* render_cache,
+  size_t threads_count) {
+
+  std::error_code error;
+  if (!std::filesystem::is_directory(source_root, error)) {
+    std::cerr << "Cannot open source directory " << source_root << std::endl;
+    return 254;
+  }
+
+  std::filesystem::create_directories(target_root, error);
+  if (!std::filesystem::is_directory(target_root, error)) {
+    std::cerr << "Cannot create target directory " << target_root << std::endl;
+    return 252;
+  }
+
+  if (std::filesystem::equivalent(source_root, target_root, error)) {
+    std::cerr << "Source and target directories are the same " << source_root << std::endl;
+    return 254;
+  }
+
+  ValueFileCache value_files;
+  std::map<TString, TString> replace_table;
+  std::string failed_filename;
+  if (!load_replace_table(table, value_files, replace_table, failed_filename)) {
+    std::cerr << "Cannot load file content " << failed_filename << std::endl;
+    return 253;
+  }
+
+  ContentHash settings;
+  settings.update_size(filter.includes.size());
+  for (const std::string& pattern : filter.includes)
+    settings.update_string(pattern);
+  settings.update_size(filter.excludes.size());
+  for (const std::string& pattern : filter.excludes)
+    settings.update_string(pattern);
+  uint64_t copy_key = settings.digest();
+
+  settings.update_size(sizeof(typename TString::value_type));
+  settings.update_size(is_meta_enabled);
+  settings.update_size(is_stream);
+  settings.update_string(placeholders.open_token);
+  settings.update_string(placeholders.close_token);
+  settings.update_size(is_expanded);
+  settings.update_size(replace_table.size());
+  for (const auto& item : replace_table) {
+    settings.update_string(item.first);
+    settings.update_string(item.second);
+  }
+
+  std::unique_ptr<ReplaceTable<TString, TParserParams> > compiled_table =
+    build_replace_table(std::move(replace_table), is_meta_enabled, parser_params, placeholders, is_expanded, std::cerr);
+  if (!compiled_table)
+    return 253;
+
+  TreeState state(state_filename.empty() ? (std::filesystem::path(target_root) / kTreeStateName).string() : state_filename,
+    settings.digest(), copy_key);
+  state.load();
+
+  std::atomic<size_t> rendered_count(0);
+  std::atomic<size_t> copied_count(0);
+  std::atomic<size_t> skipped_count(0);
+  std::vector<TreeFile> failed_files;
+  std::mutex failed_files_mutex;
+
+  auto fail = [&](const std::string& source_filename, const std::string& target_filename, int status, const std::string& errors) {
+    TreeFile file = { source_filename, target_filename, status, errors };
+    std::lock_guard<std::mutex> lock(failed_files_mutex);
+    failed_files.push_back(file);
+  };
+
+  WorkStealingPool pool(threads_count);
+
+  std::function<void(const std::string&)> process_entry = [&](const std::string& path) {
+    std::string source_filename = (std::filesystem::path(source_root) / path).string();
+    std::string target_filename = (std::filesystem::path(target_root) / path).string();
+
+    FileStamp source_stamp;
+    FileStamp target_stamp;
+    if (!get_file_stamp(source_filename, source_stamp)) {
+      fail(source_filename, target_filename, 252, "Cannot open infile " + source_filename + "\n");
+      return;
+    }
+
+    bool is_rendered = filter.is_selected(path);
+    if (get_file_stamp(target_filename, target_stamp) && state.lookup(path, source_stamp, target_stamp, is_rendered)) {
+      state.store(path, source_stamp, target_stamp);
+      ++skipped_count;
+      return;
+    }
+
+    std::stringstream error_text;
+    bool is_processed;
+    if (!is_rendered) {
+      is_processed = copy_file_content(source_filename, target_filename);
+      if (!is_processed)
+        error_text << "Cannot copy file to " << target_filename << std::endl;
+    } else if (!source_stamp.size) {   // empty input has no output
+      is_processed = static_cast<bool>(std::ofstream(target_filename, std::ios::binary | std::ios::trunc));
+      if (!is_processed)
+        error_text << "Cannot create outfile " << target_filename << std::endl;
+    } else {
+      is_processed = process_file(source_filename, target_filename, *compiled_table, is_stream, window_size, 1, render_cache, error_text);
+    }
+
+    // output of failed rendering is not the source content, it keeps its own permissions
+    if (is_processed) {
+      std::error_code permissions_error;
+      std::filesystem::permissions(target_filename, std::filesystem::status(source_filename, permissions_error).permissions(), permissions_error);
+    }
+
+    if (!is_processed || !get_file_stamp(target_filename, target_stamp)) {
+      fail(source_filename, target_filename, 252, error_text.str());
+      return;
+    }
+
+    state.store(path, source_stamp, target_stamp);
+    ++(is_rendered ? rendered_count : copied_count);
+  };
+
+  std::function<void(const std::string&)> walk_directory = [&](const std::string& path) {
+    std::filesystem::path directory = std::filesystem::path(source_root) / path;
+    std::error_code walk_error;
+
+    for (std::filesystem::directory_iterator i(directory, walk_error), end; !walk_error && i != end; i.increment(walk_error)) {
+      std::string entry_path = path.empty() ? i->path().filename().generic_string() : path + "/" + i->path().filename().generic_string();
+      std::error_code entry_error;
+
+      if (i->is_directory(entry_error) && !i->is_symlink(entry_error)) {
+        if (std::filesystem::equivalent(i->path(), target_root, entry_error))
+          continue;
+
+        std::filesystem::create_directories(std::filesystem::path(target_root) / entry_path, entry_error);
+        if (entry_error) {
+          fail(i->path().string(), (std::filesystem::path(target_root) / entry_path).string(), 252, "Cannot create directory " + entry_path + "\n");
+          continue;
+        }
+
+        pool.submit(std::bind(walk_directory, entry_path));
+      } else if (i->is_regular_file(entry_error) && !std::filesystem::equivalent(i->path(), state.filename(), entry_error)) {
+        pool.submit(std::bind(process_entry, entry_path));
+      }
+    }
+
+    if (walk_error)
+      fail(directory.string(), (std::filesystem::path(target_root) / path).string(), 252, "Cannot read directory " + directory.string() + "\n");
+  };
+
+  pool.submit(std::bind(walk_directory, std::string()));
+  pool.wait();
+
+  if (!state.save())
+    std::cerr << "Cannot write state file " << state.filename() << std::endl;
+
+  int exit_code = 0;
+  for (const TreeFile& file : failed_files) {
+    std::cout << "[" << file.status << "] " << file.source_filename << " -> " << file.target_filename << std::endl;
+    std::cerr << file.errors;
+    if (!exit_code)
+      exit_code = file.status;
+  }
+
+  std::cout << "Rendered " << rendered_count << ", copied " << copied_count << ", skipped " << skipped_count
+    << ", failed " << failed_files.size() << " files" << std::endl;
+
+  if (render_cache)
+    render_cache->print_stats(std::cout);
+
+  return exit_code;
+}
+
+#ifndef _WIN32
+static int stop_pipe[2] = { -1, -1 };   // written by signal handler to stop server
+
+static void stop_server(int) {
+  ssize_t written = write(stop_pipe[1], "", 1);
+  (void)written;
+}
+
+static void close_pipe(int (&fds)[2]) {
+  for (int& fd : fds) {
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+  }
+}
+
+/**
+ * \brief  Long-lived render server. Requests are jobs of manifest format: infile,
+ *         outfile and values which override the shared table, and are served
+ *         concurrently on a thread pool. Templates, value files and compiled replace
+ *         tables are kept between requests and are used while stamps of their files
+ *         are not changed. Templates are kept as text, they are parsed by each
+ *         request, as meta blocks and keys found depend on its values
+ */
+template<typename TString, typename TParserParams>
+class RenderServer {
+public:
+  typedef ReplaceTable<TString, TParserParams> Table;
+
+  static const size_t kMaxTablesCount = 64;
+  static const uint64_t kMaxFilesSize = 256 * 1024 * 1024;   // templates and value files kept in memory
+
+  /**
+   * \param  shared_table      Command line table, shared by all requests
+   * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+   * \param  is_stream         true for stream mode
+   * \param  window_size       Window size for stream mode
+   * \param  placeholders      Placeholder mode, disabled when tokens are empty
+   * \param  is_expanded       true for resolving keys inside values when tables are built
+   * \param  render_cache      Render cache, nullptr when disabled
+   */
+  RenderServer(
+    const std::map<std::string, std::string>& shared_table,
+    bool is_meta_enabled,
+    bool is_stream,
+    size_t window_size,
+    const PlaceholderFormat<TString>& placeholders,
+    bool is_expanded,
+    RenderCache* render_cache)
+    : shared_table_(shared_table), is_meta_enabled_(is_meta_enabled), is_stream_(is_stream),
+      window_size_(window_size), placeholders_(placeholders), is_expanded_(is_expanded), render_cache_(render_cache),
+      value_files_(true, kMaxFilesSize), requests_count_(0), wake_pipe_{ -1, -1 }, is_stopped_(false) {
+  }
+
+  /**
+   * \brief  Serve requests until SIGINT or SIGTERM
+   * \param  socket_path    Socket file path
+   * \param  threads_count  Count of threads, 0 for count of hardware threads
+   * \return Exit code
+   */
+  int run(const std::string& socket_path, size_t threads_count) {
+    LocalSocket listener;
+    if (!listener.listen(socket_path)) {
+      std::cerr << "Cannot listen on socket " << socket_path << ", is it served already?" << std::endl;
+      return 254;
+    }
+
+    if (pipe(stop_pipe)) {
+      std::cerr << "Cannot create pipe" << std::endl;
+      return 252;
+    }
+    if (pipe(wake_pipe_)) {
+      close_pipe(stop_pipe);
+      std::cerr << "Cannot create pipe" << std::endl;
+      return 252;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+
+    std::cout << "Serving on " << socket_path << std::endl;
+    {
+      // idle connections are polled here, a connection with a request is served
+      // on the pool and returned, so a worker is not held by an idle client
+      WorkStealingPool pool(threads_count);
+      std::vector<std::shared_ptr<LocalSocket> > idle_connections;
+      std::vector<pollfd> fds;
+
+      while (true) {
+        fds.clear();
+        fds.push_back({ stop_pipe[0], POLLIN, 0 });
+        fds.push_back({ wake_pipe_[0], POLLIN, 0 });
+        fds.push_back({ listener.fd(), POLLIN, 0 });
+        for (const std::shared_ptr<LocalSocket>& connection : idle_connections)
+          fds.push_back({ connection->fd(), POLLIN, 0 });
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
+        if (fds[0].revents)
+          break;
+
+        std::vector<std::shared_ptr<LocalSocket> > connections;
+        connections.swap(idle_connections);
+        for (size_t i = 0; i < connections.size(); i++) {
+          if (!fds[i + 3].revents) {
+            idle_connections.push_back(connections[i]);
+            continue;
+          }
+
+          std::shared_ptr<LocalSocket> connection = connections[i];
+          std::lock_guard<std::mutex> lock(connections_mutex_);
+          busy_connections_.insert(connection);
+          pool.submit([this, connection]() { serve_connection(connection); });
+        }
+
+        if (fds[1].revents) {
+          char buffer[64];
+          ssize_t size = read(wake_pipe_[0], buffer, sizeof(buffer));
+          (void)size;
+
+          std::lock_guard<std::mutex> lock(connections_mutex_);
+          idle_connections.insert(idle_connections.end(), returned_connections_.begin(), returned_connections_.end());
+          returned_connections_.clear();
+        }
+
+        if (fds[2].revents) {
+          int fd = listener.accept();
+          if (fd >= 0)
+            idle_connections.push_back(std::make_shared<LocalSocket>(fd));
+        }
+      }
+
+      // idle clients are disconnected, requests in progress are answered, then
+      // their connections are closed
+      idle_connections.clear();
+      {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        is_stopped_ = true;
+        returned_connections_.clear();
+        for (const std::shared_ptr<LocalSocket>& connection : busy_connections_)
+          connection->shutdown_receive();
+      }
+      pool.wait();
+    }
+
+    listener.close();
+    unlink(socket_path.c_str());
+    close_pipe(wake_pipe_);
+    close_pipe(stop_pipe);
+
+    std::cout << "Served " << requests_count_ << " requests" << std::endl;
+    if (render_cache_)
+      render_cache_->print_stats(std::cout);
+    return 0;
+  }
+
+private:
+  /**
+   * \brief  Serve one request of client and return connection to polling. Connection
+   *         is closed when client closes it or server is stopped. Response is exit
+   *         code and error text separated by zero character
+   */
+  void serve_connection(const std::shared_ptr<LocalSocket>& connection) {
+    std::string request;
+    bool is_served = connection->receive_message(request);
+    if (is_served) {
+      std::stringstream error_text;
+      int status = serve_request(request, error_text);
+      ++requests_count_;
+      is_served = connection->send_message(std::to_string(status) + '\0' + error_text.str());
+    }
+
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    busy_connections_.erase(connection);
+    if (is_served && !is_stopped_) {
+      returned_connections_.push_back(connection);
+      ssize_t written = write(wake_pipe_[1], "", 1);
+      (void)written;
+    }
+  }
+
+  /**
+   * \param  request           Arguments separated by zero characters: <infile> <outfile> [<arg>=<val> ...]
+   * \param  error_text [out]  Stream for error output
+   * \return Exit code
+   */
+  int serve_request(const std::string& request, std::ostream& error_text) {
+    std::vector<std::string> arguments;
+    std::istringstream items(request);
+    for (std::string argument; std::getline(items, argument, '\0');)
+      arguments.push_back(argument);
+
+    if (arguments.size() < 2) {
+      error_text << "request error: <infile> <outfile> expected" << std::endl;
+      return 254;
+    }
+
+    std::map<std::string, std::string> table = shared_table_;
+    for (size_t i = 2; i < arguments.size(); i++) {
+      std::string::size_type equal_token_pos = arguments[i].find_first_of('=');
+      if (equal_token_pos == std::string::npos) {
+        error_text << "request error: equal sign is not found in <template>=<value> construction" << std::endl;
+        return 254;
+      }
+      table[arguments[i].substr(0, equal_token_pos)] = arguments[i].substr(equal_token_pos + 1);
+    }
+
+    std::shared_ptr<const Table> replace_table = get_table(table, error_text);
+    if (!replace_table)
+      return 253;
+
+    // template is kept in memory as value files are, stream mode reads it by windows
+    std::shared_ptr<const FileContent> content;
+    if (!is_stream_ && arguments[0] != kStdStreamName)
+      content = value_files_.load(arguments[0]);
+
+    if (!process_file(arguments[0], arguments[1], *replace_table, is_stream_, window_size_, 1, render_cache_, error_text,
+      nullptr, content.get()))
+      return 252;
+
+    return 0;
+  }
+
+  /**
+   * \brief  Take compiled table from cache or build it. Table is identified by
+   *         command line values and stamps of value files
+   * \return Table, nullptr when a value file cannot be loaded or expanded values refer to
+   *         each other in a cycle, info placed to error stream
+   */
+  std::shared_ptr<const Table> get_table(const std::map<std::string, std::string>& table, std::ostream& error_text) {
+    ContentHash hash;
+    hash.update_size(table.size());
+    for (const auto& item : table) {
+      hash.update_string(item.first);
+      hash.update_string(item.second);
+
+      FileStamp stamp;
+      if (is_file_value(item.second) && get_file_stamp(item.second.substr(1), stamp)) {
+        hash.update_size(stamp.device);
+        hash.update_size(stamp.inode);
+        hash.update_size(stamp.size);
+        hash.update_size(stamp.time);
+      }
+    }
+    uint64_t key = hash.digest();
+
+    {
+      std::lock_guard<std::mutex> lock(tables_mutex_);
+      for (typename std::list<std::pair<uint64_t, std::shared_ptr<const Table> > >::iterator i = tables_.begin(); i != tables_.end(); i++) {
+        if (i->first == key) {
+          tables_.splice(tables_.begin(), tables_, i);   // most recently used first
+          return tables_.front().second;
+        }
+      }
+    }
+
+    std::map<TString, TString> values;
+    std::string failed_filename;
+    if (!load_replace_table(table, value_files_, values, failed_filename)) {
+      error_text << "Cannot load file content " << failed_filename << std::endl;
+      return nullptr;
+    }
+
+    std::shared_ptr<const Table> replace_table =
+      build_replace_table(std::move(values), is_meta_enabled_, TParserParams(), placeholders_, is_expanded_, error_text);
+    if (!replace_table)
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(tables_mutex_);
+    tables_.push_front(std::make_pair(key, replace_table));
+    if (tables_.size() > kMaxTablesCount)
+      tables_.pop_back();
+    return replace_table;
+  }
+
+  std::map<std::string, std::string> shared_table_;
+  bool is_meta_enabled_;
+  bool is_stream_;
+  size_t window_size_;
+  PlaceholderFormat<TString> placeholders_;
+  bool is_expanded_;
+  RenderCache* render_cache_;
+  ValueFileCache value_files_;
+  std::mutex tables_mutex_;
+  std::list<std::pair<uint64_t, std::shared_ptr<const Table> > > tables_;
+  std::atomic<size_t> requests_count_;
+  int wake_pipe_[2];   // written when a served connection is returned to polling
+  std::mutex connections_mutex_;
+  std::set<std::shared_ptr<LocalSocket> > busy_connections_;
+  std::vector<std::shared_ptr<LocalSocket> > returned_connections_;
+  bool is_stopped_;
+};
+
+/**
+ * \brief  Send render request to server and wait for the result. Relative paths
+ *         of infile, outfile and value files are made absolute, as the server
+ *         has its own working directory
+ * \param  socket_path  Socket file path of server
+ * \param  arguments    <infile> <outfile> [<arg>=<val> ...]
+ * \return Exit code of request
+ */
+static int request_render(const std::string& socket_path, std::vector<std::string> arguments) {
+  std::error_code error;
+  for (size_t i = 0; i < arguments.size(); i++) {
+    std::string::size_type equal_token_pos = i < 2 ? std::string::npos : arguments[i].find_first_of('=');
+    if (i >= 2 && equal_token_pos == std::string::npos) {
+      std::cerr << "command line error: equal sign is not found in <template>=<value> construction" << std::endl;
+      return 254;
+    }
+
+    if (i < 2 && arguments[i] == kStdStreamName) {
+      std::cerr << "command line error: stdin and stdout are not supported by server" << std::endl;
+      return 254;
+    }
+
+    std::string value = i < 2 ? arguments[i] : arguments[i].substr(equal_token_pos + 1);
+    if (i >= 2 && (!is_file_value(value) || value.size() == 1))
+      continue;
+
+    std::string path = i < 2 ? value : value.substr(1);
+    path = std::filesystem::absolute(path, error).string();
+    arguments[i] = i < 2 ? path : arguments[i].substr(0, equal_token_pos + 2) + path;
+  }
+
+  std::string request;
+  for (size_t i = 0; i < arguments.size(); i++)
+    request += (i ? std::string(1, '\0') : std::string()) + arguments[i];
+
+  signal(SIGPIPE, SIG_IGN);
+  LocalSocket connection;
+  std::string response;
+  if (!connection.connect(socket_path)) {
+    std::cerr << "Cannot connect to server " << socket_path << std::endl;
+    return 254;
+  }
+
+  if (!connection.send_message(request) || !connection.receive_message(response)) {
+    std::cerr << "Server closed connection " << socket_path << std::endl;
+    return 252;
+  }
+
+  std::string::size_type status_end = response.find('\0');
+  std::cerr << response.substr(status_end == std::string::npos ? response.size() : status_end + 1);
+  return atoi(response.substr(0, status_end).c_str());
+}
+
+#ifdef __linux__
+/**
+ * \brief  Renders outputs again when their inputs change, until SIGINT or SIGTERM.
+ *
+ * The watcher keeps the dependency graph of outputs in memory: each output
+ * depends on its template and on value files of keys which the template uses
+ * (see load_used_replace_table). A value file which no output uses, or which
+ * is used only inside a dropped IFSET block, is not a dependency. Directories
+ * of dependencies are watched by inotify, so files replaced by rename are seen.
+ * Changed files are collected until no event comes for the debounce time, then
+ * outputs which depend on them are rendered again and their dependencies are
+ * updated. An output which is a template or value file of another output is
+ * rendered before it, and the other output follows in the same round. Events of
+ * files whose stamp is not changed, such as outputs of the watcher, are ignored
+ */
+template<typename TString, typename TParserParams>
+class WatchRenderer {
+public:
+  /**
+   * \param  jobs [in,out]     Outputs to render, status and errors are set for each render
+   * \param  shared_table      Command line table, shared by all jobs
+   * \param  is_meta_enabled   true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+   * \param  is_stream         true for stream mode
+   * \param  window_size       Window size for stream mode
+   * \param  placeholders      Placeholder mode, disabled when tokens are empty
+   * \param  is_expanded       true for resolving keys inside values when tables are built
+   * \param  render_cache      Render cache, nullptr when disabled
+   * \param  threads_count     Count of threads for rendering a file by chunks, 1 for one thread
+   */
+  WatchRenderer(
+    std::vector<BatchJob>& jobs,
+    const std::map<std::string, std::string>& shared_table,
+    bool is_meta_enabled,
+    bool is_stream,
+    size_t window_size,
+    const PlaceholderFormat<TString>& placeholders,
+    bool is_expanded,
+    RenderCache* render_cache,
+    size_t threads_count)
+    : jobs_(jobs), shared_table_(shared_table), is_meta_enabled_(is_meta_enabled), is_stream_(is_stream),
+      window_size_(window_size), placeholders_(placeholders), is_expanded_(is_expanded), render_cache_(render_cache),
+      threads_count_(threads_count), value_files_(true), dependencies_(jobs.size()), inotify_fd_(-1) {
+  }
+
+  ~WatchRenderer() {
+    if (inotify_fd_ >= 0)
+      close(inotify_fd_);
+  }
+
+  WatchRenderer(const WatchRenderer&) = delete;
+  WatchRenderer& operator=(const WatchRenderer&) = delete;
+
+  /**
+   * \brief  Render all outputs, then watch their dependencies until SIGINT or SIGTERM
+   * \param  debounce_time  Time without events after a change before rendering, in milliseconds
+   * \return Exit code
+   */
+  int run(int debounce_time) {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0 || pipe(stop_pipe)) {
+      std::cerr << "Cannot watch files" << std::endl;
+      return 252;
+    }
+
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+
+    if (!sort_jobs())
+      return 254;
+
+    std::set<size_t> all_jobs;
+    for (size_t i = 0; i < order_.size(); i++)
+      all_jobs.insert(i);
+    render(all_jobs);
+
+    std::cout << "Watching " << dependents_.size() << " files" << std::endl;
+
+    std::set<std::string> events;
+    std::vector<char> buffer(64 * 1024);
+    pollfd fds[2] = { { inotify_fd_, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+
+    while (true) {
+      int ready = poll(fds, 2, events.empty() ? -1 : debounce_time);
+      if (ready < 0) {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      if (fds[1].revents)
+        break;
+
+      if (!ready) {   // quiet for debounce time
+        render_changes(events);
+        events.clear();
+        continue;
+      }
+
+      ssize_t size;
+      while ((size = read(inotify_fd_, buffer.data(), buffer.size())) > 0) {
+        for (ssize_t offset = 0; offset < size;) {
+          const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+          offset += sizeof(inotify_event) + event->len;
+
+          if (event->mask & IN_Q_OVERFLOW) {   // events are lost, check all files
+            for (const auto& item : dependents_)
+              events.insert(item.first);
+            continue;
+          }
+
+          std::map<int, std::string>::const_iterator directory = directories_.find(event->wd);
+          if (directory == directories_.end() || !event->len)
+            continue;
+
+          std::string path = (std::filesystem::path(directory->second) / event->name).string();
+          if (dependents_.count(path))
+            events.insert(path);
+        }
+      }
+    }
+
+    return 0;
+  }
+
+private:
+  /**
+   * \brief  Order jobs so a job which uses output of another job as infile or
+   *         value file follows it. Jobs in dependency cycles are an error
+   * \return false on dependency cycle
+   */
+  bool sort_jobs() {
+    std::map<std::string, size_t> producers;   // normalized outfile -> job
+    for (size_t i = 0; i < jobs_.size(); i++) {
+      if (!producers.insert(std::make_pair(normalize_path(jobs_[i].out_filename), i)).second) {
+        std::cerr << "manifest error: outfile is used by several jobs " << jobs_[i].out_filename << std::endl;
+        return false;
+      }
+    }
+
+    std::vector<std::vector<size_t> > dependents(jobs_.size());
+    std::vector<size_t> waiting_count(jobs_.size());
+    for (size_t i = 0; i < jobs_.size(); i++) {
+      std::set<size_t> producer_jobs;
+      std::vector<std::string> files(1, jobs_[i].in_filename);
+      for (const auto& item : get_table(i)) {
+        if (is_file_value(item.second))
+          files.push_back(item.second.substr(1));
+      }
+
+      for (const std::string& file : files) {
+        std::map<std::string, size_t>::const_iterator producer = producers.find(normalize_path(file));
+        if (producer != producers.end() && producer->second != i)
+          producer_jobs.insert(producer->second);
+      }
+
+      for (size_t producer : producer_jobs)
+        dependents[producer].push_back(i);
+      waiting_count[i] = producer_jobs.size();
+    }
+
+    for (size_t i = 0; i < jobs_.size(); i++) {
+      if (!waiting_count[i])
+        order_.push_back(i);
+    }
+    for (size_t i = 0; i < order_.size(); i++) {
+      for (size_t dependent : dependents[order_[i]]) {
+        if (!--waiting_count[dependent])
+          order_.push_back(dependent);
+      }
+    }
+
+    if (order_.size() != jobs_.size()) {
+      std::cerr << "manifest error: jobs use outputs of each other in a cycle" << std::endl;
+      return false;
+    }
+
+    positions_.resize(jobs_.size());
+    for (size_t i = 0; i < order_.size(); i++)
+      positions_[order_[i]] = i;
+    return true;
+  }
+
+  std::map<std::string, std::string> get_table(size_t index) const {
+    std::map<std::string, std::string> table = shared_table_;
+    for (const auto& item : jobs_[index].table)
+      table[item.first] = item.second;
+    return table;
+  }
+
+  /**
+   * \brief  Render jobs which depend on changed files
+   * \param  paths  Normalized paths of files with events
+   */
+  void render_changes(const std::set<std::string>& paths) {
+    std::set<size_t> affected;
+    for (const std::string& path : paths) {
+      FileStamp stamp;
+      get_file_stamp(path, stamp);
+      if (stamp == stamps_[path])
+        continue;
+
+      stamps_[path] = stamp;
+      std::cout << "Changed " << path << std::endl;
+      for (size_t job : dependents_[path])
+        affected.insert(positions_[job]);
+    }
+
+    render(affected);
+  }
+
+  /**
+   * \brief  Render jobs in dependency order. Jobs which use a rendered output follow it
+   * \param  positions  Positions of jobs in dependency order
+   */
+  void render(std::set<size_t> positions) {
+    while (!positions.empty()) {
+      size_t index = order_[*positions.begin()];
+      positions.erase(positions.begin());
+      render_job(index);
+
+      BatchJob& job = jobs_[index];
+      std::cout << "[" << job.status << "] " << job.in_filename << " -> " << job.out_filename << std::endl;
+      std::cerr << job.errors;
+
+      std::string out_path = normalize_path(job.out_filename);
+      FileStamp stamp;
+      get_file_stamp(out_path, stamp);
+      if (stamp == stamps_[out_path])
+        continue;
+
+      stamps_[out_path] = stamp;
+      std::map<std::string, std::set<size_t> >::const_iterator dependents = dependents_.find(out_path);
+      if (dependents != dependents_.end()) {
+        for (size_t dependent : dependents->second)
+          positions.insert(positions_[dependent]);
+      }
+    }
+  }
+
+  /**
+   * \brief  Render one job and update its dependencies: template and value files
+   *         which are loaded for it, or the file which cannot be loaded
+   */
+  void render_job(size_t index) {
+    BatchJob& job = jobs_[index];
+    std::stringstream error_text;
+    std::map<TString, TString> replace_table;
+    std::vector<std::string> files(1, job.in_filename);
+    std::string failed_filename;
+    job.status = 0;
+
+    FileContent content;
+    bool is_read = !is_stream_ && content.open(job.in_filename);
+    if (!load_used_replace_table(is_read ? &content : nullptr, get_table(index), is_meta_enabled_, TParserParams(), value_files_,
+      replace_table, failed_filename, &files)) {
+      job.status = 253;
+      error_text << "Cannot load file content " << failed_filename << std::endl;
+      if (!failed_filename.empty())
+        files.push_back(failed_filename);
+    } else {
+      std::unique_ptr<ReplaceTable<TString, TParserParams> > table =
+        build_replace_table(std::move(replace_table), is_meta_enabled_, TParserParams(), placeholders_, is_expanded_, error_text,
+          is_read ? &content : nullptr);
+      if (!table)
+        job.status = 253;
+      else if (!process_file(job.in_filename, job.out_filename, *table, is_stream_, window_size_, threads_count_, render_cache_, error_text,
+        nullptr, is_read ? &content : nullptr))
+        job.status = 252;
+    }
+
+    job.errors = error_text.str();
+
+    std::set<std::string> dependencies;
+    for (const std::string& file : files)
+      dependencies.insert(normalize_path(file));
+
+    for (const std::string& path : dependencies_[index]) {
+      if (!dependencies.count(path) && dependents_[path].erase(index) && dependents_[path].empty())
+        dependents_.erase(path);
+    }
+    for (const std::string& path : dependencies) {
+      if (!dependencies_[index].count(path))
+        watch(path);
+      dependents_[path].insert(index);
+    }
+    dependencies_[index].swap(dependencies);
+  }
+
+  /**
+   * \brief  Watch directory of file and remember its stamp
+   * \param  path  Normalized file path
+   */
+  void watch(const std::string& path) {
+    if (!stamps_.count(path))
+      get_file_stamp(path, stamps_[path]);
+
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    if (!watched_directories_.insert(directory).second)
+      return;
+
+    int wd = inotify_add_watch(inotify_fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (wd >= 0)
+      directories_[wd] = directory;
+  }
+
+  std::vector<BatchJob>& jobs_;
+  std::map<std::string, std::string> shared_table_;
+  bool is_meta_enabled_;
+  bool is_stream_;
+  size_t window_size_;
+  PlaceholderFormat<TString> placeholders_;
+  bool is_expanded_;
+  RenderCache* render_cache_;
+  size_t threads_count_;
+  ValueFileCache value_files_;
+  std::vector<size_t> order_;                                    // jobs in dependency order
+  std::vector<size_t> positions_;                                // job -> position in order
+  std::vector<std::set<std::string> > dependencies_;             // job -> normalized files
+  std::map<std::string, std::set<size_t> > dependents_;          // normalized file -> jobs
+  std::map<std::string, FileStamp> stamps_;                      // normalized file -> last seen stamp
+  std::map<int, std::string> directories_;                       // watch descriptor -> directory
+  std::set<std::string> watched_directories_;
+  int inotify_fd_;
+};
+#endif /*__linux__*/
+#endif /*_WIN32*/
+
+/**
+ * \brief  Convert text to UTF-8 for reports
+ */
+static std::string to_utf8(const std::string& text) {
+  return text;
+}
+
+static std::string to_utf8(const std::u16string& text) {
+  std::string result;
+  utf16_to_utf8(text.data(), text.size(), result);
+  return result;
+}
+
+/**
+ * \brief  Write stats of processing as JSON
+ * \param  filename          Stats file path, empty for info output
+ * \param  stats             Stats of processing
+ * \param  replace_table     Table with tokens and replaces, gives key names
+ * \param  info_out          Info output
+ * \param  error_text [out]  Stream for error output
+ * \return false when stats file cannot be written
+ */
+template<typename TString>
+bool write_stats(
+  const std::string& filename,
+  const PhaseStats& stats,
+  const std::map<TString, TString>& replace_table,
+  std::ostream& info_out,
+  std::ostream& error_text) {
+
+  std::vector<std::string> key_names;
+  key_names.reserve(replace_table.size());
+  for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+    i != replace_table.end();
+    i++) {
+    key_names.push_back(to_utf8(i->first));
+  }
+
+  if (filename.empty()) {
+    write_stats_json(info_out, stats, key_names);
+    return true;
+  }
+
+  std::ofstream stats_file(filename, std::ios::out | std::ios::binary);
+  write_stats_json(stats_file, stats, key_names);
+  stats_file.close();
+  if (!stats_file) {
+    error_text << "Cannot write stats file " << filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Check whether argument is replayed as is: flags which change
+ *         processing and compile keys. Values are replayed from the effective
+ *         table, options which change the environment (--cache, --stats,
+ *         --record) are not replayed
+ */
+static bool is_replayed_option(const std::string& arg) {
+  static const char* const kReplayedOptions[] = {
+    "-w", "--unicode", "-d", "--disable-meta", "-e", "--enable-meta", "-s", "--stream",
+    "--window-size", "--jobs", "--parallel", "--placeholders", "--expand"
+  };
+
+  std::string::size_type equal_token_pos = arg.find_first_of('=');
+  if (equal_token_pos == std::string::npos && arg.size() && arg[0] != '-')
+    return true;
+
+  std::string name = arg.substr(0, equal_token_pos);
+  return std::find(std::begin(kReplayedOptions), std::end(kReplayedOptions), name) != std::end(kReplayedOptions);
+}
+
+/**
+ * \brief  Record invocation to corpus for replay. Template, value files and
+ *         output are stored once by content hash. Errors are reported, but do
+ *         not change exit code
+ * \param  corpus          Record corpus
+ * \param  argc            Count of command line arguments
+ * \param  argv            Command line arguments
+ * \param  first_option    Index of the first option
+ * \param  mode            --compile, --render, empty for <infile> <outfile> processing
+ * \param  in_filename     Template file path
+ * \param  out_filename    Output file path
+ * \param  table           Command line table, --table entries included
+ * \param  status          Exit code of processing
+ */
+static void record_invocation(
+  RecordCorpus& corpus,
+  int argc,
+  char* argv[],
+  int first_option,
+  const std::string& mode,
+  const std::string& in_filename,
+  const std::string& out_filename,
+  const std::map<std::string, std::string>& table,
+  int status) {
+
+  InvocationRecord record;
+  record.argv.assign(argv, argv + argc);
+  record.mode = mode;
+  record.input_filename = in_filename;
+  record.output_filename = out_filename;
+  record.status = status;
+
+  bool is_stored = corpus.store_file(in_filename, record.input_object);
+  if (!status)
+    is_stored = is_stored && corpus.store_file(out_filename, record.output_object);
+
+  for (int i = first_option; i < argc; i++) {
+    if (is_replayed_option(argv[i]))
+      record.options.push_back(argv[i]);
+  }
+
+  for (const auto& item : table) {
+    RecordedValue value = { item.first, item.second, std::string() };
+    if (is_file_value(item.second))
+      is_stored = is_stored && corpus.store_file(item.second.substr(1), value.object);
+    record.values.push_back(value);
+  }
+
+  if (!is_stored || !corpus.store(record))
+    std::cerr << "Cannot record invocation to corpus" << std::endl;
+}
+
+/**
+ * \brief    Command line tool help
+ */
+static void usage() {
+  std::cout << "File token replace tool" << std::endl;
+  std::cout << "Usage: filereplace <infile> <outfile> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
+  std::cout << "       filereplace --manifest <manifest> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
+  std::cout << "       filereplace --compile <infile> <compiled> [<key> [<arg> [<arg>=<val>] ...]]" << std::endl;
+  std::cout << "       filereplace --compile-table <table> <compiled table>" << std::endl;
+  std::cout << "       filereplace --render <compiled> <outfile> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
+  std::cout << "       filereplace --serve <socket> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
+  std::cout << "       filereplace --client <socket> <infile> <outfile> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]" << std::endl;
+  std::cout << "       filereplace --tree <srcdir> <dstdir> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
+  std::cout << "       filereplace --matrix <infile> <variants> <outfile pattern> [<key> [[<arg>=<val>] [<arg>=<@FILENAME>] ...]]" << std::endl;
+  std::cout << "File replacer can replace tokens in one or more files" << std::endl;
+  std::cout << "You can place some special tokens to template files like !(TEMPLATE)" << std::endl;
+  std::cout << "File replacer also provide some meta-constructions in template files:" << std::endl;
+  std::cout << "   !%@IFSET[TPL] ... !%@ENDIF%    - leave text block if template TPL is set to" << std::endl;
+  std::cout << "                                    any value or remove if not set" << std::endl;
+  std::cout << "   !%@IFNOTSET[TPL]... !%@ENDIF%  - leave text block if template TPL is not set" << std::endl;
+  std::cout << "                                    or remove if it set to any value" << std::endl;
+  std::cout << "   !%@IFCONTAINS[TPL][TOKEN] ... !%@ENDIF% - leave text block if template TPL" << std::endl;
+  std::cout << "                                    contains token 'TOKEN' in value." << std::endl;
+  std::cout << "                                    Compare is case-sensitive" << std::endl;
+  std::cout << "Keys:" << std::endl;
+  std::cout << "   -w or --unicode       - input file has UTF16 format (default - ANSI or UTF8)." << std::endl;
+  std::cout << "                           Byte order is taken from byte order mark, little" << std::endl;
+  std::cout << "                           endian by default, and is kept in output" << std::endl;
+  std::cout << "   -d or --disable-meta  - disable metalanguage in processed files." << std::endl;
+  std::cout << "   -e of --enable-meta   - enable metalanguage in processed files" << std::endl;
+  std::cout << "   Metalanguate is enabled by default" << std::endl;
+  std::cout << "   -s or --stream        - process file in one pass by fixed size windows, memory" << std::endl;
+  std::cout << "                           does not depend on file size. Inserted values are not" << std::endl;
+  std::cout << "                           scanned for tokens again, meta blocks may be nested" << std::endl;
+  std::cout << "   --window-size=<bytes> - window size for stream mode (default 4M)" << std::endl;
+  std::cout << "   Use - as <infile> or <outfile> for stdin or stdout" << std::endl;
+  std::cout << "   Compressed <infile> and value files (gzip, zstd) are decoded, <outfile> with" << std::endl;
+  std::cout << "   .gz or .zst extension is compressed, when the build has zlib or zstd" << std::endl;
+  std::cout << "   --jobs=<count>        - count of threads for manifest, tree, matrix, server and" << std::endl;
+  std::cout << "                           parallel mode (default all cores)" << std::endl;
+  std::cout << "   --parallel            - render one large file by chunks on several threads and" << std::endl;
+  std::cout << "                           write the chunks concurrently, with the same result" << std::endl;
+  std::cout << "   --cache=<dir>         - skip rendering when template, values and flags are the" << std::endl;
+  std::cout << "                           same as for the last output, which was not changed since." << std::endl;
+  std::cout << "                           Output is not rewritten when its content is the same" << std::endl;
+  std::cout << "   --stats[=<file>]      - write JSON with pass count, replaces of each key by pass," << std::endl;
+  std::cout << "                           scanned and copied bytes, wall time and peak memory of" << std::endl;
+  std::cout << "                           phases (load, values, meta, replace, write) to info" << std::endl;
+  std::cout << "                           output or file" << std::endl;
+  std::cout << "   --table=<file>        - add <arg>=<val> lines of table file, or compiled table," << std::endl;
+  std::cout << "                           in place of the option. Lines started with # are skipped." << std::endl;
+  std::cout << "                           One template in placeholder mode looks up only keys it" << std::endl;
+  std::cout << "                           may use in the index of compiled table" << std::endl;
+  std::cout << "   --placeholders[=<open>NAME<close>] - replace only keys of placeholder form" << std::endl;
+  std::cout << "                           (default !(NAME)), each found placeholder is resolved" << std::endl;
+  std::cout << "                           with one hash lookup. Other keys are used only by meta" << std::endl;
+  std::cout << "                           conditions. Inserted values are processed by the next pass" << std::endl;
+  std::cout << "   --expand              - resolve keys inside values once, before processing, so" << std::endl;
+  std::cout << "                           files are processed in one pass with the same result." << std::endl;
+  std::cout << "                           Values used by the file which refer to each other in a" << std::endl;
+  std::cout << "                           cycle are an error; tables shared by files of manifest," << std::endl;
+  std::cout << "                           tree and server check all values" << std::endl;
+  std::cout << "   --include=<glob>      - render files of tree which match glob (default all files)," << std::endl;
+  std::cout << "   --exclude=<glob>        except files which match glob. Other files are copied." << std::endl;
+  std::cout << "                           * and ? do not match /, ** does. Glob without / is" << std::endl;
+  std::cout << "                           matched with file name. Both may be repeated" << std::endl;
+  std::cout << "   --state=<file>        - state file of tree (default <dstdir>/.filereplace-state)" << std::endl;
+  std::cout << "   --record=<dir>        - record command line, template, value files and output to" << std::endl;
+  std::cout << "                           corpus <dir> for replay tool, files are stored once by" << std::endl;
+  std::cout << "                           content hash" << std::endl;
+  std::cout << "   --watch[=<ms>]        - render outputs again when their template or value files" << std::endl;
+  std::cout << "                           of used keys change, <ms> after the last change (default" << std::endl;
+  std::cout << "                           100), until SIGINT or SIGTERM. Linux only" << std::endl;
+  std::cout << "Manifest contains one job per line: <infile> <outfile> [<arg>=<val> ...]" << std::endl;
+  std::cout << "   Job values override command line values. A job which uses output of another" << std::endl;
+  std::cout << "   job as infile or @/$ value is processed after it. Jobs run in parallel" << std::endl;
+  std::cout << "   and status is printed for each job: [<exit code>] <infile> -> <outfile>" << std::endl;
+  std::cout << "Tree mode renders or copies each file of <srcdir> to the same path in <dstdir>." << std::endl;
+  std::cout << "   Directories are walked in parallel. Files not changed since the last run with" << std::endl;
+  std::cout << "   the same values and keys, whose outputs are not changed too, are skipped." << std::endl;
+  std::cout << "   Failed files are printed as [<exit code>] <file> -> <outfile>" << std::endl;
+  std::cout << "Matrix mode renders <infile> once for each variant of <variants> file to" << std::endl;
+  std::cout << "   <outfile pattern> with NAME replaced by variant name. The file has shared" << std::endl;
+  std::cout << "   <arg>=<val> lines, then [<name>] line of each variant with its own values," << std::endl;
+  std::cout << "   which override shared and command line values. The template is parsed once" << std::endl;
+  std::cout << "   as compiled template and variants are rendered in parallel. Status is printed" << std::endl;
+  std::cout << "   for each variant: [<exit code>] <name> -> <outfile>" << std::endl;
+  std::cout << "Server renders requests of clients as manifest jobs, until it is stopped by" << std::endl;
+  std::cout << "   SIGINT or SIGTERM. Keys and values of the server command line apply to all" << std::endl;
+  std::cout << "   requests. Templates, value files and replace tables are kept in memory while" << std::endl;
+  std::cout << "   their files are not changed, templates are parsed by each request as its" << std::endl;
+  std::cout << "   values define meta blocks. Idle clients do not take threads, on stop they are" << std::endl;
+  std::cout << "   disconnected. Client exits with exit code of its request (not on Windows)" << std::endl;
+  std::cout << "Compiled template keeps text, keys and meta blocks found in one pass, as in" << std::endl;
+  std::cout << "   stream mode. Keys to find are listed at compile time, values are ignored." << std::endl;
+  std::cout << "   Rendering fills the template from the table without searching text." << std::endl;
+  std::cout << "   Compile and render with the same -w key. UTF16 output of rendering is in" << std::endl;
+  std::cout << "   host byte order" << std::endl;
+  std::cout << "All template arguments are case sensitive" << std::endl;
+  std::cout << "   <arg> must be template string" << std::endl;
+  std::cout << "   <val> may be string or file path. If used file path it must be prefix" << std::endl;
+  std::cout << "         with @ or $ token: TPL=@C:\\file.txt or TPL=$C:\\file.txt" << std::endl;
+  std::cout << "         @ is used for ANSI/UTF8 files, $ for UTF16 files. Byte order mark of" << std::endl;
+  std::cout << "         the file overrides it. Values are converted to the format of <infile>" << std::endl;
+  std::cout << "EXAMPLE:" << std::endl;
+  std::cout << "   filereplace file.txt !(TPL1)=1.0.23 \"!(TPL2)=HELLO WORLD\" !(TPL3)=MODULE_1;MODULE_2;" << std::endl;
+  std::cout << "  Source file content:" << std::endl;
+  std::cout << "VERSION=!(TPL1) STRING '!(TPL2)'" << std::endl;
+  std::cout << "!%@IFCONTAINS[!(TPL3)][MODULE_2;]MODULE2 !(TPL2)!%@ENDIF%" << std::endl;
+  std::cout << "!%@IFCONTAINS[!(TPL3)][MODULE_3;]MODULE3 !(TPL1)!%@ENDIF%" << std::endl << std::endl;
+  std::cout << "  Result file content after processing finished:" << std::endl;
+  std::cout << "VERSION=1.0.23 STRING 'HELLO WORLD'" << std::endl;
+  std::cout << "MODULE2 HELLO WORLD" << std::endl << std::endl;
+}
+
+/**
+ * \brief  Find value of key in table files, a later table overrides an earlier one
+ * \param  table_files   Opened table files in command line order
+ * \param  key           Key
+ * \param  value [out]   Value
+ * \return true when a table has the key
+ */
+static bool find_table_value(const std::vector<std::unique_ptr<TableFile> >& table_files, const std::string& key, std::string& value) {
+  for (size_t i = table_files.size(); i-- > 0;) {
+    size_t entry = table_files[i]->find(key.data(), key.size());
+    if (entry < table_files[i]->size()) {
+      value.assign(table_files[i]->value(entry), table_files[i]->value_size(entry));
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief  Add all entries of table files to command line table. Keys which are
+ *         already in the table are kept, a later table overrides an earlier one
+ */
+static void add_table_entries(const std::vector<std::unique_ptr<TableFile> >& table_files, std::map<std::string, std::string>& table) {
+  for (size_t i = table_files.size(); i-- > 0;) {
+    for (size_t entry = 0; entry < table_files[i]->size(); entry++) {
+      table.insert(std::make_pair(std::string(table_files[i]->key(entry), table_files[i]->key_size(entry)),
+        std::string(table_files[i]->value(entry), table_files[i]->value_size(entry))));
+    }
+  }
+}
+
+/**
+ * \brief  Check whether text starts with the end of token or ends with the start of
+ *         token, so the token may be formed by joining the text with adjacent text
+ */
+template<typename TString>
+static bool has_partial_token(const TString& text, const TString& token) {
+  for (size_t size = 1; size < token.size() && size <= text.size(); size++) {
+    if (text.compare(0, size, token, token.size() - size, size) == 0 || text.compare(text.size() - size, size, token, 0, size) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * \brief  Find keys which text may use in placeholder mode: placeholders and keys of
+ *         meta conditions
+ * \param  text         Template or value
+ * \param  is_value     true for value, which is inserted between other text
+ * \param  keys [out]   Found keys, placeholders with their tokens
+ * \return false when keys cannot be predicted: value may form a placeholder or
+ *         meta token with adjacent text, or a placeholder may be changed by replacing
+ *         or removing text inside it
+ */
+template<typename TString, typename TParserParams>
+static bool find_placeholder_keys(
+  const TString& text,
+  bool is_value,
+  const PlaceholderFormat<TString>& placeholders,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  std::vector<TString>& keys) {
+
+  std::vector<const TString*> condition_tokens;
+  if (is_meta_enabled) {
+    condition_tokens.push_back(&parser_params.if_set_token_);
+    condition_tokens.push_back(&parser_params.if_not_set_token_);
+    condition_tokens.push_back(&parser_params.if_contains_token_);
+  }
+  std::vector<const TString*> meta_tokens(condition_tokens);
+  if (is_meta_enabled)
+    meta_tokens.push_back(&parser_params.end_if_token_);
+
+  if (is_value) {
+    if (text.empty() || has_partial_token(text, placeholders.open_token) || has_partial_token(text, placeholders.close_token))
+      return false;
+    for (const TString* token : meta_tokens) {
+      if (has_partial_token(text, *token))
+        return false;
+    }
+  }
+
+  const TString& open_token = placeholders.open_token;
+  const TString& close_token = placeholders.close_token;
+  size_t scanned = 0;
+  for (size_t offset; (offset = text.find(open_token, scanned)) != TString::npos;) {
+    // close token of a placeholder which starts before the value
+    if (is_value && text.find(close_token, scanned) < offset)
+      return false;
+
+    size_t close_offset = text.find(close_token, offset + open_token.size());
+    if (close_offset == TString::npos) {
+      if (is_value)   // placeholder may be closed after the value
+        return false;
+      break;
+    }
+
+    // nested placeholder or meta block may form a new placeholder when it is replaced
+    if (text.find(open_token, offset + 1) < close_offset)
+      return false;
+    for (const TString* token : meta_tokens) {
+      if (text.find(*token, offset) < close_offset)
+        return false;
+    }
+
+    scanned = close_offset + close_token.size();
+    keys.push_back(text.substr(offset, scanned - offset));
+  }
+  if (is_value && text.find(close_token, scanned) != TString::npos)
+    return false;
+
+  for (const TString* token : condition_tokens) {
+    for (size_t offset = 0; (offset = text.find(*token, offset)) != TString::npos; offset++) {
+      size_t tpl_start = offset + token->size();
+      size_t tpl_end = text.find(parser_params.bracket_close_token_, tpl_start);
+      if (tpl_end == TString::npos)
+        return false;
+
+      // meta blocks are processed before placeholders of the same pass, so key is taken as written
+      keys.push_back(text.substr(tpl_start, tpl_end - tpl_start));
+    }
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Add entries of table files which the template may use in placeholder mode.
+ *         Placeholders and meta condition keys of the template are looked up in the
+ *         command line table, then in table files, each with one hash lookup, and
+ *         values which are found are scanned for keys in the same way
+ * \param  in_filename   Template file path
+ * \param  table_files   Opened table files in command line order
+ * \param  table [in,out] Command line table, which overrides table files
+ * \return false when the template cannot be read or keys cannot be predicted,
+ *         then no entries are added
+ */
+template<typename TString, typename TParserParams>
+static bool add_used_table_entries(
+  const std::string& in_filename,
+  const PlaceholderFormat<TString>& placeholders,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  const std::vector<std::unique_ptr<TableFile> >& table_files,
+  std::map<std::string, std::string>& table) {
+
+  FileContent content;
+  if (!content.open(in_filename))
+    return false;
+
+  std::vector<TString> texts(1);
+  to_str(content.data(), content.size(), texts[0]);
+
+  std::set<TString> visited;
+  std::map<std::string, std::string> used_entries;
+  for (size_t i = 0; i < texts.size(); i++) {
+    std::vector<TString> keys;
+    if (!find_placeholder_keys(texts[i], i > 0, placeholders, is_meta_enabled, parser_params, keys))
+      return false;
+
+    for (const TString& key : keys) {
+      if (!visited.insert(key).second)
+        continue;
+
+      std::string name = to_utf8(key);
+      std::string value;
+      std::map<std::string, std::string>::const_iterator item = table.find(name);
+      if (item != table.end())
+        value = item->second;
+      else if (find_table_value(table_files, name, value))
+        used_entries[name] = value;
+      else
+        continue;
+
+      TString text;
+      if (is_file_value(value)) {
+        FileContent file;
+        if (!file.open(value.substr(1)))
+          return false;   // file error is reported by loading of all values
+        decode_value(file.data(), file.size(), value[0], text);
+      } else {
+        convert_value(value, text);
+      }
+      texts.push_back(text);
+    }
+  }
+
+  table.insert(used_entries.begin(), used_entries.end());
+  return true;
+}
+
+int run_command_line(int argc, char* argv[]) {
+  if (argc < 3) {
+    usage();
+    return 255;
+  }
+
+  std::map<std::string, std::string> replace_table;
+  std::vector<std::unique_ptr<TableFile> > table_files;   // looked up after replace_table
+  std::vector<std::string> compile_keys;
+  std::string mode = argv[1];
+
+  if (mode == "--compile-table") {
+    std::stringstream error_text;
+    if (argc != 4) {
+      usage();
+      return 255;
+    }
+
+    if (!compile_table_file(argv[2], argv[3], error_text)) {
+      std::cerr << error_text.str();
+      return 252;
+    }
+
+    return 0;
+  }
+
+  if (mode == "--client") {
+    if (argc < 5) {
+      usage();
+      return 255;
+    }
+#ifndef _WIN32
+    return request_render(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+#else  /*_WIN32*/
+    std::cerr << "command line error: --client is not supported on Windows" << std::endl;
+    return 254;
+#endif /*_WIN32*/
+  }
+
+  bool is_manifest = mode == "--manifest";
+  bool is_serve = mode == "--serve";
+  bool is_compile = mode == "--compile";
+  bool is_render = mode == "--render";
+  bool is_tree = mode == "--tree";
+  bool is_matrix = mode == "--matrix";
+  int first_option = is_matrix ? 5 : is_compile || is_render || is_tree ? 4 : 3;
+
+  if (argc < first_option) {
+    usage();
+    return 255;
+  }
+
+  // manifest file in manifest mode, socket in serve mode, template in compile, render and matrix modes, source directory in tree mode
+  std::string in_filename = argv[is_manifest || is_serve || is_compile || is_render || is_tree || is_matrix ? 2 : 1];
+  std::string out_filename = is_manifest || is_serve ? std::string() : argv[first_option - 1];   // outfile pattern in matrix mode
+  
+  bool is_meta_enabled = true;
+  bool is_utf16 = false;
+  bool is_stream = false;
+  bool is_expanded = false;
+  bool is_parallel = false;
+  bool is_watch = false;
+  int debounce_time = kDefaultDebounceTime;
+  size_t window_size = kDefaultWindowSize;
+  size_t threads_count = 0;
+  std::unique_ptr<RenderCache> render_cache;
+  std::unique_ptr<RecordCorpus> record_corpus;
+  std::unique_ptr<PhaseStats> stats;
+  std::string stats_filename;
+  std::string placeholder_pattern;
+  PathFilter tree_filter;
+  std::string state_filename;
+
+  // keep stdout clean when it is used for output
+  std::ostream& info_out = out_filename == kStdStreamName ? std::cerr : std::cout;
+
+  for (int i = first_option; i < argc; i++) {
+    std::string arg = argv[i];
+    std::string::size_type equal_token_pos = arg.find_first_of('=');
+
+    if (arg.compare(0, equal_token_pos, "--window-size") == 0) {
+      window_size = strtoul(arg.substr(equal_token_pos + 1).c_str(), nullptr, 10);
+      if (window_size < kMinWindowSize) {
+        std::cerr << "command line error: window size must be at least " << kMinWindowSize << std::endl;
+        return 254;
+      }
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--cache") == 0 && equal_token_pos != std::string::npos) {
+      render_cache.reset(new RenderCache(arg.substr(equal_token_pos + 1)));
+      if (!render_cache->open()) {
+        std::cerr << "Cannot create cache directory " << arg.substr(equal_token_pos + 1) << std::endl;
+        return 254;
+      }
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--record") == 0 && equal_token_pos != std::string::npos) {
+      record_corpus.reset(new RecordCorpus(arg.substr(equal_token_pos + 1)));
+      if (!record_corpus->open()) {
+        std::cerr << "Cannot create record directory " << arg.substr(equal_token_pos + 1) << std::endl;
+        return 254;
+      }
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--stats") == 0) {
+      if (is_manifest || is_serve || is_compile || is_render || is_tree || is_matrix) {
+        std::cerr << "command line error: --stats is supported only for <infile> <outfile> processing" << std::endl;
+        return 254;
+      }
+      stats.reset(new PhaseStats());
+      stats_filename = equal_token_pos == std::string::npos ? std::string() : arg.substr(equal_token_pos + 1);
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--table") == 0 && equal_token_pos != std::string::npos) {
+      std::unique_ptr<TableFile> table(new TableFile());
+      if (!table->open(arg.substr(equal_token_pos + 1), std::cerr))
+        return 253;
+
+      // table overrides values before it, values after it override the table
+      for (auto& item : replace_table) {
+        size_t entry = table->find(item.first.data(), item.first.size());
+        if (entry < table->size())
+          item.second.assign(table->value(entry), table->value_size(entry));
+      }
+      table_files.push_back(std::move(table));
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--placeholders") == 0) {
+      placeholder_pattern = equal_token_pos == std::string::npos ? kDefaultPlaceholderPattern : arg.substr(equal_token_pos + 1);
+      if (!get_placeholder_format<std::string>(placeholder_pattern).is_enabled()) {
+        std::cerr << "command line error: placeholder pattern must be <open>" << kPlaceholderName << "<close>" << std::endl;
+        return 254;
+      }
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--include") == 0 && equal_token_pos != std::string::npos) {
+      tree_filter.includes.push_back(arg.substr(equal_token_pos + 1));
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--exclude") == 0 && equal_token_pos != std::string::npos) {
+      tree_filter.excludes.push_back(arg.substr(equal_token_pos + 1));
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--state") == 0 && equal_token_pos != std::string::npos) {
+      state_filename = arg.substr(equal_token_pos + 1);
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--watch") == 0) {
+      is_watch = true;
+      if (equal_token_pos != std::string::npos)
+        debounce_time = atoi(arg.substr(equal_token_pos + 1).c_str());
+      continue;
+    }
+
+    if (arg.compare(0, equal_token_pos, "--jobs") == 0) {
+      threads_count = strtoul(arg.substr(equal_token_pos + 1).c_str(), nullptr, 10);
+      continue;
+    }
+
+    if (equal_token_pos == std::string::npos) {
+      if (is_compile && arg.size() && arg[0] != '-') {
+        compile_keys.push_back(arg);
+        continue;
+      }
+
+      if (arg.size() && arg[0] != '-') {
+        std::cerr << "command line error: equal sign is not found in <template>=<value> construction" << std::endl;
+        return 254;
+      }
+
+      arg = arg.substr(1);
+
+      if (arg == "-disable-meta" || arg == "d") {
+        info_out << "Meta language is disabled" << std::endl;
+        is_meta_enabled = false;
+        continue;
+      }
+
+      if (arg == "-enable-meta" || arg == "e") {
+        info_out << "Meta language is enabled" << std::endl;
+        is_meta_enabled = true;
+        continue;
+      }
+	  
+	  if (arg == "w" || arg == "-unicode") {
+		info_out << "file format set UTF16" << std::endl;
+		is_utf16 = true;
+		continue;
+	  }
+
+      if (arg == "s" || arg == "-stream") {
+        is_stream = true;
+        continue;
+      }
+
+      if (arg == "-expand") {
+        is_expanded = true;
+        continue;
+      }
+
+      if (arg == "-parallel") {
+        is_parallel = true;
+        continue;
+      }
+
+      std::cerr << "Key was not recognized: " << arg << std::endl;
+    }
+
+    std::string key = arg.substr(0, equal_token_pos);
+    std::string value = arg.substr(equal_token_pos + 1);
+    replace_table[key] = value;
+  }
+  
+  if (!placeholder_pattern.empty() && (is_stream || is_compile || is_render || is_matrix)) {
+    std::cerr << "command line error: --placeholders is not supported in stream, compile, render and matrix modes" << std::endl;
+    return 254;
+  }
+
+  if (is_expanded && (is_compile || is_render || is_matrix)) {
+    std::cerr << "command line error: --expand is not supported in compile, render and matrix modes" << std::endl;
+    return 254;
+  }
+
+  if (is_parallel && (is_stream || is_manifest || is_serve || is_compile || is_render || is_tree || is_matrix)) {
+    std::cerr << "command line error: --parallel is supported only for <infile> <outfile> processing without stream mode" << std::endl;
+    return 254;
+  }
+  size_t render_threads = is_parallel ? threads_count : 1;
+
+  // one template in placeholder mode takes only table entries which it may use,
+  // other modes and templates which keys cannot be predicted for take all entries
+  if (!table_files.empty()) {
+    bool is_used_only = !placeholder_pattern.empty() && !is_manifest && !is_serve && !is_tree && !is_watch
+      && in_filename != kStdStreamName;
+    bool is_added = is_used_only && (is_utf16
+      ? add_used_table_entries(in_filename, get_placeholder_format<std::u16string>(placeholder_pattern), is_meta_enabled,
+        ParserParamsUtf16(), table_files, replace_table)
+      : add_used_table_entries(in_filename, get_placeholder_format<std::string>(placeholder_pattern), is_meta_enabled,
+        ParserParamsAnsi(), table_files, replace_table));
+    if (!is_added)
+      add_table_entries(table_files, replace_table);
+    table_files.clear();
+  }
+
+  if (is_watch && (is_serve || is_compile || is_render || is_tree || is_matrix || stats
+    || in_filename == kStdStreamName || out_filename == kStdStreamName)) {
+    std::cerr << "command line error: --watch is supported only for <infile> <outfile> files and manifests" << std::endl;
+    return 254;
+  }
+
+  if (is_watch) {
+#ifdef __linux__
+    std::vector<BatchJob> jobs(is_manifest ? 0 : 1);
+    if (is_manifest && !load_manifest(in_filename, jobs, std::cerr))
+      return 254;
+    if (!is_manifest) {
+      jobs[0].in_filename = in_filename;
+      jobs[0].out_filename = out_filename;
+    }
+
+    if (!is_utf16)
+      return WatchRenderer<std::string, ParserParamsAnsi>(jobs, replace_table, is_meta_enabled, is_stream, window_size,
+        get_placeholder_format<std::string>(placeholder_pattern), is_expanded, render_cache.get(), render_threads).run(debounce_time);
+    else
+      return WatchRenderer<std::u16string, ParserParamsUtf16>(jobs, replace_table, is_meta_enabled, is_stream, window_size,
+        get_placeholder_format<std::u16string>(placeholder_pattern), is_expanded, render_cache.get(), render_threads).run(debounce_time);
+#else  /*__linux__*/
+    std::cerr << "command line error: --watch is supported only on Linux" << std::endl;
+    return 254;
+#endif /*__linux__*/
+  }
+
+  if (record_corpus && (is_manifest || is_serve || is_tree || is_matrix || is_watch
+    || in_filename == kStdStreamName || out_filename == kStdStreamName)) {
+    std::cerr << "command line error: --record is supported only for <infile> <outfile> files, compile and render modes" << std::endl;
+    return 254;
+  }
+
+  if (!is_tree && (!tree_filter.includes.empty() || !tree_filter.excludes.empty() || !state_filename.empty())) {
+    std::cerr << "command line error: --include, --exclude and --state are supported only in tree mode" << std::endl;
+    return 254;
+  }
+
+  if (is_serve) {
+#ifndef _WIN32
+    if (!is_utf16)
+      return RenderServer<std::string, ParserParamsAnsi>(replace_table, is_meta_enabled, is_stream, window_size,
+        get_placeholder_format<std::string>(placeholder_pattern), is_expanded, render_cache.get()).run(in_filename, threads_count);
+    else
+      return RenderServer<std::u16string, ParserParamsUtf16>(replace_table, is_meta_enabled, is_stream, window_size,
+        get_placeholder_format<std::u16string>(placeholder_pattern), is_expanded, render_cache.get()).run(in_filename, threads_count);
+#else  /*_WIN32*/
+    std::cerr << "command line error: --serve is not supported on Windows" << std::endl;
+    return 254;
+#endif /*_WIN32*/
+  }
+
+  if (is_manifest) {
+    std::vector<BatchJob> jobs;
+    if (!load_manifest(in_filename, jobs, std::cerr))
+      return 254;
+
+    if (!is_utf16)
+      return process_manifest<std::string>(jobs, replace_table, is_meta_enabled, is_stream, window_size, ParserParamsAnsi(),
+        get_placeholder_format<std::string>(placeholder_pattern), is_expanded, render_cache.get(), threads_count);
+    else
+      return process_manifest<std::u16string>(jobs, replace_table, is_meta_enabled, is_stream, window_size, ParserParamsUtf16(),
+        get_placeholder_format<std::u16string>(placeholder_pattern), is_expanded, render_cache.get(), threads_count);
+  }
+
+  if (is_tree) {
+    if (!is_utf16)
+      return process_tree<std::string>(in_filename, out_filename, tree_filter, state_filename, replace_table, is_meta_enabled,
+        is_stream, window_size, ParserParamsAnsi(), get_placeholder_format<std::string>(placeholder_pattern), is_expanded,
+        render_cache.get(), threads_count);
+    else
+      return process_tree<std::u16string>(in_filename, out_filename, tree_filter, state_filename, replace_table, is_meta_enabled,
+        is_stream, window_size, ParserParamsUtf16(), get_placeholder_format<std::u16string>(placeholder_pattern), is_expanded,
+        render_cache.get(), threads_count);
+  }
+
+  if (is_matrix) {
+    if (!is_utf16)
+      return process_matrix<std::string>(in_filename, argv[3], out_filename, replace_table, is_meta_enabled, ParserParamsAnsi(), threads_count);
+    else
+      return process_matrix<std::u16string>(in_filename, argv[3], out_filename, replace_table, is_meta_enabled, ParserParamsUtf16(), threads_count);
+  }
+
+  if (is_compile) {
+    std::stringstream error_text;
+    for (const auto& item : replace_table)
+      compile_keys.push_back(item.first);
+
+    bool is_compiled = is_utf16
+      ? compile_template_file<std::u16string>(in_filename, out_filename, compile_keys, is_meta_enabled, ParserParamsUtf16(), error_text)
+      : compile_template_file<std::string>(in_filename, out_filename, compile_keys, is_meta_enabled, ParserParamsAnsi(), error_text);
+
+    if (record_corpus)
+      record_invocation(*record_corpus, argc, argv, first_option, mode, in_filename, out_filename, replace_table, is_compiled ? 0 : 252);
+
+    if (!is_compiled) {
+      std::cerr << error_text.str();
+      return 252;
+    }
+
+    return 0;
+  }
+
+  std::map<std::u16string, std::u16string> replace_table_utf16;
+  std::map<std::string, std::string> replace_table_ansi;
+  ValueFileCache value_files;
+  std::string failed_filename;
+
+  // values of one template are loaded only when it uses them. Stream mode keeps
+  // memory bounded and stdin cannot be scanned before processing
+  bool is_lazy = !is_render && !is_stream && in_filename != kStdStreamName;
+  bool is_loaded;
+
+  // template is read once for key usage scan, render key and rendering
+  PhaseTimer load_timer(stats.get(), kPhaseLoad);
+  FileContent content;
+  bool is_read = is_lazy && content.open(in_filename);
+  load_timer.stop();
+
+  PhaseTimer values_timer(stats.get(), kPhaseValues);
+  if (is_utf16)
+    is_loaded = is_lazy
+      ? load_used_replace_table(is_read ? &content : nullptr, replace_table, is_meta_enabled, ParserParamsUtf16(), value_files, replace_table_utf16, failed_filename)
+      : load_replace_table(replace_table, value_files, replace_table_utf16, failed_filename);
+  else
+    is_loaded = is_lazy
+      ? load_used_replace_table(is_read ? &content : nullptr, replace_table, is_meta_enabled, ParserParamsAnsi(), value_files, replace_table_ansi, failed_filename)
+      : load_replace_table(replace_table, value_files, replace_table_ansi, failed_filename);
+
+  if (!is_loaded) {
+    std::cerr << "Cannot load file content " << failed_filename << std::endl;
+    return 253;
+  }
+  values_timer.stop();
+
+  std::stringstream error_text;
+
+  if (in_filename == kStdStreamName)
+    set_binary_mode(stdin);
+  if (out_filename == kStdStreamName)
+    set_binary_mode(stdout);
+
+  bool is_processed;
+  if (!is_utf16) {
+	  std::unique_ptr<AnsiReplaceTable> table;
+	  if (!is_render) {
+		  PhaseTimer table_timer(stats.get(), kPhaseValues);
+		  table = build_replace_table(std::move(replace_table_ansi), is_meta_enabled, ParserParamsAnsi(),
+			  get_placeholder_format<std::string>(placeholder_pattern), is_expanded, std::cerr,
+			  is_read ? &content : nullptr);
+		  if (!table)
+			  return 253;
+	  }
+
+	  is_processed = is_render
+		  ? render_template_file(in_filename, out_filename, replace_table_ansi, error_text)
+		  : process_file(in_filename, out_filename, *table, is_stream, window_size, render_threads, render_cache.get(), error_text, stats.get(),
+			  is_read ? &content : nullptr);
+
+	  if (stats && !write_stats(stats_filename, *stats, table->values(), info_out, error_text))
+		  is_processed = false;
+  }
+  else {
+	  std::unique_ptr<Utf16ReplaceTable> table;
+	  if (!is_render) {
+		  PhaseTimer table_timer(stats.get(), kPhaseValues);
+		  table = build_replace_table(std::move(replace_table_utf16), is_meta_enabled, ParserParamsUtf16(),
+			  get_placeholder_format<std::u16string>(placeholder_pattern), is_expanded, std::cerr,
+			  is_read ? &content : nullptr);
+		  if (!table)
+			  return 253;
+	  }
+
+	  is_processed = is_render
+		  ? render_template_file(in_filename, out_filename, replace_table_utf16, error_text)
+		  : process_file(in_filename, out_filename, *table, is_stream, window_size, render_threads, render_cache.get(), error_text, stats.get(),
+			  is_read ? &content : nullptr);
+
+	  if (stats && !write_stats(stats_filename, *stats, table->values(), info_out, error_text))
+		  is_processed = false;
+  }
+
+  if (record_corpus)
+    record_invocation(*record_corpus, argc, argv, first_option, is_render ? mode : std::string(), in_filename, out_filename,
+      replace_table, is_processed ? 0 : 252);
+
+  if (!is_processed) {
+    std::cerr << error_text.str();
+    return 252;
+  }
+
+  if (render_cache)
+    render_cache->print_stats(info_out);
+
+  return 0;
+}
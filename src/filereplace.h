@@ -0,0 +1,12 @@
+#ifndef FILEREPLACE_FILEREPLACE_H_
+#define FILEREPLACE_FILEREPLACE_H_
+
+
+/**
+ * \brief  Command line tool, main() without process setup, so a process may run
+ *         it several times (replay of recorded invocations)
+ * \return Exit code
+ */
+int run_command_line(int argc, char* argv[]);
+
+#endif  // FILEREPLACE_FILEREPLACE_H_
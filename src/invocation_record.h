@@ -0,0 +1,294 @@
+#ifndef FILEREPLACE_INVOCATION_RECORD_H_
+#define FILEREPLACE_INVOCATION_RECORD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "content_hash.h"
+#include "slice_output.h"
+
+
+/**
+ * \brief  Value of recorded invocation: text, or @file/$file value with file content
+ */
+struct RecordedValue {
+  std::string key;
+  std::string value;    // text, or @/$ token and original file path
+  std::string object;   // content of file value, empty for text
+};
+
+/**
+ * \brief  One recorded run of filereplace. Files are referenced by content hash
+ *         (objects of corpus), so the run is replayed without original files
+ */
+struct InvocationRecord {
+  std::string name;                    // record file name, set by loading
+  std::vector<std::string> argv;       // original command line, for reference
+  std::string mode;                    // --compile, --render, empty for <infile> <outfile>
+  std::string input_object;
+  std::string input_filename;
+  std::string output_object;           // empty when processing failed
+  std::string output_filename;
+  std::vector<std::string> options;    // flags and compile keys, replayed as is
+  std::vector<RecordedValue> values;   // effective table, --table entries included
+  int status = 0;
+};
+
+/**
+ * \brief  Corpus of recorded invocations for replay.
+ *
+ * Directory layout:
+ *   objects/<hash>            contents of templates, value files and outputs, stored once
+ *   invocations/<name>.rec    one text record per invocation, names sort by time
+ *
+ * Record is a line per field, fields are separated by spaces and escaped, so
+ * arguments with spaces and line ends are kept. Objects and records are written
+ * through temporary files, so the corpus may be shared by parallel processes.
+ */
+class RecordCorpus {
+public:
+  explicit RecordCorpus(const std::string& directory) : directory_(directory) {
+  }
+
+  /**
+   * \brief  Create corpus directories
+   * \return true on success
+   */
+  bool open() {
+    std::error_code error;
+    std::filesystem::create_directories(get_objects_directory(), error);
+    std::filesystem::create_directories(get_records_directory(), error);
+    return std::filesystem::is_directory(get_objects_directory(), error) && std::filesystem::is_directory(get_records_directory(), error);
+  }
+
+  /**
+   * \brief  Store content once by its hash
+   * \param  object [out]  Object name
+   * \return true on success
+   */
+  bool store_object(const char* data, size_t size, std::string& object) {
+    ContentHash hash;
+    hash.update(data, size);
+    hash.update_size(size);
+    object = ContentHash::to_hex(hash.digest());
+
+    std::error_code error;
+    std::string filename = get_object_filename(object);
+    if (std::filesystem::file_size(filename, error) == size && !error)
+      return true;
+
+    return write_file(filename, data, size);
+  }
+
+  /**
+   * \brief  Store content of file once by its hash
+   * \param  object [out]  Object name
+   * \return true on success, false when the file cannot be read or stored
+   */
+  bool store_file(const std::string& filename, std::string& object) {
+    std::vector<char> data;
+    return read_file(filename, data) && store_object(data.data(), data.size(), object);
+  }
+
+  std::string get_object_filename(const std::string& object) const {
+    return (std::filesystem::path(get_objects_directory()) / object).string();
+  }
+
+  /**
+   * \brief  Store invocation record under a new name
+   * \return true on success
+   */
+  bool store(const InvocationRecord& record) {
+    std::ostringstream text;
+    text << kRecordMagic << '\n';
+    text << "status " << record.status << '\n';
+    for (const std::string& arg : record.argv)
+      text << "argv " << escape(arg) << '\n';
+    text << "mode " << escape(record.mode) << '\n';
+    text << "input " << record.input_object << ' ' << escape(record.input_filename) << '\n';
+    text << "output " << (record.output_object.empty() ? "-" : record.output_object) << ' ' << escape(record.output_filename) << '\n';
+    for (const std::string& option : record.options)
+      text << "option " << escape(option) << '\n';
+    for (const RecordedValue& value : record.values) {
+      if (value.object.empty())
+        text << "value " << escape(value.key) << ' ' << escape(value.value) << '\n';
+      else
+        text << "file " << escape(value.key) << ' ' << value.object << ' ' << escape(value.value) << '\n';
+    }
+
+    // time prefix keeps records in invocation order, random suffix separates processes
+    std::random_device random;
+    uint64_t suffix = (static_cast<uint64_t>(random()) << 32) | random();
+    uint64_t time = std::chrono::system_clock::now().time_since_epoch() / std::chrono::microseconds(1);
+    std::string name = ContentHash::to_hex(time) + "-" + ContentHash::to_hex(suffix) + kRecordExtension;
+
+    std::string content = text.str();
+    return write_file((std::filesystem::path(get_records_directory()) / name).string(), content.data(), content.size());
+  }
+
+  /**
+   * \brief  Load all records in name order
+   * \param  records [out]     Records
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false when the corpus or a record cannot be read
+   */
+  bool load(std::vector<InvocationRecord>& records, std::ostream& error_text) const {
+    std::error_code error;
+    std::vector<std::string> names;
+    for (std::filesystem::directory_iterator it(get_records_directory(), error), end; !error && it != end; it.increment(error)) {
+      if (it->path().extension() == kRecordExtension)
+        names.push_back(it->path().filename().string());
+    }
+
+    if (error) {
+      error_text << "Cannot read corpus " << directory_ << std::endl;
+      return false;
+    }
+
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names) {
+      InvocationRecord record;
+      record.name = name;
+      if (!parse((std::filesystem::path(get_records_directory()) / name).string(), record)) {
+        error_text << "Invalid record " << name << std::endl;
+        return false;
+      }
+      records.push_back(record);
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Read whole file
+   * \return true on success
+   */
+  static bool read_file(const std::string& filename, std::vector<char>& data) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+      return false;
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+  }
+
+private:
+  static constexpr const char* kRecordMagic = "filereplace-record 1";
+  static constexpr const char* kRecordExtension = ".rec";
+
+  std::string get_objects_directory() const {
+    return (std::filesystem::path(directory_) / "objects").string();
+  }
+
+  std::string get_records_directory() const {
+    return (std::filesystem::path(directory_) / "invocations").string();
+  }
+
+  static bool write_file(const std::string& filename, const char* data, size_t size) {
+    OutputFile file;
+    if (!file.open(filename, true))
+      return false;
+
+    // not committed file is removed
+    return (!size || fwrite(data, 1, size, file.file()) == size) && file.commit();
+  }
+
+  bool parse(const std::string& filename, InvocationRecord& record) const {
+    std::ifstream file(filename, std::ios::binary);
+    std::string line;
+    if (!std::getline(file, line) || line != kRecordMagic)
+      return false;
+
+    while (std::getline(file, line)) {
+      std::vector<std::string> fields = split(line);
+      const std::string& field = fields[0];
+
+      if (field == "status" && fields.size() == 2) {
+        record.status = atoi(fields[1].c_str());
+      } else if (field == "argv" && fields.size() == 2) {
+        record.argv.push_back(fields[1]);
+      } else if (field == "mode" && fields.size() == 2) {
+        record.mode = fields[1];
+      } else if (field == "input" && fields.size() == 3) {
+        record.input_object = fields[1];
+        record.input_filename = fields[2];
+      } else if (field == "output" && fields.size() == 3) {
+        record.output_object = fields[1] == "-" ? std::string() : fields[1];
+        record.output_filename = fields[2];
+      } else if (field == "option" && fields.size() == 2) {
+        record.options.push_back(fields[1]);
+      } else if (field == "value" && fields.size() == 3) {
+        RecordedValue value = { fields[1], fields[2], std::string() };
+        record.values.push_back(value);
+      } else if (field == "file" && fields.size() == 4) {
+        RecordedValue value = { fields[1], fields[3], fields[2] };
+        record.values.push_back(value);
+      } else {
+        return false;
+      }
+    }
+
+    return !record.input_object.empty();
+  }
+
+  /**
+   * \brief  Escape field, so it has no spaces and line ends
+   */
+  static std::string escape(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+      switch (c) {
+      case '\\': result += "\\\\"; break;
+      case ' ': result += "\\s"; break;
+      case '\t': result += "\\t"; break;
+      case '\r': result += "\\r"; break;
+      case '\n': result += "\\n"; break;
+      default: result += c; break;
+      }
+    }
+    return result;
+  }
+
+  /**
+   * \brief  Split line to unescaped fields, empty fields are kept
+   */
+  static std::vector<std::string> split(const std::string& line) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); i++) {
+      if (line[i] == ' ') {
+        fields.push_back(std::string());
+        continue;
+      }
+
+      if (line[i] != '\\' || i + 1 == line.size()) {
+        fields.back() += line[i];
+        continue;
+      }
+
+      switch (line[++i]) {
+      case 's': fields.back() += ' '; break;
+      case 't': fields.back() += '\t'; break;
+      case 'r': fields.back() += '\r'; break;
+      case 'n': fields.back() += '\n'; break;
+      default: fields.back() += line[i]; break;
+      }
+    }
+    return fields;
+  }
+
+  std::string directory_;
+};
+
+#endif  // FILEREPLACE_INVOCATION_RECORD_H_
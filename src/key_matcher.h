@@ -0,0 +1,399 @@
+#ifndef FILEREPLACE_KEY_MATCHER_H_
+#define FILEREPLACE_KEY_MATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <deque>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "scan_kernels.h"
+
+
+/**
+ * \brief  Multi-pattern matcher (Aho-Corasick automaton) over a set of keys.
+ *
+ * All keys are found in one scan of the text with leftmost-longest semantics:
+ * the match with the smallest start position wins, and of several matches
+ * starting at the same position the longest one wins.
+ * Characters are mapped to compact classes, so the transition table size does
+ * not depend on the code unit width. While the automaton is in the root state,
+ * text without first units of patterns is skipped with vectorized scan.
+ */
+template<typename TChar>
+class KeyMatcher {
+public:
+  struct Match {
+    size_t position;
+    size_t length;
+    size_t pattern;
+  };
+
+  enum FindResult {
+    kFound,
+    kNotFound,
+    kNeedMoreData
+  };
+
+  KeyMatcher() {
+    clear();
+  }
+
+  void clear() {
+    nodes_.clear();
+    nodes_.push_back(Node());
+    edges_.clear();
+    trie_edges_.clear();
+    patterns_.clear();
+    transitions_.clear();
+    class_map_.assign(sizeof(TChar) == 1 ? 0x100 : 0x10000, 0);
+    wide_classes_.clear();
+    first_units_.clear();
+    classes_count_ = 1;
+    max_pattern_size_ = 0;
+    has_empty_pattern_ = false;
+    is_dense_ = false;
+    is_built_ = false;
+  }
+
+  /**
+   * \brief  Add pattern to matcher. Must be called before build()
+   * \param  pattern  Pattern code units
+   * \param  size     Pattern size in code units
+   * \return Pattern index, used in Match::pattern
+   */
+  size_t add_pattern(const TChar* pattern, size_t size) {
+    size_t index = patterns_.size();
+    patterns_.push_back(size);
+    max_pattern_size_ = std::max(max_pattern_size_, size);
+
+    if (!size) {
+      has_empty_pattern_ = true;
+      return index;
+    }
+
+    UnsignedChar first_unit = static_cast<UnsignedChar>(pattern[0]);
+    if (std::find(first_units_.begin(), first_units_.end(), first_unit) == first_units_.end())
+      first_units_.push_back(first_unit);
+
+    int32_t state = 0;
+    for (size_t i = 0; i < size; i++) {
+      uint32_t char_class = register_class(pattern[i]);
+      uint64_t edge_key = (static_cast<uint64_t>(state) << 32) | char_class;
+      typename std::unordered_map<uint64_t, int32_t>::const_iterator it = trie_edges_.find(edge_key);
+      if (it == trie_edges_.end()) {
+        int32_t next = static_cast<int32_t>(nodes_.size());
+        nodes_.push_back(Node());
+        nodes_.back().depth = nodes_[state].depth + 1;
+        edges_.push_back(Edge(state, char_class, next));
+        trie_edges_.insert(std::make_pair(edge_key, next));
+        state = next;
+      } else {
+        state = it->second;
+      }
+    }
+
+    if (nodes_[state].pattern < 0)
+      nodes_[state].pattern = static_cast<int32_t>(index);
+
+    return index;
+  }
+
+  /**
+   * \brief  Build failure links and transition table. Patterns cannot be added after build
+   */
+  void build() {
+    trie_edges_.clear();
+    std::sort(edges_.begin(), edges_.end());
+    for (size_t i = 0; i < nodes_.size(); i++)
+      nodes_[i].first_edge = nodes_[i].last_edge = 0;
+
+    for (size_t i = 0; i < edges_.size(); i++) {
+      Node& node = nodes_[edges_[i].from];
+      if (node.first_edge == node.last_edge)
+        node.first_edge = static_cast<uint32_t>(i);
+      node.last_edge = static_cast<uint32_t>(i + 1);
+    }
+
+    const size_t kMaxDenseTableSize = 1 << 24;
+    is_dense_ = nodes_.size() * classes_count_ <= kMaxDenseTableSize;
+    if (is_dense_)
+      transitions_.assign(nodes_.size() * classes_count_, 0);
+
+    // breadth-first walk, parents are always processed before children
+    std::deque<int32_t> queue;
+    queue.push_back(0);
+    while (!queue.empty()) {
+      int32_t state = queue.front();
+      queue.pop_front();
+
+      Node& node = nodes_[state];
+      node.output = node.pattern >= 0 ? node.pattern : (state ? nodes_[node.fail].output : -1);
+      node.dictionary_link = state ? (nodes_[node.fail].pattern >= 0 ? node.fail : nodes_[node.fail].dictionary_link) : 0;
+
+      if (is_dense_ && state)
+        std::copy(
+          transitions_.begin() + row(node.fail),
+          transitions_.begin() + row(node.fail) + classes_count_,
+          transitions_.begin() + row(state));
+
+      for (uint32_t i = node.first_edge; i < node.last_edge; i++) {
+        const Edge& edge = edges_[i];
+        // transitions of the failure state are complete, it is less deep
+        nodes_[edge.to].fail = state ? next_state(node.fail, edge.char_class) : 0;
+        if (is_dense_)
+          transitions_[row(state) + edge.char_class] = edge.to;
+        queue.push_back(edge.to);
+      }
+    }
+
+    is_built_ = true;
+  }
+
+  size_t patterns_count() const {
+    return patterns_.size();
+  }
+
+  size_t max_pattern_size() const {
+    return max_pattern_size_;
+  }
+
+  /**
+   * \brief  Check that no two occurrences of patterns can ever overlap in any text
+   *
+   * It is true when no pattern is empty, no pattern is a substring of another one
+   * and no suffix of a pattern is a prefix of a pattern (itself included).
+   * For such sets the set of occurrences in a text is unique: it does not depend
+   * on the scan order, the scan start or on the priority between patterns.
+   */
+  bool is_conflict_free() const {
+    if (has_empty_pattern_)
+      return false;
+
+    for (size_t state = 1; state < nodes_.size(); state++) {
+      const Node& node = nodes_[state];
+      if (nodes_[node.fail].output >= 0)
+        return false;  // other pattern ends inside this prefix
+
+      if (node.pattern >= 0 && (node.fail != 0 || node.first_edge != node.last_edge))
+        return false;  // pattern continues to another pattern
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Find leftmost-longest match in text
+   * \param  text          Text buffer
+   * \param  size          Text size in code units
+   * \param  from          Position to start search from
+   * \param  is_final      false when text is a window and more data may follow it
+   * \param  match [out]   Found match. For kNeedMoreData position is the first
+   *                       position which must be kept for the next search
+   * \return kFound, kNotFound, or kNeedMoreData when a match cannot be decided
+   *         without data beyond the end of the text (only when is_final is false)
+   */
+  FindResult find(const TChar* text, size_t size, size_t from, bool is_final, Match& match) const {
+    int32_t state = 0;
+    bool has_best = false;
+
+    for (size_t i = from; i < size; i++) {
+      // in the root state no match is pending, so the text up to a first unit is skipped
+      if (!state && is_scan_enabled()) {
+        i += scan_first_units(text + i, size - i);
+        if (i == size)
+          break;
+      }
+
+      state = next_state(state, class_of(text[i]));
+      const Node& node = nodes_[state];
+
+      if (node.output >= 0) {
+        size_t length = patterns_[node.output];
+        size_t position = i + 1 - length;
+        if (!has_best || position < match.position || (position == match.position && length > match.length)) {
+          match.position = position;
+          match.length = length;
+          match.pattern = static_cast<size_t>(node.output);
+          has_best = true;
+        }
+      }
+
+      // no later match may start at or before the best one
+      if (has_best && i + 1 - node.depth > match.position)
+        return kFound;
+    }
+
+    if (!is_final) {
+      match.position = size - nodes_[state].depth;
+      match.length = 0;
+      return kNeedMoreData;
+    }
+
+    return has_best ? kFound : kNotFound;
+  }
+
+  /**
+   * \brief  Check whether text contains an occurrence of any pattern
+   * \param  state [in,out]   Automaton state, 0 at text start. Allows to check text split to pieces
+   * \param  patterns_limit   Only patterns with smaller index are checked. Must be
+   *                          used only for conflict free pattern sets
+   */
+  bool contains_any(const TChar* text, size_t size, int32_t& state, size_t patterns_limit) const {
+    for (size_t i = 0; i < size; i++) {
+      if (!state && is_scan_enabled()) {
+        i += scan_first_units(text + i, size - i);
+        if (i == size)
+          break;
+      }
+
+      state = next_state(state, class_of(text[i]));
+      if (nodes_[state].output >= 0 && static_cast<size_t>(nodes_[state].output) < patterns_limit)
+        return true;
+    }
+
+    return false;
+  }
+
+  bool contains_any(const TChar* text, size_t size) const {
+    int32_t state = 0;
+    return contains_any(text, size, state, patterns_.size());
+  }
+
+  /**
+   * \brief  Mark all patterns which occur in text, overlapping occurrences included
+   * \param  state [in,out]   Automaton state, 0 at text start. Allows to scan text split to pieces
+   * \param  found [in,out]   Flags by pattern index, found patterns are set
+   */
+  void mark_all(const TChar* text, size_t size, int32_t& state, std::vector<bool>& found) const {
+    for (size_t i = 0; i < size; i++) {
+      if (!state && is_scan_enabled()) {
+        i += scan_first_units(text + i, size - i);
+        if (i == size)
+          break;
+      }
+
+      state = next_state(state, class_of(text[i]));
+      int32_t node = nodes_[state].pattern >= 0 ? state : nodes_[state].dictionary_link;
+      for (; node; node = nodes_[node].dictionary_link)
+        found[nodes_[node].pattern] = true;
+    }
+  }
+
+private:
+  typedef typename std::make_unsigned<TChar>::type UnsignedChar;
+
+  struct Node {
+    int32_t fail = 0;
+    int32_t pattern = -1;  // pattern which ends exactly in this node
+    int32_t output = -1;   // longest pattern which ends in this node or its failure chain
+    int32_t dictionary_link = 0;   // nearest node of failure chain where a pattern ends, 0 for none
+    uint32_t depth = 0;
+    uint32_t first_edge = 0;
+    uint32_t last_edge = 0;
+  };
+
+  struct Edge {
+    int32_t from;
+    uint32_t char_class;
+    int32_t to;
+
+    Edge(int32_t from, uint32_t char_class, int32_t to) : from(from), char_class(char_class), to(to) {}
+
+    bool operator<(const Edge& other) const {
+      return from != other.from ? from < other.from : char_class < other.char_class;
+    }
+  };
+
+  uint32_t class_of(TChar c) const {
+    UnsignedChar code = static_cast<UnsignedChar>(c);
+    if (code < class_map_.size())
+      return class_map_[code];
+
+    typename std::vector<std::pair<UnsignedChar, uint32_t> >::const_iterator it = std::lower_bound(
+      wide_classes_.begin(), wide_classes_.end(), std::make_pair(code, static_cast<uint32_t>(0)));
+    return it != wide_classes_.end() && it->first == code ? it->second : 0;
+  }
+
+  uint32_t register_class(TChar c) {
+    uint32_t char_class = class_of(c);
+    if (char_class)
+      return char_class;
+
+    char_class = classes_count_++;
+    UnsignedChar code = static_cast<UnsignedChar>(c);
+    if (code < class_map_.size()) {
+      class_map_[code] = char_class;
+    } else {
+      std::pair<UnsignedChar, uint32_t> item(code, char_class);
+      wide_classes_.insert(std::lower_bound(wide_classes_.begin(), wide_classes_.end(), item), item);
+    }
+
+    return char_class;
+  }
+
+  /**
+   * \brief  Scan is used for 8-bit and 16-bit code units and small sets of first units
+   */
+  bool is_scan_enabled() const {
+    return (sizeof(TChar) == 1 || sizeof(TChar) == 2) && !has_empty_pattern_
+      && !first_units_.empty() && first_units_.size() <= kMaxScanUnits;
+  }
+
+  size_t scan_first_units(const TChar* text, size_t size) const {
+    if constexpr (sizeof(TChar) == 1)
+      return scan_units(reinterpret_cast<const uint8_t*>(text), size, reinterpret_cast<const uint8_t*>(first_units_.data()), first_units_.size());
+    else if constexpr (sizeof(TChar) == 2)
+      return scan_units(reinterpret_cast<const uint16_t*>(text), size, reinterpret_cast<const uint16_t*>(first_units_.data()), first_units_.size());
+    else
+      return 0;
+  }
+
+  size_t row(int32_t state) const {
+    return static_cast<size_t>(state) * classes_count_;
+  }
+
+  int32_t find_edge(int32_t state, uint32_t char_class) const {
+    const Node& node = nodes_[state];
+    typename std::vector<Edge>::const_iterator it = std::lower_bound(
+      edges_.begin() + node.first_edge, edges_.begin() + node.last_edge, Edge(state, char_class, 0));
+    return it != edges_.begin() + node.last_edge && it->char_class == char_class ? it->to : -1;
+  }
+
+  /**
+   * \brief  Automaton transition. During build() valid for states which are already processed
+   */
+  int32_t next_state(int32_t state, uint32_t char_class) const {
+    if (is_dense_)
+      return transitions_[row(state) + char_class];
+
+    while (true) {
+      int32_t next = char_class ? find_edge(state, char_class) : -1;
+      if (next >= 0)
+        return next;
+      if (!state)
+        return 0;
+      state = nodes_[state].fail;
+    }
+  }
+
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;             // sorted by state and class after build()
+  std::unordered_map<uint64_t, int32_t> trie_edges_;  // edge index used while patterns are added
+  std::vector<size_t> patterns_;        // pattern sizes
+  std::vector<int32_t> transitions_;    // dense transition table, states x classes
+  std::vector<uint32_t> class_map_;
+  std::vector<std::pair<UnsignedChar, uint32_t> > wide_classes_;
+  std::vector<UnsignedChar> first_units_;  // distinct first code units of patterns
+  size_t classes_count_;
+  size_t max_pattern_size_;
+  bool has_empty_pattern_;
+  bool is_dense_;
+  bool is_built_;
+};
+
+#endif  // FILEREPLACE_KEY_MATCHER_H_
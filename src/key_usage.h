@@ -0,0 +1,155 @@
+#ifndef FILEREPLACE_KEY_USAGE_H_
+#define FILEREPLACE_KEY_USAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "key_matcher.h"
+#include "meta_tree.h"
+
+
+/**
+ * \brief  Finds keys of replace table which may be used for rendering of a template,
+ *         so values of other keys need not be loaded.
+ *
+ * A key is used when it occurs in the template after the first meta pass (content
+ * of blocks with false condition removed, so text around them is joined), when it
+ * occurs in the value of a used key, or when it may be formed by joining the value
+ * of a used key with adjacent text. IFSET and IFNOTSET conditions depend only on
+ * presence of keys, so they are decided without values; keys of IFCONTAINS
+ * conditions are used. The result is a superset of keys which multipass
+ * processing replaces. Keys are indexed in replace table order.
+ * The scanner keeps references to table keys, so the table must outlive it.
+ */
+template<typename TString, typename TParserParams>
+class KeyUsage {
+public:
+  typedef typename TString::value_type CharType;
+
+  KeyUsage(const std::map<TString, TString>& replace_table, bool is_meta_enabled, const TParserParams& parser_params)
+    : meta_tree_(parser_params), is_meta_enabled_(is_meta_enabled) {
+
+    for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+      i != replace_table.end();
+      i++) {
+      matcher_.add_pattern(i->first.data(), i->first.size());
+      keys_.push_back(&i->first);
+    }
+    matcher_.build();
+
+    meta_matcher_.add_pattern(parser_params.if_set_token_.data(), parser_params.if_set_token_.size());
+    meta_matcher_.add_pattern(parser_params.if_not_set_token_.data(), parser_params.if_not_set_token_.size());
+    meta_matcher_.add_pattern(parser_params.if_contains_token_.data(), parser_params.if_contains_token_.size());
+    meta_matcher_.add_pattern(parser_params.end_if_token_.data(), parser_params.end_if_token_.size());
+    meta_matcher_.build();
+  }
+
+  /**
+   * \brief  Parse meta blocks of template. Template must not be changed until it is scanned
+   * \return false on syntax error, then usage is unknown
+   */
+  bool parse_template(const TString& text) {
+    std::stringstream parse_errors;   // errors are reported by processing
+    return !is_meta_enabled_ || meta_tree_.parse(text, parse_errors);
+  }
+
+  /**
+   * \brief  Mark keys of IFCONTAINS conditions. Their values must be loaded
+   *         before the template is scanned
+   */
+  void mark_condition_keys(std::vector<bool>& used) const {
+    if (!is_meta_enabled_)
+      return;
+
+    for (size_t i = 0; i < meta_tree_.blocks_count(); i++) {
+      const MetaHeader<TString>& header = meta_tree_.block_header(i);
+      if (header.type != kMetaIfContains)
+        continue;
+
+      size_t index = find_key(header.tpl);
+      if (index < keys_.size())
+        used[index] = true;
+    }
+  }
+
+  /**
+   * \brief  Mark keys which occur in template after the first meta pass
+   * \param  text            Parsed template
+   * \param  replace_table   Table with tokens and replaces, values of condition keys are loaded
+   * \param  used [in,out]   Flags by key index
+   */
+  void scan_template(const TString& text, const std::map<TString, TString>& replace_table, std::vector<bool>& used) const {
+    int32_t state = 0;
+    if (!is_meta_enabled_ || !meta_tree_.blocks_count()) {
+      matcher_.mark_all(text.data(), text.size(), state, used);
+      return;
+    }
+
+    TString kept_text;
+    meta_tree_.render(text, replace_table, kept_text);
+    matcher_.mark_all(kept_text.data(), kept_text.size(), state, used);
+  }
+
+  /**
+   * \brief  Mark keys which occur in value of a used key, and keys which may be
+   *         formed by joining the value with adjacent text
+   * \param  value            Value of used key
+   * \param  candidates       Flags by key index, only these keys are checked for joining
+   * \param  used [in,out]    Flags by key index
+   * \return false when rendering of value cannot be predicted: it is empty, so text
+   *         around its key is joined, or it contains meta tokens. Then all keys must be used
+   */
+  bool scan_value(const TString& value, const std::vector<bool>& candidates, std::vector<bool>& used) const {
+    if (value.empty() || (is_meta_enabled_ && meta_matcher_.contains_any(value.data(), value.size())))
+      return false;
+
+    int32_t state = 0;
+    matcher_.mark_all(value.data(), value.size(), state, used);
+
+    for (size_t i = 0; i < keys_.size(); i++) {
+      if (candidates[i] && !used[i] && is_overlapped(value, *keys_[i]))
+        used[i] = true;
+    }
+
+    return true;
+  }
+
+private:
+  /**
+   * \brief  Index of key, keys are sorted as in replace table
+   * \return Key index, count of keys when not found
+   */
+  size_t find_key(const TString& key) const {
+    typename std::vector<const TString*>::const_iterator it = std::lower_bound(
+      keys_.begin(), keys_.end(), &key, [](const TString* first, const TString* second) { return *first < *second; });
+    return it != keys_.end() && **it == key ? it - keys_.begin() : keys_.size();
+  }
+
+  /**
+   * \brief  Check whether key may contain value or cross one of its ends
+   */
+  static bool is_overlapped(const TString& value, const TString& key) {
+    if (key.find(value) != TString::npos)
+      return true;
+
+    for (size_t size = 1; size < key.size() && size <= value.size(); size++) {
+      if (!value.compare(value.size() - size, size, key, 0, size) || !value.compare(0, size, key, key.size() - size, size))
+        return true;
+    }
+
+    return false;
+  }
+
+  KeyMatcher<CharType> matcher_;
+  KeyMatcher<CharType> meta_matcher_;
+  MetaTree<TString, TParserParams> meta_tree_;
+  std::vector<const TString*> keys_;
+  bool is_meta_enabled_;
+};
+
+#endif  // FILEREPLACE_KEY_USAGE_H_
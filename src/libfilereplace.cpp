@@ -0,0 +1,809 @@
+#include "libfilereplace.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "meta_tree.h"
+#include "slice_output.h"
+#include "text_encoding.h"
+#include "thread_pool.h"
+
+
+namespace {
+
+/**
+ * \brief  Replace tokens in string. 
+ * \param  text [in,out]         Text string
+ * \param  find_token            Token which must be replaced in string
+ * \param  replace_to_token      Token to replace with
+ * \param  replaces_count [out]  Actual replaces count
+ */
+template<typename TString>
+TString& replace_string(TString& text, const TString& find_token, const TString& replace_to_token, int& replaces_count) {
+  typename TString::size_type token_offset = 0;
+  typename TString::size_type copied_offset = 0;
+  TString result;
+  replaces_count = 0;
+
+  if (find_token.empty())
+    return text;
+
+  while ((token_offset = text.find(find_token, token_offset)) != TString::npos) {
+    ++replaces_count;
+    result.append(text, copied_offset, token_offset - copied_offset);
+    result.append(replace_to_token);
+    token_offset += find_token.size();
+    copied_offset = token_offset;
+  }
+
+  if (replaces_count) {
+    result.append(text, copied_offset, TString::npos);
+    text.swap(result);
+  }
+
+  return text;
+}
+
+/**
+ * \brief  Replace all table keys in text, one key after another in table order
+ * \param  text [in,out]     Text string
+ * \param  replace_table     Table with tokens and replaces
+ * \param  stats [in,out]    Counters of the current pass, may be null
+ * \return Replaces count
+ */
+template<typename TString>
+int replace_table_sequential(TString& text, const std::map<TString, TString>& replace_table, PhaseStats* stats = nullptr) {
+  const size_t kUnitSize = sizeof(typename TString::value_type);
+  int replaces_count = 0;
+  size_t index = 0;
+
+  for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+    i != replace_table.end();
+    i++, index++) {
+    int current_replaces;
+    if (stats)
+      stats->scanned_bytes += text.size() * kUnitSize;
+    replace_string(text, i->first, i->second, current_replaces);
+    replaces_count += current_replaces;
+
+    if (stats && current_replaces) {
+      stats->key_replaces.back()[index] += current_replaces;
+      stats->copied_bytes += text.size() * kUnitSize;
+    }
+  }
+
+  return replaces_count;
+}
+
+/**
+ * \brief  Replace all table keys in text with one scan when it gives the same
+ *         result as replace_table_sequential, otherwise fall back to it
+ * \param  text [in,out]     Text string
+ * \param  replace_table     Table with tokens and replaces
+ * \param  engine            Replace engine built from replace_table
+ * \param  stats [in,out]    Counters of the current pass, may be null
+ * \return Replaces count
+ */
+template<typename TString>
+int replace_table_keys(
+  TString& text,
+  const std::map<TString, TString>& replace_table,
+  const ReplaceEngine<TString>& engine,
+  PhaseStats* stats = nullptr) {
+
+  const size_t kUnitSize = sizeof(typename TString::value_type);
+  if (engine.is_single_scan()) {
+    TString result;
+    uint64_t* key_replaces = stats ? stats->key_replaces.back().data() : nullptr;
+    size_t replaces_count = engine.replace_all(text, result, key_replaces);
+    if (stats)
+      stats->scanned_bytes += text.size() * kUnitSize;
+    if (!replaces_count)
+      return 0;
+
+    // Inserted values did not produce new keys, so the sequential replace would
+    // find exactly the same occurrences. Otherwise the later keys in table order
+    // would be replaced inside the earlier values within this pass.
+    bool is_done = !engine.contains_key(result);
+    if (stats) {
+      stats->scanned_bytes += result.size() * kUnitSize;
+      stats->copied_bytes += result.size() * kUnitSize;
+    }
+
+    if (is_done) {
+      text.swap(result);
+      return static_cast<int>(replaces_count);
+    }
+
+    if (stats)
+      std::fill(stats->key_replaces.back().begin(), stats->key_replaces.back().end(), 0);
+  }
+
+  return replace_table_sequential(text, replace_table, stats);
+}
+
+
+/**
+ * \brief  Process meta blocks (IFSET, IFNOTSET, IFCONTAINS) in text
+ * \param  text [in,out]     Text string
+ * \param  meta_tree         Meta parser, reused between passes
+ * \param  replace_table     Table with tokens and replaces
+ * \param  error_text [out]  Stream for error output
+ * \param  stats [in,out]    Counters, may be null
+ */
+template<typename TString, typename TParserParams>
+bool process_meta(
+  TString& text,
+  MetaTree<TString, TParserParams>& meta_tree,
+  const std::map<TString, TString>& replace_table,
+  std::ostream& error_text,
+  PhaseStats* stats = nullptr) {
+
+  const size_t kUnitSize = sizeof(typename TString::value_type);
+  if (stats)
+    stats->scanned_bytes += text.size() * kUnitSize;
+
+  if (!meta_tree.parse(text, error_text))
+    return false;
+
+  if (meta_tree.blocks_count()) {
+    TString result;
+    meta_tree.render(text, replace_table, result);
+    text.swap(result);
+    if (stats)
+      stats->copied_bytes += text.size() * kUnitSize;
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Convert key to UTF-8 for error output
+ */
+std::string get_key_name(const std::string& key) {
+  return key;
+}
+
+std::string get_key_name(const std::u16string& key) {
+  std::string name;
+  utf16_to_utf8(key.data(), key.size(), name);
+  return name;
+}
+
+}  // namespace
+
+
+template<typename TString, typename TParserParams>
+ReplaceTable<TString, TParserParams>::ReplaceTable(
+  std::map<TString, TString> values,
+  bool is_meta_enabled,
+  const TParserParams& parser_params,
+  const PlaceholderFormat<TString>& placeholders)
+  : values_(std::move(values)),
+    is_meta_enabled_(is_meta_enabled),
+    parser_params_(parser_params),
+    placeholders_(placeholders),
+    max_placeholder_size_(0),
+    is_expanded_(false) {
+
+  if (!placeholders_.is_enabled()) {
+    engine_.reset(new ReplaceEngine<TString>(values_));
+    stream_tokens_.reset(new StreamTokens<TString, TParserParams>(values_, is_meta_enabled, parser_params_));
+    return;
+  }
+
+  // keys of placeholder form, name cannot contain close token, as the scan stops on it
+  const TString& open_token = placeholders_.open_token;
+  const TString& close_token = placeholders_.close_token;
+  size_t index = 0;
+  placeholder_index_.reserve(values_.size());
+
+  for (typename std::map<TString, TString>::const_iterator i = values_.begin(); i != values_.end(); i++, index++) {
+    const TString& key = i->first;
+    if (key.size() < open_token.size() + close_token.size()
+      || key.compare(0, open_token.size(), open_token)
+      || key.find(close_token, open_token.size()) != key.size() - close_token.size())
+      continue;
+
+    placeholder_index_[KeyView(key.data(), key.size())] = std::make_pair(&i->second, index);
+    max_placeholder_size_ = std::max(max_placeholder_size_, key.size());
+  }
+}
+
+template<typename TString, typename TParserParams>
+std::unique_ptr<ReplaceTable<TString, TParserParams> > ReplaceTable<TString, TParserParams>::create_expanded(
+  std::map<TString, TString> values,
+  bool is_meta_enabled,
+  std::ostream& error_text,
+  const TParserParams& parser_params,
+  const PlaceholderFormat<TString>& placeholders,
+  const TString* text) {
+
+  std::unique_ptr<ReplaceTable> table(new ReplaceTable(std::move(values), is_meta_enabled, parser_params, placeholders));
+  if (!table->expand_values(error_text, text))
+    return nullptr;
+
+  return table;
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::expand_values(std::ostream& error_text, const TString* text) {
+  enum KeyState {
+    kNotVisited,
+    kVisiting,        // key is on the walk path
+    kExpanded,
+    kNotExpanded      // value is kept as is and processed by rendering passes
+  };
+
+  struct PathItem {
+    size_t index;
+    size_t offset;          // scan position in value
+    bool is_expandable;
+  };
+
+  std::vector<const TString*> keys;
+  std::vector<const TString*> values;
+  for (typename std::map<TString, TString>::const_iterator i = values_.begin(); i != values_.end(); i++) {
+    keys.push_back(&i->first);
+    values.push_back(&i->second);
+  }
+
+  expanded_values_ = values_;
+  std::vector<TString*> expanded;
+  for (typename std::map<TString, TString>::iterator i = expanded_values_.begin(); i != expanded_values_.end(); i++)
+    expanded.push_back(&i->second);
+
+  // keys of template, or all keys. Keys which are not walked keep their values
+  // and are processed by rendering passes when text around meta blocks forms them
+  std::vector<size_t> roots;
+  if (text) {
+    // keys of pruned meta blocks and of meta headers are not rendered, meta blocks are
+    // processed as by the first rendering pass. Syntax errors are reported by rendering
+    TString rendered(*text);
+    if (is_meta_enabled_) {
+      MetaTree<TString, TParserParams> meta_tree(parser_params_);
+      std::stringstream meta_errors;
+      if (!process_meta(rendered, meta_tree, values_, meta_errors))
+        rendered = *text;
+    }
+
+    size_t position;
+    size_t index;
+    for (size_t offset = 0; find_reference(rendered, offset, position, index);) {
+      if (index < values.size())
+        roots.push_back(index);
+    }
+  } else {
+    for (size_t index = 0; index < values.size(); index++)
+      roots.push_back(index);
+  }
+
+  // walk is iterative, as chains of references in large tables may be long
+  std::vector<KeyState> states(values.size(), kNotVisited);
+  std::vector<PathItem> path;
+
+  for (size_t root : roots) {
+    if (states[root] != kNotVisited)
+      continue;
+
+    states[root] = kVisiting;
+    path.push_back(PathItem{ root, 0, !contains_meta_tokens(*values[root]) });
+
+    while (!path.empty()) {
+      PathItem& item = path.back();
+      size_t position;
+      size_t index;
+
+      if (find_reference(*values[item.index], item.offset, position, index)) {
+        if (index == values.size()) {
+          item.is_expandable = false;
+        } else if (states[index] == kVisiting) {
+          size_t first = path.size() - 1;
+          while (path[first].index != index)
+            --first;
+
+          error_text << "Values refer to each other in a cycle: ";
+          for (size_t i = first; i < path.size(); i++)
+            error_text << get_key_name(*keys[path[i].index]) << " -> ";
+          error_text << get_key_name(*keys[index]) << std::endl;
+          return false;
+        } else if (states[index] == kNotVisited) {
+          states[index] = kVisiting;
+          path.push_back(PathItem{ index, 0, !contains_meta_tokens(*values[index]) });
+        } else if (states[index] == kNotExpanded) {
+          item.is_expandable = false;
+        }
+        continue;
+      }
+
+      // all referred keys are walked, references are replaced by their expanded values
+      bool is_expanded = item.is_expandable;
+      const TString& value = *values[item.index];
+      TString result;
+      size_t copied = 0;
+
+      for (size_t offset = 0; is_expanded && find_reference(value, offset, position, index);) {
+        result.append(value, copied, position - copied);
+        result.append(*expanded[index]);
+        copied = offset;
+      }
+
+      if (is_expanded && copied) {
+        result.append(value, copied, TString::npos);
+
+        // tokens formed where inserted values join are left to rendering passes
+        size_t offset = 0;
+        is_expanded = !find_reference(result, offset, position, index) && !contains_meta_tokens(result);
+        if (is_expanded)
+          expanded[item.index]->swap(result);
+      }
+
+      states[item.index] = is_expanded ? kExpanded : kNotExpanded;
+
+      path.pop_back();
+      if (!is_expanded && !path.empty())
+        path.back().is_expandable = false;
+    }
+  }
+
+  // tables with overlapping keys are rendered by sequential passes, which are not
+  // equivalent to rendering with expanded values
+  if (placeholders_.is_enabled()) {
+    for (typename std::unordered_map<KeyView, PlaceholderItem>::iterator i = placeholder_index_.begin(); i != placeholder_index_.end(); i++)
+      i->second.first = expanded[i->second.second];
+  } else if (stream_tokens_->is_conflict_free()) {
+    stream_tokens_->set_values(expanded_values_);
+  } else {
+    expanded_values_.clear();
+    return true;
+  }
+
+  is_expanded_ = true;
+  return true;
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::render(
+  const CharType* text,
+  size_t size,
+  RenderSink<CharType>& sink,
+  std::ostream& error_text,
+  PhaseStats* stats) const {
+
+  TString result;
+  switch (placeholders_.is_enabled() ? kSinglePassNotApplicable : render_single_pass(text, size, sink, result, stats)) {
+  case kSinglePassDone:
+    return true;
+  case kSinglePassNextPass:
+    break;
+  default:
+    result.assign(text, size);
+    if (stats)
+      stats->copied_bytes += size * sizeof(CharType);
+  }
+
+  return render_passes(result, sink, error_text, stats);
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::render_passes(
+  TString& result,
+  RenderSink<CharType>& sink,
+  std::ostream& error_text,
+  PhaseStats* stats) const {
+
+  MetaTree<TString, TParserParams> meta_tree(parser_params_);
+
+  while (true) {   // process multiple passes
+    int current_pass_replaces = 0;
+    if (stats)
+      stats->add_pass(values_.size());
+
+    // process meta
+    if (is_meta_enabled_) {
+      PhaseTimer meta_timer(stats, kPhaseMeta);
+      if (!process_meta(result, meta_tree, values_, error_text, stats))
+        return false;
+    }
+
+    // process replace table
+    PhaseTimer replace_timer(stats, kPhaseReplace);
+    current_pass_replaces += placeholders_.is_enabled()
+      ? replace_placeholders(result, stats)
+      : replace_table_keys(result, values_, *engine_, stats);
+    replace_timer.stop();
+
+    if (stats)
+      stats->replaces_count += current_pass_replaces;
+
+    if (!current_pass_replaces)
+      break;
+  }
+
+  sink.append(result.data(), result.size());
+  sink.finish();
+  return true;
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::render(const TString& text, TString& result, std::ostream& error_text) const {
+  result.clear();
+  StringSink<TString> sink(result);
+  return render(text.data(), text.size(), sink, error_text);
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::render_parallel(
+  const CharType* text,
+  size_t size,
+  RenderSink<CharType>& sink,
+  size_t threads_count,
+  std::ostream& error_text,
+  PhaseStats* stats) const {
+
+  const size_t kChunksPerThread = 4;           // threads which are done earlier take the rest
+  const size_t kMinChunkSize = 1024 * 1024;    // in code units
+
+  if (!threads_count)
+    threads_count = std::max(1u, std::thread::hardware_concurrency());
+
+  size_t chunks_count = std::min(threads_count * kChunksPerThread, size / kMinChunkSize);
+  if (threads_count < 2 || chunks_count < 2 || placeholders_.is_enabled() || !stream_tokens_->is_conflict_free())
+    return render(text, size, sink, error_text, stats);
+
+  typedef StreamRenderer<TString, TParserParams> Renderer;
+
+  struct Chunk {
+    size_t begin;
+    size_t end;
+    std::vector<typename Renderer::OpenBlock> start_blocks;   // blocks open at chunk start
+    std::unique_ptr<Renderer> renderer;
+    std::unique_ptr<SliceSink<CharType> > output;
+    std::vector<uint64_t> key_replaces;
+    bool is_rendered;
+    bool has_tokens;     // output contains tokens for the next pass
+  };
+
+  PhaseTimer replace_timer(stats, kPhaseReplace);
+  std::vector<Chunk> chunks;
+  for (size_t i = 1, begin = 0; i <= chunks_count; i++) {
+    size_t end = i == chunks_count ? size : get_chunk_bound(text, size, size / chunks_count * i);
+    if (end <= begin)
+      continue;   // bound is moved beyond the next one
+
+    chunks.push_back(Chunk());
+    chunks.back().begin = begin;
+    chunks.back().end = end;
+    begin = end;
+  }
+
+  // render errors are reported by rendering on one thread
+  std::function<void(size_t)> render_chunk = [&](size_t index) {
+    Chunk& chunk = chunks[index];
+    chunk.renderer.reset(new Renderer(*stream_tokens_, values_, parser_params_));
+    chunk.renderer->set_open_blocks(chunk.start_blocks);
+    chunk.output.reset(new SliceSink<CharType>(text, size));
+    chunk.key_replaces.assign(stats ? values_.size() : 0, 0);
+    chunk.renderer->set_key_replaces(stats ? chunk.key_replaces.data() : nullptr);
+
+    std::stringstream render_errors;
+    size_t consumed;
+    chunk.is_rendered = index + 1 == chunks.size()
+      ? chunk.renderer->process(text + chunk.begin, chunk.end - chunk.begin, true, consumed, *chunk.output, render_errors)
+      : chunk.renderer->process_chunk(text + chunk.begin, chunk.end - chunk.begin, *chunk.output, render_errors);
+  };
+
+  WorkStealingPool pool(threads_count);
+  for (size_t i = 0; i < chunks.size(); i++)
+    pool.submit(std::bind(render_chunk, i));
+  pool.wait();
+
+  // blocks open at chunk starts are known after all chunks are rendered
+  std::vector<size_t> rerendered;
+  std::vector<typename Renderer::OpenBlock> blocks;
+  bool is_rendered = true;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    Chunk& chunk = chunks[i];
+    is_rendered = is_rendered && chunk.is_rendered;
+    if (!blocks.empty()) {
+      chunk.start_blocks = blocks;
+      rerendered.push_back(i);
+    }
+
+    blocks.resize(blocks.size() - std::min(blocks.size(), chunk.renderer->unmatched_end_ifs()));
+    std::vector<typename Renderer::OpenBlock> chunk_blocks = chunk.renderer->open_blocks();
+    blocks.insert(blocks.end(), chunk_blocks.begin(), chunk_blocks.end());
+  }
+
+  for (size_t i = 0; is_rendered && i < rerendered.size(); i++)
+    pool.submit(std::bind(render_chunk, rerendered[i]));
+  pool.wait();
+
+  size_t replaces_count = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    is_rendered = is_rendered && chunks[i].is_rendered;
+    replaces_count += chunks[i].renderer->replaces_count();
+  }
+
+  if (!is_rendered) {
+    replace_timer.stop();
+    return render(text, size, sink, error_text, stats);
+  }
+
+  // a token may start in one chunk output and end in the next ones
+  size_t max_token_size = stream_tokens_->matcher().max_pattern_size();
+  std::atomic<uint64_t> checked_bytes(0);
+  std::function<void(size_t)> check_chunk = [&](size_t index) {
+    int32_t state = 0;
+    bool has_tokens = false;
+    uint64_t checked = 0;
+
+    const std::vector<typename SliceSink<CharType>::Slice>& slices = chunks[index].output->slices();
+    for (size_t i = 0; i < slices.size() && !has_tokens; i++) {
+      has_tokens = stream_tokens_->contains_tokens(slices[i].data, slices[i].size, state);
+      checked += slices[i].size;
+    }
+
+    size_t tail_size = max_token_size ? max_token_size - 1 : 0;
+    for (size_t next = index + 1; next < chunks.size() && tail_size && !has_tokens; next++) {
+      const std::vector<typename SliceSink<CharType>::Slice>& next_slices = chunks[next].output->slices();
+      for (size_t i = 0; i < next_slices.size() && tail_size && !has_tokens; i++) {
+        size_t part_size = std::min(tail_size, next_slices[i].size);
+        has_tokens = stream_tokens_->contains_tokens(next_slices[i].data, part_size, state);
+        checked += part_size;
+        tail_size -= part_size;
+      }
+    }
+
+    chunks[index].has_tokens = has_tokens;
+    checked_bytes += checked * sizeof(CharType);
+  };
+
+  bool has_next_pass = false;
+  if (replaces_count) {
+    for (size_t i = 0; i < chunks.size(); i++)
+      pool.submit(std::bind(check_chunk, i));
+    pool.wait();
+
+    for (size_t i = 0; i < chunks.size(); i++)
+      has_next_pass = has_next_pass || chunks[i].has_tokens;
+  }
+
+  // first pass with expanded values is not the first pass of multipass rendering
+  if (has_next_pass && is_expanded_) {
+    replace_timer.stop();
+    return render(text, size, sink, error_text, stats);
+  }
+
+  if (stats) {
+    std::vector<uint64_t>& key_replaces = stats->add_pass(values_.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+      for (size_t key = 0; key < key_replaces.size(); key++)
+        key_replaces[key] += chunks[i].key_replaces[key];
+    }
+    stats->replaces_count += replaces_count;
+    stats->scanned_bytes += size * sizeof(CharType) + checked_bytes;
+  }
+
+  std::vector<const SliceSink<CharType>*> outputs;
+  for (size_t i = 0; i < chunks.size(); i++)
+    outputs.push_back(chunks[i].output.get());
+
+  if (has_next_pass) {
+    TString result;
+    for (size_t i = 0; i < outputs.size(); i++) {
+      for (size_t j = 0; j < outputs[i]->slices().size(); j++)
+        result.append(outputs[i]->slices()[j].data, outputs[i]->slices()[j].size);
+    }
+    if (stats)
+      stats->copied_bytes += result.size() * sizeof(CharType);
+    replace_timer.stop();
+    return render_passes(result, sink, error_text, stats);
+  }
+  replace_timer.stop();
+
+  sink.append_chunks(outputs);
+  sink.finish();
+  return true;
+}
+
+template<typename TString, typename TParserParams>
+size_t ReplaceTable<TString, TParserParams>::get_chunk_bound(const CharType* text, size_t size, size_t bound) const {
+  // tokens cannot overlap each other, so a token found from any position is a token of the text
+  const KeyMatcher<CharType>& matcher = stream_tokens_->matcher();
+  size_t max_token_size = matcher.max_pattern_size();
+  size_t end = std::min(size, bound + max_token_size);
+  typename KeyMatcher<CharType>::Match match;
+
+  // meta header with its condition is longer than the token, the scan starts at the line start
+  // to find headers of the line. A header with line ends may still cross the bound, then
+  // the chunk is not rendered and the text is rendered on one thread
+  size_t offset = bound > max_token_size ? bound - max_token_size : 0;
+  while (offset && text[offset - 1] != '\n')
+    offset--;
+
+  size_t keys_count = stream_tokens_->keys_count();
+  for (size_t token_end = 0; offset < end; offset = token_end) {
+    if (matcher.find(text, end, offset, true, match) != KeyMatcher<CharType>::kFound || match.position >= bound)
+      break;
+
+    token_end = match.position + match.length;
+    if (match.pattern >= keys_count && match.pattern - keys_count != StreamTokens<TString, TParserParams>::kEndIfPattern) {
+      MetaHeader<TString> header;
+      header.type = static_cast<MetaBlockType>(match.pattern - keys_count);
+      if (parse_meta_header(text, size, match.position, true, parser_params_, header) == kMetaHeaderOk)
+        token_end = match.position + header.size;
+    }
+
+    if (token_end > bound)
+      return token_end;
+  }
+
+  return bound;
+}
+
+template<typename TString, typename TParserParams>
+typename ReplaceTable<TString, TParserParams>::SinglePassResult ReplaceTable<TString, TParserParams>::render_single_pass(
+  const CharType* text,
+  size_t size,
+  RenderSink<CharType>& sink,
+  TString& next_pass_text,
+  PhaseStats* stats) const {
+
+  if (!size || !stream_tokens_->is_conflict_free())
+    return kSinglePassNotApplicable;
+
+  PhaseTimer replace_timer(stats, kPhaseReplace);
+  StreamRenderer<TString, TParserParams> renderer(*stream_tokens_, values_, parser_params_);
+
+  // counts are kept only when the pass is done
+  std::vector<uint64_t> key_replaces(stats ? values_.size() : 0);
+  renderer.set_key_replaces(stats ? key_replaces.data() : nullptr);
+
+  SliceSink<CharType> slices(text, size);
+  std::stringstream render_errors;   // errors are reported by multipass processing
+  size_t consumed;
+  if (!renderer.process(text, size, true, consumed, slices, render_errors))
+    return kSinglePassNotApplicable;
+
+  bool has_next_pass = false;
+  uint64_t checked_bytes = 0;
+  if (renderer.replaces_count()) {
+    int32_t state = 0;
+    for (size_t i = 0; i < slices.slices().size() && !has_next_pass; i++) {
+      checked_bytes += slices.slices()[i].size * sizeof(CharType);
+      has_next_pass = stream_tokens_->contains_tokens(slices.slices()[i].data, slices.slices()[i].size, state);
+    }
+  }
+
+  // first pass with expanded values is not the first pass of multipass rendering
+  if (has_next_pass && is_expanded_)
+    return kSinglePassNotApplicable;
+
+  if (stats) {
+    stats->replaces_count += renderer.replaces_count();
+    stats->scanned_bytes += size * sizeof(CharType) + checked_bytes;
+    stats->add_pass(0).swap(key_replaces);
+  }
+
+  if (has_next_pass) {
+    slices.materialize(next_pass_text);
+    if (stats)
+      stats->copied_bytes += next_pass_text.size() * sizeof(CharType);
+    return kSinglePassNextPass;
+  }
+  replace_timer.stop();
+
+  for (size_t i = 0; i < slices.slices().size(); i++)
+    sink.append(slices.slices()[i].data, slices.slices()[i].size);
+  sink.finish();
+  return kSinglePassDone;
+}
+
+template<typename TString, typename TParserParams>
+int ReplaceTable<TString, TParserParams>::replace_placeholders(TString& text, PhaseStats* stats) const {
+  TString result;
+  size_t copied = 0;
+  int replaces_count = 0;
+
+  if (stats)
+    stats->scanned_bytes += text.size() * sizeof(CharType);
+
+  size_t offset = 0;
+  size_t position;
+  while (const PlaceholderItem* item = find_placeholder(text, offset, position)) {
+    result.append(text, copied, position - copied);
+    result.append(*item->first);
+    copied = offset;
+    ++replaces_count;
+    if (stats)
+      stats->key_replaces.back()[item->second]++;
+  }
+
+  if (replaces_count) {
+    result.append(text, copied, TString::npos);
+    text.swap(result);
+    if (stats)
+      stats->copied_bytes += text.size() * sizeof(CharType);
+  }
+
+  return replaces_count;
+}
+
+
+template<typename TString, typename TParserParams>
+const typename ReplaceTable<TString, TParserParams>::PlaceholderItem* ReplaceTable<TString, TParserParams>::find_placeholder(
+  const TString& text,
+  size_t& offset,
+  size_t& position) const {
+
+  const TString& open_token = placeholders_.open_token;
+  const TString& close_token = placeholders_.close_token;
+
+  for (; (offset = text.find(open_token, offset)) != TString::npos; ++offset) {
+    // placeholder longer than any key cannot be found, so close token is searched only up to that size
+    size_t search_end = std::min(text.size(), offset + max_placeholder_size_);
+    const CharType* close = std::search(text.data() + offset + open_token.size(), text.data() + search_end,
+      close_token.begin(), close_token.end());
+    if (close == text.data() + search_end)
+      continue;
+
+    size_t end = close - text.data() + close_token.size();
+    typename std::unordered_map<KeyView, PlaceholderItem>::const_iterator item =
+      placeholder_index_.find(KeyView(text.data() + offset, end - offset));
+    if (item == placeholder_index_.end())
+      continue;
+
+    position = offset;
+    offset = end;
+    return &item->second;
+  }
+
+  offset = text.size();
+  return nullptr;
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::find_reference(
+  const TString& text,
+  size_t& offset,
+  size_t& position,
+  size_t& index) const {
+
+  if (placeholders_.is_enabled()) {
+    const PlaceholderItem* item = find_placeholder(text, offset, position);
+    if (!item)
+      return false;
+
+    index = item->second;
+    return true;
+  }
+
+  typename KeyMatcher<CharType>::Match match;
+  if (offset >= text.size()
+    || stream_tokens_->matcher().find(text.data(), text.size(), offset, true, match) != KeyMatcher<CharType>::kFound)
+    return false;
+
+  position = match.position;
+  offset = match.position + match.length;
+  index = std::min(match.pattern, values_.size());
+  return true;
+}
+
+template<typename TString, typename TParserParams>
+bool ReplaceTable<TString, TParserParams>::contains_meta_tokens(const TString& text) const {
+  return is_meta_enabled_
+    && (text.find(parser_params_.if_set_token_) != TString::npos
+      || text.find(parser_params_.if_not_set_token_) != TString::npos
+      || text.find(parser_params_.if_contains_token_) != TString::npos
+      || text.find(parser_params_.end_if_token_) != TString::npos);
+}
+
+template class ReplaceTable<std::string, ParserParamsAnsi>;
+template class ReplaceTable<std::u16string, ParserParamsUtf16>;
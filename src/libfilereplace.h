@@ -0,0 +1,356 @@
+#ifndef FILEREPLACE_LIBFILEREPLACE_H_
+#define FILEREPLACE_LIBFILEREPLACE_H_
+
+#include <stddef.h>
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "phase_stats.h"
+#include "replace_engine.h"
+#include "slice_output.h"
+#include "stream_renderer.h"
+
+
+/**
+ * Rendering engine of filereplace for embedding: a template in memory is
+ * rendered with a prebuilt replace table to a caller sink, without file I/O
+ * and with the same result as the filereplace tool. ReplaceTable is
+ * immutable, so one table may render any number of texts concurrently.
+ *
+ *   AnsiReplaceTable table(values, true);
+ *   std::string result;
+ *   std::stringstream errors;
+ *   if (!table.render(text, result, errors))
+ *     report(errors.str());
+ *
+ * ANSI/UTF-8 templates are rendered by AnsiReplaceTable, UTF-16 templates in
+ * host byte order by Utf16ReplaceTable.
+ */
+
+static const std::string kAnsiIfSetToken = "!%@IFSET[";
+static const std::string kAnsiEndIfToken = "!%@ENDIF%";
+static const std::string kAnsiBracketCloseToken = "]";
+
+static const std::u16string kUtf16IfSetToken = u"!%@IFSET[";
+static const std::u16string kUtf16EndIfToken = u"!%@ENDIF%";
+static const std::u16string kUtf16BracketCloseToken = u"]";
+
+static const std::string kAnsiIfNotSetToken = "!%@IFNOTSET[";
+static const std::u16string kUtf16IfNotSetToken = u"!%@IFNOTSET[";
+
+static const std::string kAnsiIfContainsToken = "!%@IFCONTAINS[";
+static const std::string kAnsiBracketOpenToken = "[";
+
+static const std::u16string kUtf16IfContainsToken = u"!%@IFCONTAINS[";
+static const std::u16string kUtf16BracketOpenToken = u"[";
+
+
+struct ParserParamsAnsi {
+  std::string bracket_open_token_ = kAnsiBracketOpenToken;
+  std::string bracket_close_token_ = kAnsiBracketCloseToken;
+
+  std::string if_set_token_ = kAnsiIfSetToken;
+  std::string end_if_token_ = kAnsiEndIfToken;
+
+  std::string if_not_set_token_ = kAnsiIfNotSetToken;
+  std::string if_contains_token_ = kAnsiIfContainsToken;
+};
+
+struct ParserParamsUtf16 {
+  std::u16string bracket_open_token_ = kUtf16BracketOpenToken;
+  std::u16string bracket_close_token_ = kUtf16BracketCloseToken;
+
+  std::u16string if_set_token_ = kUtf16IfSetToken;
+  std::u16string end_if_token_ = kUtf16EndIfToken;
+
+  std::u16string if_not_set_token_ = kUtf16IfNotSetToken;
+  std::u16string if_contains_token_ = kUtf16IfContainsToken;
+};
+
+
+/**
+ * \brief  Receiver of rendered text. Text is appended by pieces, which may point
+ *         to the rendered text, to table values or to buffers of the renderer.
+ *         Pieces stay valid until finish() returns, so a sink may keep pointers
+ *         instead of copying and write them all at once when rendering is done
+ */
+template<typename TChar>
+class RenderSink {
+public:
+  virtual ~RenderSink() {
+  }
+
+  virtual void append(const TChar* text, size_t size) = 0;
+
+  /**
+   * \brief  Append text rendered by chunks on several threads, chunk outputs in text order.
+   *         By default pieces of chunks are appended one by one, a sink may write the
+   *         chunks concurrently instead
+   */
+  virtual void append_chunks(const std::vector<const SliceSink<TChar>*>& chunks) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+      for (size_t j = 0; j < chunks[i]->slices().size(); j++)
+        append(chunks[i]->slices()[j].data, chunks[i]->slices()[j].size);
+    }
+  }
+
+  /**
+   * \brief  Called once after all text is appended, only when rendering succeeded
+   */
+  virtual void finish() {
+  }
+};
+
+/**
+ * \brief  Sink which appends rendered text to a string
+ */
+template<typename TString>
+class StringSink : public RenderSink<typename TString::value_type> {
+public:
+  explicit StringSink(TString& text) : text_(text) {
+  }
+
+  void append(const typename TString::value_type* text, size_t size) override {
+    text_.append(text, size);
+  }
+
+private:
+  TString& text_;
+};
+
+/**
+ * \brief  Form of placeholder keys: open token, name and close token, e.g. "!(" and ")"
+ *         for !(NAME). Empty tokens disable placeholder mode
+ */
+template<typename TString>
+struct PlaceholderFormat {
+  TString open_token;
+  TString close_token;
+
+  bool is_enabled() const {
+    return !open_token.empty() && !close_token.empty();
+  }
+};
+
+/**
+ * \brief  Replace table compiled for rendering.
+ *
+ * Keeps its own copy of values, and automatons of keys and meta tokens which
+ * are built once. All methods are const and keep no state between calls, so
+ * the table is thread-safe. Rendering is multipass, as in the filereplace tool:
+ * meta blocks and keys are processed until a pass replaces nothing.
+ *
+ * An expanded table resolves keys inside its values once, when it is built, so
+ * a template is rendered in one pass instead of rescanning the whole text for
+ * nested keys. The result is the same as of multipass rendering.
+ */
+template<typename TString, typename TParserParams>
+class ReplaceTable {
+public:
+  typedef typename TString::value_type CharType;
+
+  /**
+   * \param  values           Keys and values
+   * \param  is_meta_enabled  true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+   * \param  parser_params    Meta tokens
+   * \param  placeholders     Placeholder mode: text is searched for placeholders of this form
+   *                          only, and each one is resolved with one hash lookup, so rendering
+   *                          cost does not depend on key count. Keys of other form are not
+   *                          replaced, but are used by meta conditions
+   */
+  ReplaceTable(
+    std::map<TString, TString> values,
+    bool is_meta_enabled,
+    const TParserParams& parser_params = TParserParams(),
+    const PlaceholderFormat<TString>& placeholders = PlaceholderFormat<TString>());
+
+  ReplaceTable(const ReplaceTable&) = delete;
+  ReplaceTable& operator=(const ReplaceTable&) = delete;
+
+  /**
+   * \brief  Build expanded table: keys in values are replaced recursively by expanded
+   *         values of these keys. Values with meta blocks, and values which form new
+   *         keys where inserted values join, are left to the rendering passes
+   * \param  values           Keys and values
+   * \param  is_meta_enabled  true for enable meta-macros (IFSET, IFNOTSET, IFCONTAINS), false for disable
+   * \param  error_text [out]  Stream for error output
+   * \param  parser_params    Meta tokens
+   * \param  placeholders     Placeholder mode, disabled when tokens are empty
+   * \param  text             Template which the table is built for, nullptr for any template.
+   *                          Only keys which occur in the text left by its meta blocks, or in
+   *                          values of these keys, are expanded, so cycles of other keys are
+   *                          not reported
+   * \return Table, nullptr when values refer to each other in a cycle, the cycle is placed to error stream
+   */
+  static std::unique_ptr<ReplaceTable> create_expanded(
+    std::map<TString, TString> values,
+    bool is_meta_enabled,
+    std::ostream& error_text,
+    const TParserParams& parser_params = TParserParams(),
+    const PlaceholderFormat<TString>& placeholders = PlaceholderFormat<TString>(),
+    const TString* text = nullptr);
+
+  const std::map<TString, TString>& values() const {
+    return values_;
+  }
+
+  bool is_meta_enabled() const {
+    return is_meta_enabled_;
+  }
+
+  const TParserParams& parser_params() const {
+    return parser_params_;
+  }
+
+  const PlaceholderFormat<TString>& placeholders() const {
+    return placeholders_;
+  }
+
+  bool is_expanded() const {
+    return is_expanded_;
+  }
+
+  /**
+   * \brief  Automaton for one pass rendering of text split to windows by StreamRenderer.
+   *         Not built in placeholder mode. Values of expanded table are expanded
+   */
+  const StreamTokens<TString, TParserParams>& stream_tokens() const {
+    return *stream_tokens_;
+  }
+
+  /**
+   * \brief  Render template
+   * \param  text              Template text in host byte order
+   * \param  size              Text size in code units
+   * \param  sink              Output
+   * \param  error_text [out]  Stream for error output
+   * \param  stats [out]       Meta and replace phase measurements, may be null
+   * \return true on success, false on meta syntax error, info placed to error stream
+   */
+  bool render(const CharType* text, size_t size, RenderSink<CharType>& sink, std::ostream& error_text, PhaseStats* stats = nullptr) const;
+
+  /**
+   * \brief  Render template to string
+   * \param  text              Template text in host byte order
+   * \param  result [out]      Rendered text
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false on meta syntax error, info placed to error stream
+   */
+  bool render(const TString& text, TString& result, std::ostream& error_text) const;
+
+  /**
+   * \brief  Render large template by chunks on several threads. Text is split where no key
+   *         or meta token crosses the split, chunks are rendered in one pass concurrently,
+   *         and chunks which start inside meta blocks are rendered again with these blocks.
+   *         The result is the same as of render(), which is used when one pass rendering is
+   *         not applicable or the text is small
+   * \param  text              Template text in host byte order
+   * \param  size              Text size in code units
+   * \param  sink              Output, receives chunk outputs by append_chunks()
+   * \param  threads_count     Count of threads, 0 for count of hardware threads
+   * \param  error_text [out]  Stream for error output
+   * \param  stats [out]       Meta and replace phase measurements, may be null
+   * \return true on success, false on meta syntax error, info placed to error stream
+   */
+  bool render_parallel(
+    const CharType* text,
+    size_t size,
+    RenderSink<CharType>& sink,
+    size_t threads_count,
+    std::ostream& error_text,
+    PhaseStats* stats = nullptr) const;
+
+private:
+  enum SinglePassResult {
+    kSinglePassDone,
+    kSinglePassNextPass,       // first pass is done, text needs more passes
+    kSinglePassNotApplicable
+  };
+
+  /**
+   * \brief  Render text with one scan. Applicable only when the result is the same as
+   *         for multipass processing: keys and meta tokens cannot overlap
+   * \param  next_pass_text [out]  Text after first pass for kSinglePassNextPass
+   */
+  SinglePassResult render_single_pass(
+    const CharType* text,
+    size_t size,
+    RenderSink<CharType>& sink,
+    TString& next_pass_text,
+    PhaseStats* stats) const;
+
+  /**
+   * \brief  Render text by passes until a pass replaces nothing
+   * \param  text [in,out]  Text, is changed by passes
+   */
+  bool render_passes(TString& text, RenderSink<CharType>& sink, std::ostream& error_text, PhaseStats* stats) const;
+
+  /**
+   * \brief  Move split position of text out of a key or meta header which crosses it
+   * \return Split position, at or after bound
+   */
+  size_t get_chunk_bound(const CharType* text, size_t size, size_t bound) const;
+
+  /**
+   * \brief  Replace placeholders of table keys in text with one scan
+   * \return Replaces count
+   */
+  int replace_placeholders(TString& text, PhaseStats* stats) const;
+
+  typedef std::basic_string_view<CharType> KeyView;
+  typedef std::pair<const TString*, size_t> PlaceholderItem;   // value and key index
+
+  /**
+   * \brief  Find next placeholder of table key in text
+   * \param  offset [in,out]  Search position, set after found placeholder
+   * \param  position [out]   Placeholder position
+   * \return Item of placeholder, nullptr when text has no more placeholders
+   */
+  const PlaceholderItem* find_placeholder(const TString& text, size_t& offset, size_t& position) const;
+
+  /**
+   * \brief  Find next key which is replaced in text: placeholder in placeholder mode,
+   *         key or meta token otherwise
+   * \param  offset [in,out]  Search position, set after found token
+   * \param  position [out]   Token position
+   * \param  index [out]      Key index, keys count for meta token
+   * \return false when text has no more tokens
+   */
+  bool find_reference(const TString& text, size_t& offset, size_t& position, size_t& index) const;
+
+  /**
+   * \brief  Check whether text contains meta tokens, when meta is enabled
+   */
+  bool contains_meta_tokens(const TString& text) const;
+
+  /**
+   * \brief  Expand values with depth-first walk over references between keys
+   * \param  error_text [out]  Stream for error output
+   * \param  text             Template, walk starts from its keys, nullptr for all keys
+   * \return false on reference cycle
+   */
+  bool expand_values(std::ostream& error_text, const TString* text);
+
+  std::map<TString, TString> values_;
+  bool is_meta_enabled_;
+  TParserParams parser_params_;
+  PlaceholderFormat<TString> placeholders_;
+  std::unique_ptr<ReplaceEngine<TString> > engine_;
+  std::unique_ptr<StreamTokens<TString, TParserParams> > stream_tokens_;
+  std::unordered_map<KeyView, PlaceholderItem> placeholder_index_;
+  size_t max_placeholder_size_;
+  std::map<TString, TString> expanded_values_;   // keys of values_, used only when is_expanded_
+  bool is_expanded_;
+};
+
+typedef ReplaceTable<std::string, ParserParamsAnsi> AnsiReplaceTable;
+typedef ReplaceTable<std::u16string, ParserParamsUtf16> Utf16ReplaceTable;
+
+#endif  // FILEREPLACE_LIBFILEREPLACE_H_
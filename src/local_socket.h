@@ -0,0 +1,197 @@
+#ifndef FILEREPLACE_LOCAL_SOCKET_H_
+#define FILEREPLACE_LOCAL_SOCKET_H_
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <string>
+
+
+/**
+ * \brief  Unix domain stream socket, listening or connected.
+ *
+ * Messages are framed by 32-bit length in host byte order, as both ends run
+ * on one host. Not available on Windows.
+ */
+class LocalSocket {
+public:
+  static const size_t kMaxMessageSize = 64 * 1024 * 1024;
+
+  LocalSocket() : fd_(-1) {
+  }
+
+  explicit LocalSocket(int fd) : fd_(fd) {
+  }
+
+  ~LocalSocket() {
+    close();
+  }
+
+  LocalSocket(const LocalSocket&) = delete;
+  LocalSocket& operator=(const LocalSocket&) = delete;
+
+  int fd() const {
+    return fd_;
+  }
+
+  bool is_open() const {
+    return fd_ >= 0;
+  }
+
+  /**
+   * \brief  Create socket file and listen on it. Socket file left by a server
+   *         which is not running anymore is replaced
+   * \param  path  Socket file path
+   * \return false when the path is in use by a running server or socket cannot be created
+   */
+  bool listen(const std::string& path) {
+    close();
+
+    sockaddr_un address;
+    if (!get_address(path, address))
+      return false;
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0)
+      return false;
+
+    if (bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address))) {
+      LocalSocket probe;
+      if (errno != EADDRINUSE || probe.connect(path) || unlink(path.c_str())
+        || bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address))) {
+        close();
+        return false;
+      }
+    }
+
+    if (::listen(fd_, SOMAXCONN)) {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Connect to listening socket
+   * \param  path  Socket file path
+   */
+  bool connect(const std::string& path) {
+    close();
+
+    sockaddr_un address;
+    if (!get_address(path, address))
+      return false;
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0)
+      return false;
+
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address))) {
+      int error = errno;
+      close();
+      errno = error;
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Accept connection of listening socket
+   * \return Connection descriptor, -1 on error
+   */
+  int accept() {
+    return ::accept(fd_, nullptr, nullptr);
+  }
+
+  bool send_message(const std::string& message) {
+    if (message.size() > kMaxMessageSize)
+      return false;
+
+    uint32_t size = static_cast<uint32_t>(message.size());
+    return write_all(reinterpret_cast<const char*>(&size), sizeof(size)) && write_all(message.data(), message.size());
+  }
+
+  /**
+   * \brief  Receive message
+   * \param  message [out]  Message
+   * \return false when connection is closed by the other end, on error or on too long message
+   */
+  bool receive_message(std::string& message) {
+    uint32_t size;
+    if (!read_all(reinterpret_cast<char*>(&size), sizeof(size)) || size > kMaxMessageSize)
+      return false;
+
+    message.resize(size);
+    return read_all(&message[0], message.size());
+  }
+
+  /**
+   * \brief  Stop receiving, so receive_message returns false, while sending is still possible
+   */
+  void shutdown_receive() {
+    if (fd_ >= 0)
+      shutdown(fd_, SHUT_RD);
+  }
+
+  void close() {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+  }
+
+private:
+  static bool get_address(const std::string& path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+      return false;
+
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+  }
+
+  bool write_all(const char* data, size_t size) {
+    while (size) {
+      ssize_t written = write(fd_, data, size);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0)
+        return false;
+
+      data += written;
+      size -= static_cast<size_t>(written);
+    }
+
+    return true;
+  }
+
+  bool read_all(char* data, size_t size) {
+    while (size) {
+      ssize_t count = read(fd_, data, size);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        return false;
+
+      data += count;
+      size -= static_cast<size_t>(count);
+    }
+
+    return true;
+  }
+
+  int fd_;
+};
+
+#endif /*_WIN32*/
+
+#endif  // FILEREPLACE_LOCAL_SOCKET_H_
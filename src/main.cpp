@@ -0,0 +1,6 @@
+#include "filereplace.h"
+
+
+int main(int argc, char* argv[]) {
+  return run_command_line(argc, argv);
+}
@@ -0,0 +1,102 @@
+#ifndef FILEREPLACE_MAPPED_FILE_H_
+#define FILEREPLACE_MAPPED_FILE_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /*_WIN32*/
+
+
+/**
+ * \brief  Read-only memory mapped file.
+ *
+ * On Windows files are not mapped, open() fails and callers load the file
+ * with load_text_file, which also converts line ends in text mode.
+ */
+class MappedFile {
+public:
+  MappedFile() : data_(nullptr), size_(0), fd_(-1) {
+  }
+
+  ~MappedFile() {
+    close();
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * \brief  Map whole file to memory
+   * \param  filename  Path to file
+   * \return true on success, false when file cannot be opened or mapped, or it is empty
+   */
+  bool open(const std::string& filename) {
+    close();
+
+#ifndef _WIN32
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0)
+      return false;
+
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) || !S_ISREG(file_stat.st_mode) || !file_stat.st_size) {
+      close();
+      return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) {
+      close();
+      return false;
+    }
+
+    madvise(data, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<size_t>(file_stat.st_size);
+    return true;
+#else  /*_WIN32*/
+    (void)filename;
+    return false;
+#endif /*_WIN32*/
+  }
+
+  void close() {
+#ifndef _WIN32
+    if (data_)
+      munmap(const_cast<char*>(data_), size_);
+    if (fd_ >= 0)
+      ::close(fd_);
+#endif /*_WIN32*/
+    data_ = nullptr;
+    size_ = 0;
+    fd_ = -1;
+  }
+
+  const char* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  /**
+   * \brief  Descriptor of mapped file, valid while the file is mapped
+   */
+  int fd() const {
+    return fd_;
+  }
+
+private:
+  const char* data_;
+  size_t size_;
+  int fd_;
+};
+
+#endif  // FILEREPLACE_MAPPED_FILE_H_
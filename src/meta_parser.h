@@ -0,0 +1,141 @@
+#ifndef FILEREPLACE_META_PARSER_H_
+#define FILEREPLACE_META_PARSER_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <map>
+
+
+enum MetaBlockType {
+  kMetaIfSet,
+  kMetaIfNotSet,
+  kMetaIfContains
+};
+
+/**
+ * \brief  Arguments of meta block opening token: !%@IFSET[TPL], !%@IFNOTSET[TPL], !%@IFCONTAINS[TPL][TOKEN]
+ */
+template<typename TString>
+struct MetaHeader {
+  MetaBlockType type;
+  TString tpl;
+  TString token;
+  size_t size;   // header size from the start of opening token
+};
+
+enum MetaHeaderResult {
+  kMetaHeaderOk,
+  kMetaHeaderNeedMoreData,
+  kMetaHeaderSyntaxError
+};
+
+
+/**
+ * \brief  Meta block name for error messages
+ */
+inline const char* get_meta_block_name(MetaBlockType type) {
+  switch (type) {
+  case kMetaIfSet:
+    return "IFSET";
+  case kMetaIfNotSet:
+    return "IFNOTSET";
+  default:
+    return "IFCONTAINS";
+  }
+}
+
+/**
+ * \brief  Opening token of meta block
+ */
+template<typename TParserParams>
+const auto& get_meta_open_token(MetaBlockType type, const TParserParams& parser_params) {
+  switch (type) {
+  case kMetaIfSet:
+    return parser_params.if_set_token_;
+  case kMetaIfNotSet:
+    return parser_params.if_not_set_token_;
+  default:
+    return parser_params.if_contains_token_;
+  }
+}
+
+/**
+ * \brief  Parse meta block arguments after the opening token
+ * \param  text            Text buffer
+ * \param  size            Text size in code units
+ * \param  position        Position of the opening token
+ * \param  is_final        false when text is a window and more data may follow it
+ * \param  header [in,out] Header, type must be set by caller
+ * \return kMetaHeaderOk, kMetaHeaderSyntaxError, or kMetaHeaderNeedMoreData when
+ *         the closing bracket is not found, but more data may follow
+ */
+template<typename TString, typename TParserParams>
+MetaHeaderResult parse_meta_header(
+  const typename TString::value_type* text,
+  size_t size,
+  size_t position,
+  bool is_final,
+  const TParserParams& parser_params,
+  MetaHeader<TString>& header) {
+
+  const TString& close_token = parser_params.bracket_close_token_;
+  const TString& open_token = parser_params.bracket_open_token_;
+
+  size_t tpl_start = position + get_meta_open_token(header.type, parser_params).size();
+  const typename TString::value_type* tpl_end = std::search(text + tpl_start, text + size, close_token.begin(), close_token.end());
+  if (tpl_end == text + size)
+    return is_final ? kMetaHeaderSyntaxError : kMetaHeaderNeedMoreData;
+
+  header.tpl.assign(text + tpl_start, tpl_end);
+  header.token.clear();
+  header.size = tpl_end - text + close_token.size() - position;
+
+  if (header.type != kMetaIfContains)
+    return kMetaHeaderOk;
+
+  size_t token_start = position + header.size;
+  if (token_start + open_token.size() > size)
+    return is_final ? kMetaHeaderSyntaxError : kMetaHeaderNeedMoreData;
+
+  if (!std::equal(open_token.begin(), open_token.end(), text + token_start))
+    return kMetaHeaderSyntaxError;
+
+  token_start += open_token.size();
+  const typename TString::value_type* token_end = std::search(text + token_start, text + size, close_token.begin(), close_token.end());
+  if (token_end == text + size)
+    return is_final ? kMetaHeaderSyntaxError : kMetaHeaderNeedMoreData;
+
+  header.token.assign(text + token_start, token_end);
+  header.size = token_end - text + close_token.size() - position;
+  return kMetaHeaderOk;
+}
+
+/**
+ * \brief  Evaluate meta block condition by value of its key
+ * \param  value   Value of condition key, nullptr when key is not set
+ * \return true when block content must be left in text
+ */
+template<typename TString>
+bool is_meta_condition_true(const MetaHeader<TString>& header, const TString* value) {
+  switch (header.type) {
+  case kMetaIfSet:
+    return value != nullptr;
+  case kMetaIfNotSet:
+    return value == nullptr;
+  default:
+    return value && value->find(header.token) != TString::npos;
+  }
+}
+
+/**
+ * \brief  Evaluate meta block condition
+ * \return true when block content must be left in text
+ */
+template<typename TString>
+bool is_meta_condition_true(const MetaHeader<TString>& header, const std::map<TString, TString>& replace_table) {
+  typename std::map<TString, TString>::const_iterator template_it = replace_table.find(header.tpl);
+  return is_meta_condition_true(header, template_it == replace_table.end() ? nullptr : &template_it->second);
+}
+
+#endif  // FILEREPLACE_META_PARSER_H_
@@ -0,0 +1,172 @@
+#ifndef FILEREPLACE_META_TREE_H_
+#define FILEREPLACE_META_TREE_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "key_matcher.h"
+#include "meta_parser.h"
+
+
+/**
+ * \brief  Meta blocks of text parsed to a tree with one scan.
+ *
+ * Blocks are nested: each !%@ENDIF% closes the innermost open block, and
+ * !%@ENDIF% without open block is left as text. IFCONTAINS block without end
+ * lasts up to the end of text. Nodes are kept in text order and a block node is
+ * followed by the nodes of its content, so rendering is one walk over nodes
+ * which jumps over the content of false blocks.
+ */
+template<typename TString, typename TParserParams>
+class MetaTree {
+public:
+  typedef typename TString::value_type CharType;
+
+  explicit MetaTree(const TParserParams& parser_params) : parser_params_(parser_params) {
+    add_token(parser_params.if_set_token_);
+    add_token(parser_params.if_not_set_token_);
+    add_token(parser_params.if_contains_token_);
+    add_token(parser_params.end_if_token_);
+    matcher_.build();
+  }
+
+  /**
+   * \brief  Parse text to tree. Text must not be changed until it is rendered
+   * \param  text              Text string
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false on syntax error
+   */
+  bool parse(const TString& text, std::ostream& error_text) {
+    nodes_.clear();
+    blocks_.clear();
+
+    std::vector<size_t> open_blocks;   // innermost last
+    typename KeyMatcher<CharType>::Match match;
+    size_t offset = 0;
+    size_t line = 1;
+    size_t counted = 0;   // newlines are counted up to this position
+
+    while (matcher_.find(text.data(), text.size(), offset, true, match) == KeyMatcher<CharType>::kFound) {
+      if (match.pattern == kEndIfPattern) {
+        if (open_blocks.empty()) {
+          add_text(offset, match.position + match.length - offset);  // not opened block, left as is
+        } else {
+          add_text(offset, match.position - offset);
+          blocks_[open_blocks.back()].end = nodes_.size();
+          open_blocks.pop_back();
+        }
+        offset = match.position + match.length;
+        continue;
+      }
+
+      add_text(offset, match.position - offset);
+      line += std::count(text.data() + counted, text.data() + match.position, CharType('\n'));
+      counted = match.position;
+
+      Block block;
+      block.header.type = static_cast<MetaBlockType>(match.pattern);
+      block.line = line;
+      if (parse_meta_header(text.data(), text.size(), match.position, true, parser_params_, block.header) != kMetaHeaderOk) {
+        error_text << get_meta_block_name(block.header.type) << " macro syntax error on line " << line << std::endl;
+        return false;
+      }
+
+      Node node = { 0, 0, blocks_.size() };
+      nodes_.push_back(node);
+      open_blocks.push_back(blocks_.size());
+      blocks_.push_back(block);
+      offset = match.position + block.header.size;
+    }
+
+    add_text(offset, text.size() - offset);
+
+    for (size_t i = 0; i < open_blocks.size(); i++) {
+      Block& block = blocks_[open_blocks[i]];
+      if (block.header.type != kMetaIfContains) {  // IFCONTAINS block without end lasts up to the end of text
+        error_text << get_meta_block_name(block.header.type) << " macro end not found, syntax error on line " << block.line << std::endl;
+        return false;
+      }
+      block.end = nodes_.size();
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Count of meta blocks in parsed text
+   */
+  size_t blocks_count() const {
+    return blocks_.size();
+  }
+
+  const MetaHeader<TString>& block_header(size_t index) const {
+    return blocks_[index].header;
+  }
+
+  /**
+   * \brief  Render parsed text: keep content of blocks with true condition, remove other blocks
+   * \param  text            Parsed text
+   * \param  replace_table   Table with tokens and replaces
+   * \param  result [out]    Rendered text
+   */
+  void render(const TString& text, const std::map<TString, TString>& replace_table, TString& result) const {
+    result.clear();
+    result.reserve(text.size());
+
+    for (size_t i = 0; i < nodes_.size();) {
+      const Node& node = nodes_[i];
+      if (node.block == kNoBlock) {
+        result.append(text, node.position, node.size);
+        ++i;
+        continue;
+      }
+
+      const Block& block = blocks_[node.block];
+      i = is_meta_condition_true(block.header, replace_table) ? i + 1 : block.end;
+    }
+  }
+
+private:
+  static const size_t kEndIfPattern = 3;   // index after meta block types
+  static const size_t kNoBlock = static_cast<size_t>(-1);
+
+  struct Node {
+    size_t position;   // text span for text node
+    size_t size;
+    size_t block;      // block index for block node, kNoBlock for text node
+  };
+
+  struct Block {
+    MetaHeader<TString> header;
+    size_t line;
+    size_t end;        // index of the node after block content
+  };
+
+  void add_token(const TString& token) {
+    matcher_.add_pattern(token.data(), token.size());
+  }
+
+  void add_text(size_t position, size_t size) {
+    if (!size)
+      return;
+
+    if (!nodes_.empty() && nodes_.back().block == kNoBlock && nodes_.back().position + nodes_.back().size == position) {
+      nodes_.back().size += size;
+      return;
+    }
+
+    Node node = { position, size, kNoBlock };
+    nodes_.push_back(node);
+  }
+
+  const TParserParams& parser_params_;
+  KeyMatcher<CharType> matcher_;
+  std::vector<Node> nodes_;
+  std::vector<Block> blocks_;
+};
+
+#endif  // FILEREPLACE_META_TREE_H_
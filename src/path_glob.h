@@ -0,0 +1,82 @@
+#ifndef FILEREPLACE_PATH_GLOB_H_
+#define FILEREPLACE_PATH_GLOB_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+
+/**
+ * \brief  Match relative path with glob pattern. * matches any characters except /,
+ *         ** matches any characters including / and before / also matches no directory,
+ *         ? matches one character except /. Paths use / as separator
+ * \param  pattern       Glob pattern
+ * \param  pattern_pos   Matched part of pattern
+ * \param  text          Path
+ * \param  text_pos      Matched part of path
+ */
+inline bool match_glob(const std::string& pattern, size_t pattern_pos, const std::string& text, size_t text_pos) {
+  while (pattern_pos < pattern.size()) {
+    char c = pattern[pattern_pos];
+
+    if (c == '*') {
+      bool is_any_depth = pattern_pos + 1 < pattern.size() && pattern[pattern_pos + 1] == '*';
+      pattern_pos += is_any_depth ? 2 : 1;
+      if (is_any_depth && pattern_pos < pattern.size() && pattern[pattern_pos] == '/'
+        && match_glob(pattern, pattern_pos + 1, text, text_pos))
+        return true;
+
+      for (size_t i = text_pos; ; i++) {
+        if (match_glob(pattern, pattern_pos, text, i))
+          return true;
+        if (i == text.size() || (!is_any_depth && text[i] == '/'))
+          return false;
+      }
+    }
+
+    if (text_pos == text.size() || (c == '?' ? text[text_pos] == '/' : c != text[text_pos]))
+      return false;
+
+    ++pattern_pos;
+    ++text_pos;
+  }
+
+  return text_pos == text.size();
+}
+
+inline bool match_glob(const std::string& pattern, const std::string& text) {
+  return match_glob(pattern, 0, text, 0);
+}
+
+
+/**
+ * \brief  Selection of files by include and exclude globs. A pattern with / is
+ *         matched with the relative path, a pattern without / with the file name,
+ *         so *.inf selects files of all directories
+ */
+struct PathFilter {
+  std::vector<std::string> includes;   // empty for all files
+  std::vector<std::string> excludes;
+
+  /**
+   * \brief  Check whether file is selected: it matches an include and no exclude
+   * \param  path  Relative path with / separators
+   */
+  bool is_selected(const std::string& path) const {
+    return (includes.empty() || matches_any(includes, path)) && !matches_any(excludes, path);
+  }
+
+private:
+  static bool matches_any(const std::vector<std::string>& patterns, const std::string& path) {
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    for (size_t i = 0; i < patterns.size(); i++) {
+      if (match_glob(patterns[i], patterns[i].find('/') == std::string::npos ? name : path))
+        return true;
+    }
+
+    return false;
+  }
+};
+
+#endif  // FILEREPLACE_PATH_GLOB_H_
@@ -0,0 +1,223 @@
+#ifndef FILEREPLACE_PHASE_STATS_H_
+#define FILEREPLACE_PHASE_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else  /*_WIN32*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#endif /*_WIN32*/
+
+
+enum ProcessPhase {
+  kPhaseLoad,       // read or map template, decode
+  kPhaseValues,     // load values of replace table
+  kPhaseMeta,       // meta blocks of multipass processing
+  kPhaseReplace,    // replace table, and meta of one-scan first pass
+  kPhaseWrite,      // byte order conversion and output
+  kPhasesCount
+};
+
+/**
+ * \brief  Name of phase for reports
+ */
+inline const char* get_phase_name(ProcessPhase phase) {
+  static const char* const kNames[kPhasesCount] = { "load", "values", "meta", "replace", "write" };
+  return kNames[phase];
+}
+
+/**
+ * \brief  Peak resident memory of the process in bytes, 0 when unknown.
+ *         On Linux the peak is reset by reset_peak_memory, so it is the peak since the reset
+ */
+inline size_t get_peak_memory() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+  FILE* status = fopen("/proc/self/status", "r");
+  if (!status)
+    return 0;
+
+  char line[256];
+  size_t peak_kb = 0;
+  while (fgets(line, sizeof(line), status)) {
+    if (!strncmp(line, "VmHWM:", 6)) {
+      peak_kb = strtoul(line + 6, nullptr, 10);
+      break;
+    }
+  }
+  fclose(status);
+  return peak_kb * 1024;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;   // bytes
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+#endif /*_WIN32*/
+}
+
+/**
+ * \brief  Start a new peak memory measurement. Supported on Linux only,
+ *         elsewhere peaks are process-wide and never decrease
+ */
+inline void reset_peak_memory() {
+#ifdef __linux__
+  FILE* clear_refs = fopen("/proc/self/clear_refs", "w");
+  if (clear_refs) {
+    fputs("5", clear_refs);
+    fclose(clear_refs);
+  }
+#endif /*__linux__*/
+}
+
+/**
+ * \brief  Wall time, peak memory and counters of processing phases of one file
+ */
+struct PhaseStats {
+  double seconds[kPhasesCount] = {};
+  size_t peak_memory[kPhasesCount] = {};   // bytes
+  uint64_t replaces_count = 0;
+  size_t passes_count = 0;
+  uint64_t scanned_bytes = 0;    // text scanned for keys and meta tokens
+  uint64_t copied_bytes = 0;     // text read or copied to new buffers
+  bool is_cache_hit = false;     // output was up to date, nothing was processed
+  std::vector<std::vector<uint64_t> > key_replaces;   // by pass, then by key index in table order
+
+  /**
+   * \brief  Start next pass
+   * \return Replaces count by key index for the pass
+   */
+  std::vector<uint64_t>& add_pass(size_t keys_count) {
+    passes_count++;
+    key_replaces.emplace_back(keys_count);
+    return key_replaces.back();
+  }
+};
+
+/**
+ * \brief  Measures one phase from construction to stop() or destruction.
+ *         Does nothing without stats, so processing may be measured on demand
+ */
+class PhaseTimer {
+public:
+  PhaseTimer(PhaseStats* stats, ProcessPhase phase) : stats_(stats), phase_(phase) {
+    if (stats_) {
+      reset_peak_memory();
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~PhaseTimer() {
+    stop();
+  }
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  void stop() {
+    if (!stats_)
+      return;
+
+    stats_->seconds[phase_] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    size_t peak_memory = get_peak_memory();
+    if (peak_memory > stats_->peak_memory[phase_])
+      stats_->peak_memory[phase_] = peak_memory;
+    stats_ = nullptr;
+  }
+
+private:
+  PhaseStats* stats_;
+  ProcessPhase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * \brief  Write string as JSON string literal
+ */
+inline void write_json_string(std::ostream& out, const std::string& text) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  out << '"';
+  for (size_t i = 0; i < text.size(); i++) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (c < 0x20)
+      out << "\\u00" << kHexDigits[c >> 4] << kHexDigits[c & 0xF];
+    else
+      out << c;
+  }
+  out << '"';
+}
+
+/**
+ * \brief  Write stats as JSON object. Keys without replaces are omitted
+ * \param  out        Output stream
+ * \param  stats      Stats of processing
+ * \param  key_names  UTF-8 names of keys by index in table order
+ */
+inline void write_stats_json(std::ostream& out, const PhaseStats& stats, const std::vector<std::string>& key_names) {
+  size_t peak_memory = 0;
+  for (int phase = 0; phase < kPhasesCount; phase++)
+    peak_memory = std::max(peak_memory, stats.peak_memory[phase]);
+
+  out << "{\n";
+  out << "  \"cache_hit\": " << (stats.is_cache_hit ? "true" : "false") << ",\n";
+  out << "  \"passes\": " << stats.passes_count << ",\n";
+  out << "  \"replacements\": " << stats.replaces_count << ",\n";
+  out << "  \"bytes_scanned\": " << stats.scanned_bytes << ",\n";
+  out << "  \"bytes_copied\": " << stats.copied_bytes << ",\n";
+  out << "  \"peak_memory\": " << peak_memory << ",\n";
+
+  out << "  \"phases\": {\n";
+  for (int phase = 0; phase < kPhasesCount; phase++) {
+    out << "    \"" << get_phase_name(static_cast<ProcessPhase>(phase)) << "\": { \"seconds\": " << stats.seconds[phase]
+      << ", \"peak_memory\": " << stats.peak_memory[phase] << " }" << (phase + 1 < kPhasesCount ? "," : "") << "\n";
+  }
+  out << "  },\n";
+
+  // replaces of each key by pass
+  out << "  \"keys\": {";
+  bool is_first = true;
+  for (size_t key = 0; key < key_names.size(); key++) {
+    uint64_t total = 0;
+    for (size_t pass = 0; pass < stats.key_replaces.size(); pass++)
+      total += key < stats.key_replaces[pass].size() ? stats.key_replaces[pass][key] : 0;
+    if (!total)
+      continue;
+
+    out << (is_first ? "\n    " : ",\n    ");
+    write_json_string(out, key_names[key]);
+    out << ": [";
+    for (size_t pass = 0; pass < stats.key_replaces.size(); pass++)
+      out << (pass ? ", " : "") << (key < stats.key_replaces[pass].size() ? stats.key_replaces[pass][key] : 0);
+    out << "]";
+    is_first = false;
+  }
+  out << (is_first ? "}\n" : "\n  }\n");
+  out << "}\n";
+}
+
+#endif  // FILEREPLACE_PHASE_STATS_H_
@@ -0,0 +1,134 @@
+#ifndef FILEREPLACE_RENDER_CACHE_H_
+#define FILEREPLACE_RENDER_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <system_error>
+
+#include "content_hash.h"
+#include "slice_output.h"
+
+
+/**
+ * \brief  On-disk cache of rendered outputs.
+ *
+ * A render is addressed by the hash of everything which defines its result:
+ * template bytes, effective replace table and flags. For each output file the
+ * cache keeps the render key and the size and modification time of the output
+ * written for it. When the key is the same and the output was not changed
+ * since, rendering is skipped. Entries are written through a temporary file,
+ * so the cache may be shared by parallel processes. Thread-safe.
+ */
+class RenderCache {
+public:
+  explicit RenderCache(const std::string& directory) : directory_(directory), hits_(0), misses_(0) {
+  }
+
+  /**
+   * \brief  Create cache directory
+   * \return true on success
+   */
+  bool open() {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    return std::filesystem::is_directory(directory_, error);
+  }
+
+  /**
+   * \brief  Check whether output file was rendered with this key and was not changed since
+   * \param  key            Render key
+   * \param  out_filename   Absolute output file path
+   */
+  bool lookup(uint64_t key, const std::string& out_filename) {
+    uint64_t out_size;
+    int64_t out_time;
+    bool is_hit = false;
+
+    std::ifstream entry(get_entry_filename(out_filename));
+    std::string entry_key;
+    uint64_t entry_size;
+    int64_t entry_time;
+    std::string entry_filename;
+
+    if (entry >> entry_key >> entry_size >> entry_time && entry.get() == ' ' && std::getline(entry, entry_filename))
+      is_hit = entry_key == ContentHash::to_hex(key) && entry_filename == out_filename
+        && get_file_state(out_filename, out_size, out_time) && out_size == entry_size && out_time == entry_time;
+
+    ++(is_hit ? hits_ : misses_);
+    return is_hit;
+  }
+
+  /**
+   * \brief  Remember that output file is rendered with this key. Errors are
+   *         ignored, the output is rendered again next time
+   * \param  key            Render key
+   * \param  out_filename   Absolute output file path
+   */
+  void store(uint64_t key, const std::string& out_filename) {
+    uint64_t out_size;
+    int64_t out_time;
+    if (!get_file_state(out_filename, out_size, out_time))
+      return;
+
+    std::string entry_filename = get_entry_filename(out_filename);
+    std::string temp_filename = entry_filename + "." + ContentHash::to_hex(key) + ".tmp";
+    {
+      std::ofstream entry(temp_filename, std::ios::binary | std::ios::trunc);
+      entry << ContentHash::to_hex(key) << ' ' << out_size << ' ' << out_time << ' ' << out_filename << '\n';
+      if (!entry.flush()) {
+        entry.close();
+        remove(temp_filename.c_str());
+        return;
+      }
+    }
+
+    if (!OutputFile::replace_file(temp_filename, entry_filename))
+      remove(temp_filename.c_str());
+  }
+
+  size_t hits() const {
+    return hits_;
+  }
+
+  size_t misses() const {
+    return misses_;
+  }
+
+  /**
+   * \brief  Print cache hit statistics
+   */
+  void print_stats(std::ostream& out) const {
+    size_t lookups = hits_ + misses_;
+    out << "Render cache: " << hits_ << " hits, " << misses_ << " misses, hit rate "
+      << (lookups ? hits_ * 100 / lookups : 0) << "%" << std::endl;
+  }
+
+private:
+  std::string get_entry_filename(const std::string& out_filename) const {
+    ContentHash hash;
+    hash.update_string(out_filename);
+    return (std::filesystem::path(directory_) / ContentHash::to_hex(hash.digest())).string();
+  }
+
+  static bool get_file_state(const std::string& filename, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    size = std::filesystem::file_size(filename, error);
+    if (error)
+      return false;
+
+    time = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+    return !error;
+  }
+
+  std::string directory_;
+  std::atomic<size_t> hits_;
+  std::atomic<size_t> misses_;
+};
+
+#endif  // FILEREPLACE_RENDER_CACHE_H_
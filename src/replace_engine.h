@@ -0,0 +1,110 @@
+#ifndef FILEREPLACE_REPLACE_ENGINE_H_
+#define FILEREPLACE_REPLACE_ENGINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "key_matcher.h"
+
+
+/**
+ * \brief  Replace table compiled to a multi-pattern matcher.
+ *
+ * Replaces all table keys in one scan of the text instead of one scan per key.
+ * Pattern indexes follow the replace table iteration order.
+ * The engine keeps references to table values, so the table must outlive it.
+ */
+template<typename TString>
+class ReplaceEngine {
+public:
+  typedef typename TString::value_type CharType;
+  typedef KeyMatcher<CharType> Matcher;
+
+  explicit ReplaceEngine(const std::map<TString, TString>& replace_table) {
+    values_.reserve(replace_table.size());
+    for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+      i != replace_table.end();
+      i++) {
+      matcher_.add_pattern(i->first.data(), i->first.size());
+      values_.push_back(&i->second);
+    }
+
+    matcher_.build();
+    is_single_scan_ = matcher_.is_conflict_free();
+  }
+
+  /**
+   * \brief  Check that one scan gives the same result as replacing keys one by one in table order.
+   *         It is true when key occurrences can never overlap each other
+   */
+  bool is_single_scan() const {
+    return is_single_scan_;
+  }
+
+  const Matcher& matcher() const {
+    return matcher_;
+  }
+
+  const TString& value(size_t index) const {
+    return *values_[index];
+  }
+
+  /**
+   * \brief  Replace all keys in text in one scan
+   * \param  text          Source text
+   * \param  result [out]  Text with replaced keys, not changed when nothing was replaced
+   * \param  key_replaces [in,out]  Replaces count by key index is increased, may be null
+   * \return Replaces count
+   */
+  size_t replace_all(const TString& text, TString& result, uint64_t* key_replaces = nullptr) const {
+    std::vector<typename Matcher::Match> matches;
+    typename Matcher::Match match;
+    size_t result_size = text.size();
+
+    for (size_t offset = 0; offset < text.size(); offset = match.position + match.length) {
+      if (matcher_.find(text.data(), text.size(), offset, true, match) != Matcher::kFound)
+        break;
+
+      matches.push_back(match);
+      if (key_replaces)
+        key_replaces[match.pattern]++;
+      result_size = result_size - match.length + values_[match.pattern]->size();
+    }
+
+    if (matches.empty())
+      return 0;
+
+    result.resize(result_size);
+    CharType* out = &result[0];
+    const CharType* in = text.data();
+    size_t offset = 0;
+
+    for (size_t i = 0; i < matches.size(); i++) {
+      const TString& value = *values_[matches[i].pattern];
+      out = std::copy(in + offset, in + matches[i].position, out);
+      out = std::copy(value.begin(), value.end(), out);
+      offset = matches[i].position + matches[i].length;
+    }
+
+    std::copy(in + offset, in + text.size(), out);
+    return matches.size();
+  }
+
+  /**
+   * \brief  Check whether text contains any key
+   */
+  bool contains_key(const TString& text) const {
+    return matcher_.contains_any(text.data(), text.size());
+  }
+
+private:
+  Matcher matcher_;
+  std::vector<const TString*> values_;
+  bool is_single_scan_;
+};
+
+#endif  // FILEREPLACE_REPLACE_ENGINE_H_
@@ -0,0 +1,386 @@
+#include "scan_kernels.h"
+
+#include <string.h>
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FILEREPLACE_SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif /*_MSC_VER*/
+#endif
+
+#if defined(FILEREPLACE_SCAN_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FILEREPLACE_SCAN_SSE2
+#endif
+
+// functions with wider instruction sets are compiled for them and are called only after CPU check
+#if defined(FILEREPLACE_SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FILEREPLACE_SCAN_AVX
+#define FILEREPLACE_TARGET_AVX2 __attribute__((target("avx2")))
+#define FILEREPLACE_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#elif defined(FILEREPLACE_SCAN_X86) && defined(_MSC_VER)
+#define FILEREPLACE_SCAN_AVX
+#define FILEREPLACE_TARGET_AVX2
+#define FILEREPLACE_TARGET_AVX512
+#endif
+
+
+namespace {
+
+typedef size_t (*ScanFunction8)(const uint8_t*, size_t, const uint8_t*, size_t);
+typedef size_t (*ScanFunction16)(const uint16_t*, size_t, const uint16_t*, size_t);
+
+template<typename TUnit>
+size_t scan_scalar(const TUnit* text, size_t size, const TUnit* units, size_t units_count) {
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < units_count; j++) {
+      if (text[i] == units[j])
+        return i;
+    }
+  }
+
+  return size;
+}
+
+#if defined(FILEREPLACE_SCAN_SSE2) || defined(FILEREPLACE_SCAN_AVX)
+inline unsigned count_trailing_zeros(uint64_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+#ifdef _M_X64
+  _BitScanForward64(&index, mask);
+#else  /*_M_X64*/
+  if (!_BitScanForward(&index, static_cast<unsigned long>(mask))) {
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    index += 32;
+  }
+#endif /*_M_X64*/
+  return index;
+#else  /*_MSC_VER*/
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif /*_MSC_VER*/
+}
+#endif
+
+/**
+ * Kernels compare a block of text with every unit and join results. Count of
+ * units is a template argument, so the compare loop is unrolled.
+ */
+
+#ifdef FILEREPLACE_SCAN_SSE2
+template<size_t kCount>
+size_t scan_sse2_8(const uint8_t* text, size_t size, const uint8_t* units) {
+  __m128i needles[kCount];
+  for (size_t j = 0; j < kCount; j++)
+    needles[j] = _mm_set1_epi8(static_cast<char>(units[j]));
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+    for (size_t j = 1; j < kCount; j++)
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[j]));
+
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if (mask)
+      return i + count_trailing_zeros(mask);
+  }
+
+  return i + scan_scalar(text + i, size - i, units, kCount);
+}
+
+template<size_t kCount>
+size_t scan_sse2_16(const uint16_t* text, size_t size, const uint16_t* units) {
+  __m128i needles[kCount];
+  for (size_t j = 0; j < kCount; j++)
+    needles[j] = _mm_set1_epi16(static_cast<short>(units[j]));
+
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i hits = _mm_cmpeq_epi16(block, needles[0]);
+    for (size_t j = 1; j < kCount; j++)
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi16(block, needles[j]));
+
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if (mask)
+      return i + count_trailing_zeros(mask) / 2;
+  }
+
+  return i + scan_scalar(text + i, size - i, units, kCount);
+}
+#endif /*FILEREPLACE_SCAN_SSE2*/
+
+#ifdef FILEREPLACE_SCAN_AVX
+template<size_t kCount>
+FILEREPLACE_TARGET_AVX2 size_t scan_avx2_8(const uint8_t* text, size_t size, const uint8_t* units) {
+  __m256i needles[kCount];
+  for (size_t j = 0; j < kCount; j++)
+    needles[j] = _mm256_set1_epi8(static_cast<char>(units[j]));
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+    __m256i hits = _mm256_cmpeq_epi8(block, needles[0]);
+    for (size_t j = 1; j < kCount; j++)
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[j]));
+
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if (mask)
+      return i + count_trailing_zeros(mask);
+  }
+
+  return i + scan_scalar(text + i, size - i, units, kCount);
+}
+
+template<size_t kCount>
+FILEREPLACE_TARGET_AVX2 size_t scan_avx2_16(const uint16_t* text, size_t size, const uint16_t* units) {
+  __m256i needles[kCount];
+  for (size_t j = 0; j < kCount; j++)
+    needles[j] = _mm256_set1_epi16(static_cast<short>(units[j]));
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+    __m256i hits = _mm256_cmpeq_epi16(block, needles[0]);
+    for (size_t j = 1; j < kCount; j++)
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi16(block, needles[j]));
+
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if (mask)
+      return i + count_trailing_zeros(mask) / 2;
+  }
+
+  return i + scan_scalar(text + i, size - i, units, kCount);
+}
+
+template<size_t kCount>
+FILEREPLACE_TARGET_AVX512 size_t scan_avx512_8(const uint8_t* text, size_t size, const uint8_t* units) {
+  __m512i needles[kCount];
+  for (size_t j = 0; j < kCount; j++)
+    needles[j] = _mm512_set1_epi8(static_cast<char>(units[j]));
+
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    __m512i block = _mm512_loadu_si512(text + i);
+    __mmask64 mask = _mm512_cmpeq_epi8_mask(block, needles[0]);
+    for (size_t j = 1; j < kCount; j++)
+      mask |= _mm512_cmpeq_epi8_mask(block, needles[j]);
+
+    if (mask)
+      return i + count_trailing_zeros(mask);
+  }
+
+  return i + scan_scalar(text + i, size - i, units, kCount);
+}
+
+template<size_t kCount>
+FILEREPLACE_TARGET_AVX512 size_t scan_avx512_16(const uint16_t* text, size_t size, const uint16_t* units) {
+  __m512i needles[kCount];
+  for (size_t j = 0; j < kCount; j++)
+    needles[j] = _mm512_set1_epi16(static_cast<short>(units[j]));
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m512i block = _mm512_loadu_si512(text + i);
+    __mmask32 mask = _mm512_cmpeq_epi16_mask(block, needles[0]);
+    for (size_t j = 1; j < kCount; j++)
+      mask |= _mm512_cmpeq_epi16_mask(block, needles[j]);
+
+    if (mask)
+      return i + count_trailing_zeros(mask);
+  }
+
+  return i + scan_scalar(text + i, size - i, units, kCount);
+}
+#endif /*FILEREPLACE_SCAN_AVX*/
+
+/**
+ * Dispatch by count of units to unrolled kernel
+ */
+#define FILEREPLACE_SCAN_FUNCTION(name, kernel, TUnit)                                              \
+  size_t name(const TUnit* text, size_t size, const TUnit* units, size_t units_count) {             \
+    switch (units_count) {                                                                          \
+    case 1: return kernel<1>(text, size, units);                                                    \
+    case 2: return kernel<2>(text, size, units);                                                    \
+    case 3: return kernel<3>(text, size, units);                                                    \
+    case 4: return kernel<4>(text, size, units);                                                    \
+    case 5: return kernel<5>(text, size, units);                                                    \
+    case 6: return kernel<6>(text, size, units);                                                    \
+    case 7: return kernel<7>(text, size, units);                                                    \
+    case 8: return kernel<8>(text, size, units);                                                    \
+    default: return scan_scalar(text, size, units, units_count);                                    \
+    }                                                                                               \
+  }
+
+#ifdef FILEREPLACE_SCAN_SSE2
+FILEREPLACE_SCAN_FUNCTION(scan_sse2_units_8, scan_sse2_8, uint8_t)
+FILEREPLACE_SCAN_FUNCTION(scan_sse2_units_16, scan_sse2_16, uint16_t)
+#endif /*FILEREPLACE_SCAN_SSE2*/
+
+#ifdef FILEREPLACE_SCAN_AVX
+FILEREPLACE_SCAN_FUNCTION(scan_avx2_units_8, scan_avx2_8, uint8_t)
+FILEREPLACE_SCAN_FUNCTION(scan_avx2_units_16, scan_avx2_16, uint16_t)
+FILEREPLACE_SCAN_FUNCTION(scan_avx512_units_8, scan_avx512_8, uint8_t)
+FILEREPLACE_SCAN_FUNCTION(scan_avx512_units_16, scan_avx512_16, uint16_t)
+#endif /*FILEREPLACE_SCAN_AVX*/
+
+#undef FILEREPLACE_SCAN_FUNCTION
+
+size_t scan_scalar_units_8(const uint8_t* text, size_t size, const uint8_t* units, size_t units_count) {
+  if (units_count == 1) {
+    const void* found = memchr(text, units[0], size);
+    return found ? static_cast<const uint8_t*>(found) - text : size;
+  }
+
+  return scan_scalar(text, size, units, units_count);
+}
+
+size_t scan_scalar_units_16(const uint16_t* text, size_t size, const uint16_t* units, size_t units_count) {
+  return scan_scalar(text, size, units, units_count);
+}
+
+/**
+ * \brief  Check CPU and OS support of instruction set
+ */
+bool is_cpu_supported(ScanKernel kernel) {
+  switch (kernel) {
+  case kScanKernelScalar:
+    return true;
+  case kScanKernelSse2:
+#ifdef FILEREPLACE_SCAN_SSE2
+    return true;
+#else  /*FILEREPLACE_SCAN_SSE2*/
+    return false;
+#endif /*FILEREPLACE_SCAN_SSE2*/
+  default:
+    break;
+  }
+
+#if defined(FILEREPLACE_SCAN_AVX) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  __cpuid(info, 1);
+  const int kOsXsaveBit = 1 << 27;
+  if (!(info[2] & kOsXsaveBit))
+    return false;
+
+  unsigned long long enabled_state = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+
+  const int kAvx2Bit = 1 << 5;
+  const int kAvx512FBit = 1 << 16;
+  const int kAvx512BwBit = 1 << 30;
+  if (kernel == kScanKernelAvx2)
+    return (enabled_state & 0x6) == 0x6 && (info[1] & kAvx2Bit);
+
+  return (enabled_state & 0xE6) == 0xE6 && (info[1] & kAvx512FBit) && (info[1] & kAvx512BwBit);
+#elif defined(FILEREPLACE_SCAN_AVX)
+  __builtin_cpu_init();
+  if (kernel == kScanKernelAvx2)
+    return __builtin_cpu_supports("avx2");
+
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#else
+  return false;
+#endif
+}
+
+struct ScanFunctions {
+  ScanKernel kernel;
+  ScanFunction8 scan8;
+  ScanFunction16 scan16;
+};
+
+ScanFunctions get_scan_functions(ScanKernel kernel) {
+  ScanFunctions functions = { kScanKernelScalar, scan_scalar_units_8, scan_scalar_units_16 };
+  switch (kernel) {
+#ifdef FILEREPLACE_SCAN_SSE2
+  case kScanKernelSse2:
+    functions.kernel = kernel;
+    functions.scan8 = scan_sse2_units_8;
+    functions.scan16 = scan_sse2_units_16;
+    break;
+#endif /*FILEREPLACE_SCAN_SSE2*/
+#ifdef FILEREPLACE_SCAN_AVX
+  case kScanKernelAvx2:
+    functions.kernel = kernel;
+    functions.scan8 = scan_avx2_units_8;
+    functions.scan16 = scan_avx2_units_16;
+    break;
+  case kScanKernelAvx512:
+    functions.kernel = kernel;
+    functions.scan8 = scan_avx512_units_8;
+    functions.scan16 = scan_avx512_units_16;
+    break;
+#endif /*FILEREPLACE_SCAN_AVX*/
+  default:
+    break;
+  }
+
+  return functions;
+}
+
+ScanKernel get_best_kernel() {
+  for (int kernel = kScanKernelsCount - 1; kernel > kScanKernelScalar; kernel--) {
+    if (is_cpu_supported(static_cast<ScanKernel>(kernel)))
+      return static_cast<ScanKernel>(kernel);
+  }
+
+  return kScanKernelScalar;
+}
+
+std::atomic<ScanKernel> g_kernel(get_best_kernel());
+std::atomic<ScanFunction8> g_scan8(get_scan_functions(g_kernel).scan8);
+std::atomic<ScanFunction16> g_scan16(get_scan_functions(g_kernel).scan16);
+
+}  // namespace
+
+
+size_t scan_units(const uint8_t* text, size_t size, const uint8_t* units, size_t units_count) {
+  return g_scan8.load(std::memory_order_relaxed)(text, size, units, units_count);
+}
+
+size_t scan_units(const uint16_t* text, size_t size, const uint16_t* units, size_t units_count) {
+  return g_scan16.load(std::memory_order_relaxed)(text, size, units, units_count);
+}
+
+ScanKernel get_scan_kernel() {
+  return g_kernel;
+}
+
+bool set_scan_kernel(ScanKernel kernel) {
+  if (!is_scan_kernel_supported(kernel))
+    return false;
+
+  ScanFunctions functions = get_scan_functions(kernel);
+  g_scan8 = functions.scan8;
+  g_scan16 = functions.scan16;
+  g_kernel = functions.kernel;
+  return true;
+}
+
+bool is_scan_kernel_supported(ScanKernel kernel) {
+  return kernel >= kScanKernelScalar && kernel < kScanKernelsCount
+    && is_cpu_supported(kernel) && get_scan_functions(kernel).kernel == kernel;
+}
+
+const char* get_scan_kernel_name(ScanKernel kernel) {
+  switch (kernel) {
+  case kScanKernelScalar:
+    return "scalar";
+  case kScanKernelSse2:
+    return "sse2";
+  case kScanKernelAvx2:
+    return "avx2";
+  case kScanKernelAvx512:
+    return "avx512";
+  default:
+    return "unknown";
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef FILEREPLACE_SCAN_KERNELS_H_
+#define FILEREPLACE_SCAN_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * Vectorized search of the first code unit which belongs to a small set of
+ * units: the first units of keys and meta tokens. Matchers skip the text
+ * between such candidate positions without running the automaton.
+ *
+ * Kernel is selected once at runtime by CPU features: AVX-512 (BW), AVX2,
+ * SSE2 (baseline on x86-64) or scalar.
+ */
+
+enum ScanKernel {
+  kScanKernelScalar,
+  kScanKernelSse2,
+  kScanKernelAvx2,
+  kScanKernelAvx512,
+  kScanKernelsCount
+};
+
+static const size_t kMaxScanUnits = 8;   // larger sets are not scanned
+
+
+/**
+ * \brief  Find the first code unit which is one of units
+ * \param  text          Text buffer
+ * \param  size          Text size in code units
+ * \param  units         Units to find, at most kMaxScanUnits
+ * \param  units_count   Count of units, at least 1
+ * \return Position of the found unit, size when not found
+ */
+size_t scan_units(const uint8_t* text, size_t size, const uint8_t* units, size_t units_count);
+size_t scan_units(const uint16_t* text, size_t size, const uint16_t* units, size_t units_count);
+
+/**
+ * \brief  Kernel used by scan_units
+ */
+ScanKernel get_scan_kernel();
+
+/**
+ * \brief  Select kernel for scan_units, used by benchmarks and tests
+ * \return false when kernel is not supported by CPU, the kernel is not changed
+ */
+bool set_scan_kernel(ScanKernel kernel);
+
+bool is_scan_kernel_supported(ScanKernel kernel);
+
+const char* get_scan_kernel_name(ScanKernel kernel);
+
+#endif  // FILEREPLACE_SCAN_KERNELS_H_
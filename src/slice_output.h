@@ -0,0 +1,521 @@
+#ifndef FILEREPLACE_SLICE_OUTPUT_H_
+#define FILEREPLACE_SLICE_OUTPUT_H_
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <io.h>
+#include <windows.h>
+#else  /*_WIN32*/
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif /*__linux__*/
+#endif /*_WIN32*/
+
+
+/**
+ * \brief  Output text kept as a list of slices: unchanged spans of the source
+ *         text and inserted values. Nothing is copied until the text is written,
+ *         except short pieces, which are gathered to buffers, so writing is not
+ *         slowed down by a lot of tiny slices
+ */
+template<typename TChar>
+class SliceSink {
+public:
+  struct Slice {
+    const TChar* data;
+    size_t size;
+    bool is_source;
+  };
+
+  SliceSink(const TChar* source, size_t source_size) : source_(source), source_size_(source_size), size_(0), buffer_used_(0) {
+  }
+
+  void append(const TChar* text, size_t size) {
+    if (!size)
+      return;
+
+    if (size < kMinSliceSize) {
+      append_copy(text, size);
+      return;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(text);
+    uintptr_t source_address = reinterpret_cast<uintptr_t>(source_);
+    bool is_source = address >= source_address && address + size * sizeof(TChar) <= source_address + source_size_ * sizeof(TChar);
+
+    if (is_source && !slices_.empty() && slices_.back().is_source && slices_.back().data + slices_.back().size == text) {
+      slices_.back().size += size;
+    } else {
+      Slice slice = { text, size, is_source };
+      slices_.push_back(slice);
+    }
+
+    size_ += size;
+  }
+
+  const std::vector<Slice>& slices() const {
+    return slices_;
+  }
+
+  /**
+   * \brief  Output size in code units
+   */
+  size_t size() const {
+    return size_;
+  }
+
+  template<typename TString>
+  void materialize(TString& text) const {
+    text.clear();
+    text.reserve(size_);
+    for (size_t i = 0; i < slices_.size(); i++)
+      text.append(slices_[i].data, slices_[i].size);
+  }
+
+private:
+  static const size_t kMinSliceSize = 256;     // shorter pieces are copied
+  static const size_t kBufferSize = 64 * 1024;
+
+  void append_copy(const TChar* text, size_t size) {
+    if (buffers_.empty() || buffer_used_ + size > kBufferSize) {
+      buffers_.push_back(std::unique_ptr<TChar[]>(new TChar[kBufferSize]));
+      buffer_used_ = 0;
+    }
+
+    TChar* target = buffers_.back().get() + buffer_used_;
+    std::copy(text, text + size, target);
+    buffer_used_ += size;
+    size_ += size;
+
+    if (!slices_.empty() && !slices_.back().is_source && slices_.back().data + slices_.back().size == target) {
+      slices_.back().size += size;
+    } else {
+      Slice slice = { target, size, false };
+      slices_.push_back(slice);
+    }
+  }
+
+  const TChar* source_;
+  size_t source_size_;
+  size_t size_;
+  std::vector<Slice> slices_;
+  std::vector<std::unique_ptr<TChar[]> > buffers_;
+  size_t buffer_used_;
+};
+
+
+/**
+ * \brief  Output file. In atomic mode data is written to a temporary file in the
+ *         same directory which replaces the target on commit(), so the target
+ *         may be read while it is written (e.g. when it is also the input).
+ *         When an atomic file is not committed, the temporary file is removed
+ */
+class OutputFile {
+public:
+  OutputFile() : file_(nullptr) {
+  }
+
+  ~OutputFile() {
+    if (file_) {
+      fclose(file_);
+      if (!temp_filename_.empty())
+        remove(temp_filename_.c_str());
+    }
+  }
+
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  /**
+   * \brief  Create output file
+   * \param  filename   Target file path
+   * \param  is_atomic  true for writing through temporary file
+   * \return true on success
+   */
+  bool open(const std::string& filename, bool is_atomic) {
+    filename_ = filename;
+    temp_filename_.clear();
+
+    if (!is_atomic) {
+      file_ = fopen(filename.c_str(), "wb");
+      return file_ != nullptr;
+    }
+
+#ifndef _WIN32
+    std::vector<char> temp_filename(filename.begin(), filename.end());
+    const char kTempSuffix[] = ".XXXXXX";
+    temp_filename.insert(temp_filename.end(), kTempSuffix, kTempSuffix + sizeof(kTempSuffix));
+
+    int fd = mkstemp(temp_filename.data());
+    if (fd < 0)
+      return false;
+
+    // keep permissions of replaced file, a new file gets the default permissions
+    struct stat file_stat;
+    fchmod(fd, !stat(filename.c_str(), &file_stat) ? file_stat.st_mode & 07777 : 0666 & ~get_umask());
+
+    file_ = fdopen(fd, "wb");
+    if (!file_) {
+      close(fd);
+      remove(temp_filename.data());
+      return false;
+    }
+
+    temp_filename_ = temp_filename.data();
+#else  /*_WIN32*/
+    file_ = fopen((filename + ".tmp").c_str(), "wb");
+    if (!file_)
+      return false;
+
+    temp_filename_ = filename + ".tmp";
+#endif /*_WIN32*/
+
+    return true;
+  }
+
+  FILE* file() const {
+    return file_;
+  }
+
+  int fd() const {
+#ifndef _WIN32
+    return fileno(file_);
+#else  /*_WIN32*/
+    return _fileno(file_);
+#endif /*_WIN32*/
+  }
+
+  /**
+   * \brief  Close file, in atomic mode rename temporary file to target
+   * \return true on success
+   */
+  bool commit() {
+    bool is_ok = !fflush(file_) && !ferror(file_);
+    is_ok = !fclose(file_) && is_ok;
+    file_ = nullptr;
+
+    if (temp_filename_.empty())
+      return is_ok;
+
+    is_ok = is_ok && replace_file(temp_filename_, filename_);
+
+    if (!is_ok)
+      remove(temp_filename_.c_str());
+
+    return is_ok;
+  }
+
+  /**
+   * \brief  Replace target file with another file in the same directory.
+   *         Permissions of the replaced target are kept
+   * \return true on success
+   */
+  static bool replace_file(const std::string& filename, const std::string& target_filename) {
+#ifndef _WIN32
+    struct stat target_stat;
+    if (!stat(target_filename.c_str(), &target_stat))
+      chmod(filename.c_str(), target_stat.st_mode & 07777);
+
+    return !rename(filename.c_str(), target_filename.c_str());
+#else  /*_WIN32*/
+    return MoveFileExA(filename.c_str(), target_filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#endif /*_WIN32*/
+  }
+
+private:
+#ifndef _WIN32
+  /**
+   * \brief  File mode creation mask of process, read once. The mask is set back at once,
+   *         files are created with their own modes meanwhile
+   */
+  static mode_t get_umask() {
+    static const mode_t mask = []() {
+      mode_t value = umask(0);
+      umask(value);
+      return value;
+    }();
+    return mask;
+  }
+#endif /*_WIN32*/
+
+  FILE* file_;
+  std::string filename_;
+  std::string temp_filename_;
+};
+
+
+/**
+ * \brief  Check whether two files have equal content
+ * \return true when both files exist and are equal
+ */
+inline bool is_same_content(const std::string& first, const std::string& second) {
+  std::unique_ptr<FILE, int (*)(FILE*)> first_file(fopen(first.c_str(), "rb"), fclose);
+  std::unique_ptr<FILE, int (*)(FILE*)> second_file(fopen(second.c_str(), "rb"), fclose);
+  if (!first_file || !second_file)
+    return false;
+
+  std::vector<char> first_buffer(64 * 1024);
+  std::vector<char> second_buffer(first_buffer.size());
+
+  while (true) {
+    size_t first_size = fread(first_buffer.data(), 1, first_buffer.size(), first_file.get());
+    size_t second_size = fread(second_buffer.data(), 1, second_buffer.size(), second_file.get());
+    if (first_size != second_size || memcmp(first_buffer.data(), second_buffer.data(), first_size))
+      return false;
+
+    if (first_size < first_buffer.size())
+      return !ferror(first_file.get()) && !ferror(second_file.get());
+  }
+}
+
+
+#ifndef _WIN32
+
+/**
+ * \brief  Write buffers to file descriptor, retrying on partial writes
+ */
+inline bool write_buffers(int fd, struct iovec* buffers, size_t count) {
+  while (count) {
+    ssize_t written = writev(fd, buffers, static_cast<int>(std::min<size_t>(count, IOV_MAX)));
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    size_t size = static_cast<size_t>(written);
+    while (count && size >= buffers->iov_len) {
+      size -= buffers->iov_len;
+      ++buffers;
+      --count;
+    }
+
+    if (count) {
+      buffers->iov_base = static_cast<char*>(buffers->iov_base) + size;
+      buffers->iov_len -= size;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Write buffers to file descriptor at offset, retrying on partial writes.
+ *         File position is not used, so several threads may write one file
+ */
+inline bool write_buffers_at(int fd, struct iovec* buffers, size_t count, off_t offset) {
+  while (count) {
+    ssize_t written = pwritev(fd, buffers, static_cast<int>(std::min<size_t>(count, IOV_MAX)), offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    size_t size = static_cast<size_t>(written);
+    offset += static_cast<off_t>(size);
+    while (count && size >= buffers->iov_len) {
+      size -= buffers->iov_len;
+      ++buffers;
+      --count;
+    }
+
+    if (count) {
+      buffers->iov_base = static_cast<char*>(buffers->iov_base) + size;
+      buffers->iov_len -= size;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * \brief  Copy file range between descriptors in kernel, without passing data through user space
+ * \return true when the whole range is copied, false when copying is not supported
+ *         for these files (e.g. different file systems) and nothing is written
+ */
+inline bool copy_source_range(int source_fd, int fd, size_t offset, size_t size, bool& is_failed) {
+  is_failed = false;
+#ifdef __linux__
+  off_t source_offset = static_cast<off_t>(offset);
+  size_t copied = 0;
+
+  while (copied < size) {
+    ssize_t result = copy_file_range(source_fd, &source_offset, fd, nullptr, size - copied, 0);
+    if (result < 0 && errno == EINTR)
+      continue;
+
+    if (result <= 0) {
+      if (copied || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP))
+        is_failed = true;  // cannot fall back after partial copy
+      return false;
+    }
+
+    copied += static_cast<size_t>(result);
+  }
+
+  return true;
+#else  /*__linux__*/
+  (void)source_fd;
+  (void)fd;
+  (void)offset;
+  (void)size;
+  return false;
+#endif /*__linux__*/
+}
+
+/**
+ * \brief  Write slices to file with vectored writes. Large source slices are
+ *         copied from the source file in kernel when both files are on the same file system
+ * \param  fd            Output file descriptor
+ * \param  slices        Output slices
+ * \param  source_fd     Source file descriptor, -1 when source is not a file
+ * \param  source_data   Source text, which is the mapped source file
+ * \return true on success
+ */
+template<typename TChar>
+bool write_slices(int fd, const std::vector<typename SliceSink<TChar>::Slice>& slices, int source_fd, const TChar* source_data) {
+  const size_t kCopyRangeMinSize = 1024 * 1024;
+  const size_t kMaxBuffers = 1024;
+
+  bool is_copy_range_enabled = false;
+  if (source_fd >= 0) {
+    struct stat source_stat;
+    struct stat file_stat;
+    is_copy_range_enabled = !fstat(source_fd, &source_stat) && !fstat(fd, &file_stat) && source_stat.st_dev == file_stat.st_dev;
+  }
+
+  std::vector<struct iovec> buffers;
+  buffers.reserve(std::min(slices.size(), kMaxBuffers));
+
+  for (size_t i = 0; i < slices.size(); i++) {
+    const typename SliceSink<TChar>::Slice& slice = slices[i];
+    size_t size = slice.size * sizeof(TChar);
+
+    if (is_copy_range_enabled && slice.is_source && size >= kCopyRangeMinSize) {
+      if (!write_buffers(fd, buffers.data(), buffers.size()))
+        return false;
+      buffers.clear();
+
+      bool is_failed;
+      size_t offset = (slice.data - source_data) * sizeof(TChar);
+      if (copy_source_range(source_fd, fd, offset, size, is_failed))
+        continue;
+      if (is_failed)
+        return false;
+
+      is_copy_range_enabled = false;
+    }
+
+    struct iovec buffer;
+    buffer.iov_base = const_cast<TChar*>(slice.data);
+    buffer.iov_len = size;
+    buffers.push_back(buffer);
+
+    if (buffers.size() == kMaxBuffers) {
+      if (!write_buffers(fd, buffers.data(), buffers.size()))
+        return false;
+      buffers.clear();
+    }
+  }
+
+  return write_buffers(fd, buffers.data(), buffers.size());
+}
+
+/**
+ * \brief  Write slices to file at offset with positioned vectored writes
+ * \param  fd      Output file descriptor
+ * \param  slices  Output slices
+ * \param  offset  Offset of the first slice in file, in bytes
+ * \return true on success
+ */
+template<typename TChar>
+bool write_slices_at(int fd, const std::vector<typename SliceSink<TChar>::Slice>& slices, off_t offset) {
+  const size_t kMaxBuffers = 1024;
+
+  std::vector<struct iovec> buffers;
+  buffers.reserve(std::min(slices.size(), kMaxBuffers));
+  off_t buffers_offset = offset;
+
+  for (size_t i = 0; i < slices.size(); i++) {
+    struct iovec buffer;
+    buffer.iov_base = const_cast<TChar*>(slices[i].data);
+    buffer.iov_len = slices[i].size * sizeof(TChar);
+    buffers.push_back(buffer);
+    offset += static_cast<off_t>(buffer.iov_len);
+
+    if (buffers.size() == kMaxBuffers) {
+      if (!write_buffers_at(fd, buffers.data(), buffers.size(), buffers_offset))
+        return false;
+      buffers.clear();
+      buffers_offset = offset;
+    }
+  }
+
+  return write_buffers_at(fd, buffers.data(), buffers.size(), buffers_offset);
+}
+
+#endif /*_WIN32*/
+
+
+/**
+ * \brief  Copy file through a temporary file which replaces the target. On Linux
+ *         the copy shares data blocks with the source when the file system supports
+ *         reflinks, otherwise it is copied in kernel by copy_file_range, and by
+ *         reads and writes when neither is supported
+ * \param  source_filename  Path to source file
+ * \param  target_filename  Path to target file
+ * \return true on success
+ */
+inline bool copy_file_content(const std::string& source_filename, const std::string& target_filename) {
+  std::unique_ptr<FILE, int (*)(FILE*)> source(fopen(source_filename.c_str(), "rb"), fclose);
+  OutputFile target;
+  if (!source || !target.open(target_filename, true))
+    return false;
+
+#ifndef _WIN32
+  int source_fd = fileno(source.get());
+#ifdef __linux__
+  if (!ioctl(target.fd(), FICLONE, source_fd))
+    return target.commit();
+#endif /*__linux__*/
+
+  struct stat source_stat;
+  if (fstat(source_fd, &source_stat))
+    return false;
+
+  bool is_failed;
+  if (copy_source_range(source_fd, target.fd(), 0, static_cast<size_t>(source_stat.st_size), is_failed))
+    return target.commit();
+  if (is_failed)
+    return false;
+#endif /*_WIN32*/
+
+  std::vector<char> buffer(64 * 1024);
+  while (size_t size = fread(buffer.data(), 1, buffer.size(), source.get())) {
+    if (fwrite(buffer.data(), 1, size, target.file()) != size)
+      return false;
+  }
+
+  return !ferror(source.get()) && target.commit();
+}
+
+#endif  // FILEREPLACE_SLICE_OUTPUT_H_
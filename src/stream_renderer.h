@@ -0,0 +1,323 @@
+#ifndef FILEREPLACE_STREAM_RENDERER_H_
+#define FILEREPLACE_STREAM_RENDERER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "key_matcher.h"
+#include "meta_parser.h"
+
+
+/**
+ * \brief  Keys and meta tokens of StreamRenderer compiled to one automaton.
+ *
+ * Immutable after construction, so it may be built once for a table and
+ * shared by renderers of different threads. Pattern indexes of keys follow
+ * the replace table iteration order, meta tokens follow keys.
+ * Tokens keep references to table values, so the table must outlive them.
+ */
+template<typename TString, typename TParserParams>
+class StreamTokens {
+public:
+  typedef typename TString::value_type CharType;
+
+  static const size_t kEndIfPattern = 3;   // index after meta block types
+
+  StreamTokens(const std::map<TString, TString>& replace_table, bool is_meta_enabled, const TParserParams& parser_params) {
+    for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+      i != replace_table.end();
+      i++) {
+      matcher_.add_pattern(i->first.data(), i->first.size());
+      values_.push_back(&i->second);
+    }
+
+    if (is_meta_enabled) {
+      add_meta_pattern(parser_params.if_set_token_);
+      add_meta_pattern(parser_params.if_not_set_token_);
+      add_meta_pattern(parser_params.if_contains_token_);
+      add_meta_pattern(parser_params.end_if_token_);
+    }
+
+    matcher_.build();
+  }
+
+  StreamTokens(const StreamTokens&) = delete;
+  StreamTokens& operator=(const StreamTokens&) = delete;
+
+  /**
+   * \brief  Take values from another table with the same keys, e.g. with expanded
+   *         values. Must be called before the tokens are shared
+   */
+  void set_values(const std::map<TString, TString>& replace_table) {
+    values_.clear();
+    for (typename std::map<TString, TString>::const_iterator i = replace_table.begin();
+      i != replace_table.end();
+      i++) {
+      values_.push_back(&i->second);
+    }
+  }
+
+  const KeyMatcher<CharType>& matcher() const {
+    return matcher_;
+  }
+
+  /**
+   * \brief  Value of key by pattern index, only for patterns below keys_count()
+   */
+  const TString& value(size_t pattern) const {
+    return *values_[pattern];
+  }
+
+  size_t keys_count() const {
+    return values_.size();
+  }
+
+  /**
+   * \brief  Check that keys and meta tokens can never overlap each other, so
+   *         the scan finds the same occurrences as searching them one by one
+   */
+  bool is_conflict_free() const {
+    return matcher_.is_conflict_free();
+  }
+
+  /**
+   * \brief  Check whether text contains keys or meta blocks, which would be
+   *         processed by the next pass of multipass processing.
+   *         Must be used only when is_conflict_free() is true
+   * \param  state [in,out]  Automaton state, 0 at text start. Allows to check text split to pieces
+   */
+  bool contains_tokens(const CharType* text, size_t size, int32_t& state) const {
+    return matcher_.contains_any(text, size, state, values_.size() + kEndIfPattern);
+  }
+
+private:
+  void add_meta_pattern(const TString& token) {
+    matcher_.add_pattern(token.data(), token.size());
+  }
+
+  KeyMatcher<CharType> matcher_;
+  std::vector<const TString*> values_;
+};
+
+/**
+ * \brief  One pass renderer for text split to windows.
+ *
+ * Keys and meta tokens are found by one automaton in one scan. Meta blocks are
+ * nested as in MetaTree: each !%@ENDIF% closes the innermost open block. Inserted values are
+ * not scanned again. Text which cannot be decided within a window (a key or a
+ * meta token crossing the window end) is left unconsumed and must be passed
+ * again at the start of the next window.
+ * Text may also be split to chunks which are rendered by separate renderers:
+ * a chunk is rendered as if no block is open at its start, and is rendered
+ * again with the blocks which are really open there, when they are known.
+ * The renderer keeps references to tokens, table and parser params, so they must outlive it.
+ */
+template<typename TString, typename TParserParams>
+class StreamRenderer {
+public:
+  typedef typename TString::value_type CharType;
+  typedef StreamTokens<TString, TParserParams> Tokens;
+
+  struct OpenBlock {
+    MetaBlockType type;
+    bool is_condition_true;
+  };
+
+  StreamRenderer(const Tokens& tokens, const std::map<TString, TString>& replace_table, const TParserParams& parser_params)
+    : tokens_(tokens), replace_table_(replace_table), parser_params_(parser_params), line_(1), dropped_blocks_(0),
+      unmatched_end_ifs_(0), replaces_count_(0), key_replaces_(nullptr) {
+  }
+
+  /**
+   * \brief  Render text window
+   * \param  text            Window text, starts with the unconsumed part of the previous window
+   * \param  size            Window size in code units
+   * \param  is_final        true for the last window
+   * \param  consumed [out]  Count of code units which are rendered to sink
+   * \param  sink            Output, must provide append(const CharType*, size_t)
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false on meta syntax error
+   */
+  template<typename TSink>
+  bool process(const CharType* text, size_t size, bool is_final, size_t& consumed, TSink& sink, std::ostream& error_text) {
+    if (!process_window(text, size, is_final, consumed, sink, error_text))
+      return false;
+
+    if (is_final) {
+      for (size_t i = 0; i < blocks_.size(); i++) {
+        if (blocks_[i].type != kMetaIfContains) {  // IFCONTAINS block without end lasts up to the end of text
+          error_text << get_meta_block_name(blocks_[i].type) << " macro end not found, syntax error on line " << blocks_[i].line << std::endl;
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief  Render chunk of text. No key or meta token may cross the chunk end,
+   *         blocks may stay open there
+   * \return true on success, false on meta syntax error or meta header crossing the chunk end
+   */
+  template<typename TSink>
+  bool process_chunk(const CharType* text, size_t size, TSink& sink, std::ostream& error_text) {
+    size_t consumed;
+    return process_window(text, size, true, consumed, sink, error_text);
+  }
+
+  /**
+   * \brief  Blocks which are open after the processed text, outermost first
+   */
+  std::vector<OpenBlock> open_blocks() const {
+    std::vector<OpenBlock> result;
+    for (size_t i = 0; i < blocks_.size(); i++)
+      result.push_back(OpenBlock{ blocks_[i].type, blocks_[i].is_condition_true });
+    return result;
+  }
+
+  /**
+   * \brief  Start rendering inside blocks, which are opened before the text
+   * \param  blocks  Open blocks, outermost first
+   */
+  void set_open_blocks(const std::vector<OpenBlock>& blocks) {
+    blocks_.clear();
+    dropped_blocks_ = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+      open_block(blocks[i].type, blocks[i].is_condition_true);
+  }
+
+  /**
+   * \brief  Count of !%@ENDIF% tokens which closed no block and were left as is.
+   *         In a chunk rendered without open blocks they close blocks open at its start
+   */
+  size_t unmatched_end_ifs() const {
+    return unmatched_end_ifs_;
+  }
+
+  /**
+   * \brief  Count of keys replaced so far
+   */
+  size_t replaces_count() const {
+    return replaces_count_;
+  }
+
+  /**
+   * \brief  Count replaces by key index in table order
+   * \param  key_replaces  Array of counts which are increased, null to stop counting
+   */
+  void set_key_replaces(uint64_t* key_replaces) {
+    key_replaces_ = key_replaces;
+  }
+
+private:
+  struct Block {
+    MetaBlockType type;
+    size_t line;
+    bool is_condition_true;
+    bool is_kept;              // condition of the block and of all outer blocks is true
+  };
+
+  template<typename TSink>
+  bool process_window(const CharType* text, size_t size, bool is_final, size_t& consumed, TSink& sink, std::ostream& error_text) {
+    typename KeyMatcher<CharType>::Match match;
+    size_t offset = 0;
+    size_t counted = 0;   // newlines are counted up to this position
+
+    while (true) {
+      typename KeyMatcher<CharType>::FindResult result = tokens_.matcher().find(text, size, offset, is_final, match);
+      if (result == KeyMatcher<CharType>::kNotFound) {
+        emit(sink, text + offset, size - offset);
+        offset = size;
+        break;
+      }
+
+      emit(sink, text + offset, match.position - offset);
+      offset = match.position;
+      if (result == KeyMatcher<CharType>::kNeedMoreData)
+        break;
+
+      if (match.pattern < tokens_.keys_count()) {
+        if (!dropped_blocks_) {
+          const TString& value = tokens_.value(match.pattern);
+          sink.append(value.data(), value.size());
+          ++replaces_count_;
+          if (key_replaces_)
+            key_replaces_[match.pattern]++;
+        }
+        offset += match.length;
+        continue;
+      }
+
+      if (match.pattern - tokens_.keys_count() == Tokens::kEndIfPattern) {
+        if (blocks_.empty()) {
+          emit(sink, text + offset, match.length);  // not opened block, left as is
+          ++unmatched_end_ifs_;
+        } else {
+          if (!blocks_.back().is_kept)
+            --dropped_blocks_;
+          blocks_.pop_back();
+        }
+        offset += match.length;
+        continue;
+      }
+
+      line_ += std::count(text + counted, text + offset, '\n');
+      counted = offset;
+
+      MetaHeader<TString> header;
+      header.type = static_cast<MetaBlockType>(match.pattern - tokens_.keys_count());
+      MetaHeaderResult header_result = parse_meta_header(text, size, offset, is_final, parser_params_, header);
+      if (header_result == kMetaHeaderNeedMoreData)
+        break;
+
+      if (header_result == kMetaHeaderSyntaxError) {
+        error_text << get_meta_block_name(header.type) << " macro syntax error on line " << line_ << std::endl;
+        return false;
+      }
+
+      // condition is known also inside removed blocks, as the chunk may be rendered again inside kept ones
+      open_block(header.type, is_meta_condition_true(header, replace_table_));
+      offset += header.size;
+    }
+
+    line_ += std::count(text + counted, text + offset, '\n');
+    consumed = offset;
+    return true;
+  }
+
+  void open_block(MetaBlockType type, bool is_condition_true) {
+    Block block;
+    block.type = type;
+    block.line = line_;
+    block.is_condition_true = is_condition_true;
+    block.is_kept = !dropped_blocks_ && is_condition_true;
+    if (!block.is_kept)
+      ++dropped_blocks_;
+
+    blocks_.push_back(block);
+  }
+
+  template<typename TSink>
+  void emit(TSink& sink, const CharType* text, size_t size) {
+    if (size && !dropped_blocks_)
+      sink.append(text, size);
+  }
+
+  const Tokens& tokens_;
+  const std::map<TString, TString>& replace_table_;
+  const TParserParams& parser_params_;
+  std::vector<Block> blocks_;    // open meta blocks, innermost last
+  size_t line_;                  // line number at the start of the unconsumed text
+  size_t dropped_blocks_;        // count of open blocks which content is removed
+  size_t unmatched_end_ifs_;
+  size_t replaces_count_;
+  uint64_t* key_replaces_;       // replaces by key index, may be null
+};
+
+#endif  // FILEREPLACE_STREAM_RENDERER_H_
@@ -0,0 +1,301 @@
+#ifndef FILEREPLACE_TABLE_FILE_H_
+#define FILEREPLACE_TABLE_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "content_hash.h"
+#include "mapped_file.h"
+
+
+/**
+ * Compiled replace table file layout. All numbers are in host byte order:
+ *
+ *   TableFileHeader
+ *   TableFileEntry  entries[entries_count]  in key order
+ *   uint32_t        slots[slots_count]      hash index: entry index + 1, 0 for empty slot
+ *   char            text[text_size]         keys and values, UTF-8
+ *
+ * The index is open addressing with linear probing: a key is looked up from
+ * slot XXH64(key) % slots_count to the first empty slot. Slots count is a power
+ * of two and at least twice the entries count, so probe sequences are short.
+ */
+static const char kTableFileMagic[8] = { 'F', 'R', 'T', 'B', 'L', '0', '0', '1' };
+
+struct TableFileHeader {
+  char magic[8];
+  uint64_t entries_count;
+  uint64_t slots_count;
+  uint64_t text_size;
+};
+
+struct TableFileEntry {
+  uint64_t key_offset;     // in text
+  uint64_t value_offset;
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+
+/**
+ * \brief  Replace table file: KEY=VALUE text file or compiled table.
+ *
+ * Text file has one entry per line, the key ends at the first equal sign. Empty
+ * lines and lines started with # are skipped, a later entry of the same key
+ * overrides an earlier one. Text table is compiled in memory when it is opened,
+ * compiled table is mapped and used without parsing or copying. Lookups take one
+ * hash of the key. Values are kept as written, @FILENAME values are resolved by
+ * the caller as on the command line.
+ */
+class TableFile {
+public:
+  TableFile() : header_(nullptr), entries_(nullptr), slots_(nullptr), text_(nullptr) {
+  }
+
+  TableFile(const TableFile&) = delete;
+  TableFile& operator=(const TableFile&) = delete;
+
+  /**
+   * \brief  Open text or compiled table
+   * \param  filename          Path to table
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false when file cannot be read or has syntax error
+   */
+  bool open(const std::string& filename, std::ostream& error_text) {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<char> loaded;
+
+    if (mapping_.open(filename)) {
+      data = mapping_.data();
+      size = mapping_.size();
+    } else {
+      std::ifstream file(filename.c_str(), std::ios::binary);
+      if (!file) {
+        error_text << "Cannot open table " << filename << std::endl;
+        return false;
+      }
+      loaded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      data = loaded.data();
+      size = loaded.size();
+    }
+
+    if (size >= sizeof(kTableFileMagic) && !memcmp(data, kTableFileMagic, sizeof(kTableFileMagic))) {
+      if (mapping_.data())
+        return attach(data, size, filename, error_text);
+
+      image_.swap(loaded);
+      return attach(image_.data(), image_.size(), filename, error_text);
+    }
+
+    std::vector<char> image;
+    if (!compile(data, size, filename, image, error_text))
+      return false;
+
+    mapping_.close();
+    image_.swap(image);
+    return attach(image_.data(), image_.size(), filename, error_text);
+  }
+
+  /**
+   * \brief  Compile KEY=VALUE text to compiled table
+   * \param  text              Table text
+   * \param  size              Text size
+   * \param  filename          Table name for error messages
+   * \param  image [out]       Compiled table file content
+   * \param  error_text [out]  Stream for error output
+   * \return true on success, false on syntax error
+   */
+  static bool compile(const char* text, size_t size, const std::string& filename, std::vector<char>& image, std::ostream& error_text) {
+    static const char kUtf8ByteOrderMark[] = "\xEF\xBB\xBF";
+    if (size >= 3 && !memcmp(text, kUtf8ByteOrderMark, 3)) {
+      text += 3;
+      size -= 3;
+    }
+
+    std::map<std::string, std::string> entries;
+    const char* end = text + size;
+    size_t line_number = 1;
+
+    for (const char* line = text; line < end; line_number++) {
+      const char* line_end = static_cast<const char*>(memchr(line, '\n', end - line));
+      if (!line_end)
+        line_end = end;
+      const char* next_line = line_end < end ? line_end + 1 : end;
+      if (line_end > line && line_end[-1] == '\r')
+        --line_end;
+
+      if (line == line_end || *line == '#') {
+        line = next_line;
+        continue;
+      }
+
+      const char* equal_sign = static_cast<const char*>(memchr(line, '=', line_end - line));
+      if (!equal_sign) {
+        error_text << "table error on line " << line_number << " of " << filename << ": equal sign is not found in <template>=<value> construction" << std::endl;
+        return false;
+      }
+
+      entries[std::string(line, equal_sign)].assign(equal_sign + 1, line_end);
+      line = next_line;
+    }
+
+    size_t slots_count = 2;
+    while (slots_count < 2 * entries.size())
+      slots_count *= 2;
+
+    size_t text_size = 0;
+    for (std::map<std::string, std::string>::const_iterator i = entries.begin(); i != entries.end(); i++) {
+      if (i->first.size() > UINT32_MAX || i->second.size() > UINT32_MAX || entries.size() >= UINT32_MAX) {
+        error_text << "table error: too large entry in " << filename << std::endl;
+        return false;
+      }
+      text_size += i->first.size() + i->second.size();
+    }
+
+    size_t entries_offset = sizeof(TableFileHeader);
+    size_t slots_offset = entries_offset + entries.size() * sizeof(TableFileEntry);
+    size_t text_offset = slots_offset + slots_count * sizeof(uint32_t);
+    image.assign(text_offset + text_size, 0);
+
+    TableFileHeader* header = reinterpret_cast<TableFileHeader*>(image.data());
+    memcpy(header->magic, kTableFileMagic, sizeof(kTableFileMagic));
+    header->entries_count = entries.size();
+    header->slots_count = slots_count;
+    header->text_size = text_size;
+
+    TableFileEntry* table_entries = reinterpret_cast<TableFileEntry*>(image.data() + entries_offset);
+    uint32_t* slots = reinterpret_cast<uint32_t*>(image.data() + slots_offset);
+    char* pool = image.data() + text_offset;
+    uint64_t offset = 0;
+    uint32_t index = 0;
+
+    for (std::map<std::string, std::string>::const_iterator i = entries.begin(); i != entries.end(); i++, index++) {
+      TableFileEntry& entry = table_entries[index];
+      entry.key_offset = offset;
+      entry.key_size = static_cast<uint32_t>(i->first.size());
+      memcpy(pool + offset, i->first.data(), i->first.size());
+      offset += i->first.size();
+
+      entry.value_offset = offset;
+      entry.value_size = static_cast<uint32_t>(i->second.size());
+      memcpy(pool + offset, i->second.data(), i->second.size());
+      offset += i->second.size();
+
+      size_t slot = hash_key(i->first.data(), i->first.size()) & (slots_count - 1);
+      while (slots[slot])
+        slot = (slot + 1) & (slots_count - 1);
+      slots[slot] = index + 1;
+    }
+
+    return true;
+  }
+
+  size_t size() const {
+    return header_ ? static_cast<size_t>(header_->entries_count) : 0;
+  }
+
+  const char* key(size_t index) const {
+    return text_ + entries_[index].key_offset;
+  }
+
+  size_t key_size(size_t index) const {
+    return entries_[index].key_size;
+  }
+
+  const char* value(size_t index) const {
+    return text_ + entries_[index].value_offset;
+  }
+
+  size_t value_size(size_t index) const {
+    return entries_[index].value_size;
+  }
+
+  /**
+   * \brief  Find entry of key
+   * \param  key   Key
+   * \param  size  Key size
+   * \return Entry index, size() when key is not found
+   */
+  size_t find(const char* key, size_t size) const {
+    if (!header_)
+      return 0;
+
+    size_t mask = static_cast<size_t>(header_->slots_count) - 1;
+    for (size_t slot = hash_key(key, size) & mask; slots_[slot]; slot = (slot + 1) & mask) {
+      size_t index = slots_[slot] - 1;
+      if (entries_[index].key_size == size && !memcmp(text_ + entries_[index].key_offset, key, size))
+        return index;
+    }
+
+    return static_cast<size_t>(header_->entries_count);
+  }
+
+private:
+  static uint64_t hash_key(const char* key, size_t size) {
+    ContentHash hash;
+    hash.update(key, size);
+    return hash.digest();
+  }
+
+  /**
+   * \brief  Check compiled table and take pointers to its parts
+   */
+  bool attach(const char* data, size_t size, const std::string& filename, std::ostream& error_text) {
+    if (size < sizeof(TableFileHeader)) {
+      error_text << "Table is damaged " << filename << std::endl;
+      return false;
+    }
+
+    const TableFileHeader* header = reinterpret_cast<const TableFileHeader*>(data);
+    uint64_t entries_size = header->entries_count * sizeof(TableFileEntry);
+    uint64_t slots_size = header->slots_count * sizeof(uint32_t);
+
+    bool is_valid = header->entries_count < UINT32_MAX && header->slots_count <= (UINT64_MAX >> 3)
+      && header->slots_count > header->entries_count && !(header->slots_count & (header->slots_count - 1))
+      && sizeof(TableFileHeader) + entries_size + slots_size + header->text_size == size;
+
+    const TableFileEntry* entries = reinterpret_cast<const TableFileEntry*>(data + sizeof(TableFileHeader));
+    for (uint64_t i = 0; is_valid && i < header->entries_count; i++) {
+      is_valid = entries[i].key_offset <= header->text_size && entries[i].key_size <= header->text_size - entries[i].key_offset
+        && entries[i].value_offset <= header->text_size && entries[i].value_size <= header->text_size - entries[i].value_offset;
+    }
+
+    // each entry has one slot, so probing always stops at an empty slot
+    const uint32_t* slots = reinterpret_cast<const uint32_t*>(data + sizeof(TableFileHeader) + entries_size);
+    uint64_t used_slots = 0;
+    for (uint64_t i = 0; is_valid && i < header->slots_count; i++) {
+      is_valid = slots[i] <= header->entries_count;
+      used_slots += slots[i] != 0;
+    }
+    is_valid = is_valid && used_slots == header->entries_count;
+
+    if (!is_valid) {
+      error_text << "Table is damaged " << filename << std::endl;
+      return false;
+    }
+
+    header_ = header;
+    entries_ = entries;
+    slots_ = slots;
+    text_ = data + sizeof(TableFileHeader) + entries_size + slots_size;
+    return true;
+  }
+
+  MappedFile mapping_;
+  std::vector<char> image_;
+  const TableFileHeader* header_;
+  const TableFileEntry* entries_;
+  const uint32_t* slots_;
+  const char* text_;
+};
+
+#endif  // FILEREPLACE_TABLE_FILE_H_
@@ -0,0 +1,219 @@
+#include "text_encoding.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FILEREPLACE_ENCODING_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace {
+
+const char kUtf8Bom[] = { '\xEF', '\xBB', '\xBF' };
+const char kUtf16LeBom[] = { '\xFF', '\xFE' };
+const char kUtf16BeBom[] = { '\xFE', '\xFF' };
+const char32_t kReplacementCharacter = 0xFFFD;
+
+bool has_prefix(const char* data, size_t size, const char* prefix, size_t prefix_size) {
+  return size >= prefix_size && !memcmp(data, prefix, prefix_size);
+}
+
+bool is_continuation(unsigned char byte) {
+  return (byte & 0xC0) == 0x80;
+}
+
+/**
+ * \brief  Decode one UTF-8 sequence
+ * \param  length [out]  Count of consumed bytes, at least 1
+ * \return Code point, kReplacementCharacter for invalid sequence
+ */
+char32_t decode_utf8(const unsigned char* text, size_t size, size_t& length) {
+  unsigned char lead = text[0];
+  length = 1;
+  if (lead < 0x80)
+    return lead;
+
+  size_t count;
+  char32_t code;
+  char32_t min_code;
+  if ((lead & 0xE0) == 0xC0) {
+    count = 2;
+    code = lead & 0x1F;
+    min_code = 0x80;
+  } else if ((lead & 0xF0) == 0xE0) {
+    count = 3;
+    code = lead & 0x0F;
+    min_code = 0x800;
+  } else if ((lead & 0xF8) == 0xF0) {
+    count = 4;
+    code = lead & 0x07;
+    min_code = 0x10000;
+  } else {
+    return kReplacementCharacter;
+  }
+
+  if (count > size)
+    return kReplacementCharacter;
+
+  for (size_t i = 1; i < count; i++) {
+    if (!is_continuation(text[i]))
+      return kReplacementCharacter;
+    code = (code << 6) | (text[i] & 0x3F);
+  }
+
+  // overlong forms, surrogates and code points above Unicode range are invalid
+  if (code < min_code || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+    return kReplacementCharacter;
+
+  length = count;
+  return code;
+}
+
+char* encode_utf8(char32_t code, char* out) {
+  if (code < 0x80) {
+    *out++ = static_cast<char>(code);
+  } else if (code < 0x800) {
+    *out++ = static_cast<char>(0xC0 | (code >> 6));
+    *out++ = static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    *out++ = static_cast<char>(0xE0 | (code >> 12));
+    *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    *out++ = static_cast<char>(0xF0 | (code >> 18));
+    *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code & 0x3F));
+  }
+
+  return out;
+}
+
+}  // namespace
+
+
+TextEncoding detect_text_encoding(const char* data, size_t size, TextEncoding default_encoding) {
+  if (has_prefix(data, size, kUtf8Bom, sizeof(kUtf8Bom)))
+    return kTextEncodingUtf8;
+  if (has_prefix(data, size, kUtf16LeBom, sizeof(kUtf16LeBom)))
+    return kTextEncodingUtf16Le;
+  if (has_prefix(data, size, kUtf16BeBom, sizeof(kUtf16BeBom)))
+    return kTextEncodingUtf16Be;
+
+  return default_encoding;
+}
+
+size_t get_bom_size(const char* data, size_t size, TextEncoding encoding) {
+  switch (encoding) {
+  case kTextEncodingUtf8:
+    return has_prefix(data, size, kUtf8Bom, sizeof(kUtf8Bom)) ? sizeof(kUtf8Bom) : 0;
+  case kTextEncodingUtf16Le:
+    return has_prefix(data, size, kUtf16LeBom, sizeof(kUtf16LeBom)) ? sizeof(kUtf16LeBom) : 0;
+  default:
+    return has_prefix(data, size, kUtf16BeBom, sizeof(kUtf16BeBom)) ? sizeof(kUtf16BeBom) : 0;
+  }
+}
+
+bool is_host_byte_order(TextEncoding encoding) {
+  const uint16_t kProbe = 1;
+  bool is_little_endian = *reinterpret_cast<const unsigned char*>(&kProbe) == 1;
+
+  switch (encoding) {
+  case kTextEncodingUtf16Le:
+    return is_little_endian;
+  case kTextEncodingUtf16Be:
+    return !is_little_endian;
+  default:
+    return true;
+  }
+}
+
+void swap_byte_order(char16_t* text, size_t size) {
+  size_t i = 0;
+
+#ifdef FILEREPLACE_ENCODING_SSE2
+  for (; i + 8 <= size; i += 8) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    block = _mm_or_si128(_mm_slli_epi16(block, 8), _mm_srli_epi16(block, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(text + i), block);
+  }
+#endif /*FILEREPLACE_ENCODING_SSE2*/
+
+  for (; i < size; i++)
+    text[i] = static_cast<char16_t>((text[i] << 8) | (text[i] >> 8));
+}
+
+void utf8_to_utf16(const char* text, size_t size, std::u16string& result) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(text);
+  result.resize(size);   // a code unit takes at least one byte
+  char16_t* out = &result[0];
+  char16_t* out_start = out;
+  size_t i = 0;
+
+  while (i < size) {
+#ifdef FILEREPLACE_ENCODING_SSE2
+    // ASCII blocks are widened as is
+    const __m128i kZero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16, out += 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+      if (_mm_movemask_epi8(block))
+        break;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(block, kZero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(block, kZero));
+    }
+
+    if (i == size)
+      break;
+#endif /*FILEREPLACE_ENCODING_SSE2*/
+
+    size_t length;
+    char32_t code = decode_utf8(in + i, size - i, length);
+    i += length;
+
+    if (code < 0x10000) {
+      *out++ = static_cast<char16_t>(code);
+    } else {
+      code -= 0x10000;
+      *out++ = static_cast<char16_t>(0xD800 | (code >> 10));
+      *out++ = static_cast<char16_t>(0xDC00 | (code & 0x3FF));
+    }
+  }
+
+  result.resize(out - out_start);
+}
+
+void utf16_to_utf8(const char16_t* text, size_t size, std::string& result) {
+  result.resize(size * 3);   // a code unit takes at most three bytes
+  char* out = &result[0];
+  char* out_start = out;
+  size_t i = 0;
+
+  while (i < size) {
+#ifdef FILEREPLACE_ENCODING_SSE2
+    // ASCII blocks are narrowed as is
+    const __m128i kNonAsciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i kZero = _mm_setzero_si128();
+    for (; i + 8 <= size; i += 8, out += 8) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+      __m128i non_ascii = _mm_cmpeq_epi16(_mm_and_si128(block, kNonAsciiMask), kZero);
+      if (_mm_movemask_epi8(non_ascii) != 0xFFFF)
+        break;
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(block, block));
+    }
+
+    if (i == size)
+      break;
+#endif /*FILEREPLACE_ENCODING_SSE2*/
+
+    char32_t code = text[i++];
+    if (code >= 0xD800 && code <= 0xDBFF && i < size && text[i] >= 0xDC00 && text[i] <= 0xDFFF)
+      code = 0x10000 + ((code - 0xD800) << 10) + (text[i++] - 0xDC00);
+    else if (code >= 0xD800 && code <= 0xDFFF)
+      code = kReplacementCharacter;
+
+    out = encode_utf8(code, out);
+  }
+
+  result.resize(out - out_start);
+}
@@ -0,0 +1,65 @@
+#ifndef FILEREPLACE_TEXT_ENCODING_H_
+#define FILEREPLACE_TEXT_ENCODING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+
+/**
+ * Encodings of templates and value files. Text is processed in code units of
+ * the template: bytes for ANSI/UTF-8 templates, char16_t in host byte order for
+ * UTF-16 templates. Values are transcoded once, only when their encoding
+ * differs from the template encoding.
+ */
+
+enum TextEncoding {
+  kTextEncodingUtf8,      // also ANSI, bytes are taken as is
+  kTextEncodingUtf16Le,
+  kTextEncodingUtf16Be
+};
+
+
+/**
+ * \brief  Detect encoding by byte order mark
+ * \param  data              File content
+ * \param  size              Content size in bytes
+ * \param  default_encoding  Encoding of content without byte order mark
+ */
+TextEncoding detect_text_encoding(const char* data, size_t size, TextEncoding default_encoding);
+
+/**
+ * \brief  Size of byte order mark in bytes, 0 when content has no mark of this encoding
+ */
+size_t get_bom_size(const char* data, size_t size, TextEncoding encoding);
+
+/**
+ * \brief  Check whether code units of encoding are in host byte order, true for UTF-8
+ */
+bool is_host_byte_order(TextEncoding encoding);
+
+/**
+ * \brief  Swap bytes of UTF-16 code units in place, between host and the other byte order
+ */
+void swap_byte_order(char16_t* text, size_t size);
+
+/**
+ * \brief  Transcode UTF-8 to UTF-16 in host byte order. Invalid sequences are
+ *         replaced with U+FFFD. ASCII runs are widened with vector instructions
+ * \param  text          UTF-8 text
+ * \param  size          Text size in bytes
+ * \param  result [out]  UTF-16 text
+ */
+void utf8_to_utf16(const char* text, size_t size, std::u16string& result);
+
+/**
+ * \brief  Transcode UTF-16 in host byte order to UTF-8. Unpaired surrogates are
+ *         replaced with U+FFFD. ASCII runs are narrowed with vector instructions
+ * \param  text          UTF-16 text
+ * \param  size          Text size in code units
+ * \param  result [out]  UTF-8 text
+ */
+void utf16_to_utf8(const char16_t* text, size_t size, std::string& result);
+
+#endif  // FILEREPLACE_TEXT_ENCODING_H_
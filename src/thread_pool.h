@@ -0,0 +1,166 @@
+#ifndef FILEREPLACE_THREAD_POOL_H_
+#define FILEREPLACE_THREAD_POOL_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * \brief  Work-stealing thread pool.
+ *
+ * Every worker has its own task queue. Tasks submitted from a worker go to its
+ * own queue and are taken from the back (last submitted first, data is still in
+ * cache), idle workers steal from the front of other queues. Tasks submitted
+ * from other threads are spread over queues round robin.
+ */
+class WorkStealingPool {
+public:
+  typedef std::function<void()> Task;
+
+  /**
+   * \param  threads_count  Count of worker threads, 0 for count of hardware threads
+   */
+  explicit WorkStealingPool(size_t threads_count)
+    : queued_(0), unfinished_(0), next_queue_(0), is_stopped_(false) {
+    if (!threads_count)
+      threads_count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < threads_count; i++)
+      queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+
+    for (size_t i = 0; i < threads_count; i++)
+      threads_.push_back(std::thread(&WorkStealingPool::run_worker, this, i));
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_stopped_ = true;
+    }
+    task_added_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++)
+      threads_[i].join();
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  size_t threads_count() const {
+    return threads_.size();
+  }
+
+  void submit(Task task) {
+    size_t index = current_pool() == this ? current_worker() : next_queue_++ % queues_.size();
+
+    ++unfinished_;
+    {
+      std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+      queues_[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++queued_;
+    }
+    task_added_.notify_one();
+  }
+
+  /**
+   * \brief  Wait until all submitted tasks are finished, including tasks submitted by tasks
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_finished_.wait(lock, [this] { return !unfinished_; });
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  static const WorkStealingPool*& current_pool() {
+    static thread_local const WorkStealingPool* pool = nullptr;
+    return pool;
+  }
+
+  static size_t& current_worker() {
+    static thread_local size_t index = 0;
+    return index;
+  }
+
+  bool take_task(size_t index, Task& task) {
+    {
+      Queue& queue = *queues_[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+      }
+    }
+
+    for (size_t i = 1; i < queues_.size(); i++) {
+      Queue& queue = *queues_[(index + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void run_worker(size_t index) {
+    current_pool() = this;
+    current_worker() = index;
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_added_.wait(lock, [this] { return is_stopped_ || queued_; });
+        if (is_stopped_)
+          return;
+      }
+
+      Task task;
+      if (!take_task(index, task))
+        continue;   // taken by other worker
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --queued_;
+      }
+
+      task();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!--unfinished_)
+        all_finished_.notify_all();
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue> > queues_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable task_added_;
+  std::condition_variable all_finished_;
+  size_t queued_;                      // tasks in queues, guarded by mutex_
+  std::atomic<size_t> unfinished_;     // submitted and not finished tasks
+  std::atomic<size_t> next_queue_;
+  bool is_stopped_;
+};
+
+#endif  // FILEREPLACE_THREAD_POOL_H_
@@ -0,0 +1,136 @@
+#ifndef FILEREPLACE_TREE_STATE_H_
+#define FILEREPLACE_TREE_STATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "content_hash.h"
+#include "file_stamp.h"
+#include "slice_output.h"
+
+
+/**
+ * \brief  State of tree rendering: size and modification time of each source
+ *         file and of its output as of the last run.
+ *
+ * A file is skipped when the source and the output have the same size and time
+ * as recorded, and the run uses the same settings. Settings are hashed to two
+ * keys: the copy key of globs, which select rendered files, and the render key
+ * of globs, loaded values and flags. Copied files are skipped when the copy key
+ * is the same, rendered files when both keys are the same. The state file is a
+ * text file, the keys on the first line and then one line per file:
+ *
+ *   <source size> <source time> <output size> <output time> <relative path>
+ *
+ * It is read before the walk and replaced through a temporary file after it.
+ * Files which were not stored in this run (failed or removed) are dropped.
+ * lookup() and store() are thread-safe.
+ */
+class TreeState {
+public:
+  TreeState(const std::string& filename, uint64_t render_key, uint64_t copy_key)
+    : filename_(filename), render_key_(render_key), copy_key_(copy_key), is_render_key_same_(false) {
+  }
+
+  /**
+   * \brief  Read state of the last run. Missing or damaged state file, or state
+   *         of other settings, is the same as empty state
+   */
+  void load() {
+    std::ifstream file(filename_, std::ios::binary);
+    std::string render_key;
+    std::string copy_key;
+    if (!(file >> render_key >> copy_key) || copy_key != ContentHash::to_hex(copy_key_))
+      return;
+
+    is_render_key_same_ = render_key == ContentHash::to_hex(render_key_);
+
+    Entry entry;
+    std::string path;
+    while (file >> entry.source_size >> entry.source_time >> entry.output_size >> entry.output_time
+      && file.get() == ' ' && std::getline(file, path))
+      previous_[path] = entry;
+  }
+
+  /**
+   * \brief  Check whether file and its output are not changed since the last run
+   * \param  path         Relative path
+   * \param  source       Stamp of source file
+   * \param  output       Stamp of output file
+   * \param  is_rendered  true for rendered file, false for copied file
+   */
+  bool lookup(const std::string& path, const FileStamp& source, const FileStamp& output, bool is_rendered) const {
+    std::map<std::string, Entry>::const_iterator entry = previous_.find(path);
+    return (is_render_key_same_ || !is_rendered) && entry != previous_.end()
+      && entry->second.source_size == source.size && entry->second.source_time == source.time
+      && entry->second.output_size == output.size && entry->second.output_time == output.time;
+  }
+
+  /**
+   * \brief  Remember that file is processed to output
+   * \param  path    Relative path
+   * \param  source  Stamp of source file
+   * \param  output  Stamp of output file
+   */
+  void store(const std::string& path, const FileStamp& source, const FileStamp& output) {
+    Entry entry = { source.size, source.time, output.size, output.time };
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_[path] = entry;
+  }
+
+  /**
+   * \brief  Replace state file with state of this run
+   * \return true on success
+   */
+  bool save() const {
+    std::string temp_filename = filename_ + ".tmp";
+    {
+      std::ofstream file(temp_filename, std::ios::binary | std::ios::trunc);
+      file << ContentHash::to_hex(render_key_) << ' ' << ContentHash::to_hex(copy_key_) << '\n';
+      for (std::map<std::string, Entry>::const_iterator i = current_.begin(); i != current_.end(); i++) {
+        file << i->second.source_size << ' ' << i->second.source_time << ' '
+          << i->second.output_size << ' ' << i->second.output_time << ' ' << i->first << '\n';
+      }
+
+      if (!file.flush()) {
+        file.close();
+        remove(temp_filename.c_str());
+        return false;
+      }
+    }
+
+    if (!OutputFile::replace_file(temp_filename, filename_)) {
+      remove(temp_filename.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  const std::string& filename() const {
+    return filename_;
+  }
+
+private:
+  struct Entry {
+    uint64_t source_size;
+    int64_t source_time;
+    uint64_t output_size;
+    int64_t output_time;
+  };
+
+  std::string filename_;
+  uint64_t render_key_;
+  uint64_t copy_key_;
+  bool is_render_key_same_;
+  std::map<std::string, Entry> previous_;   // loaded, read-only during the walk
+  std::map<std::string, Entry> current_;
+  std::mutex mutex_;
+};
+
+#endif  // FILEREPLACE_TREE_STATE_H_
@@ -0,0 +1,38 @@
+@echo off
+
+set TEST_NAME=Compiled template
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+set TEMPLATE_FILE=test_template.tmp
+
+del /f /q %CUR_DIR%\%TEMPLATE_FILE% >NUL 2>NUL
+%TOOL% --compile %CUR_DIR%\input.txt %CUR_DIR%\%TEMPLATE_FILE% !(NAME) !(VENDOR)
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out1.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% --render %CUR_DIR%\%TEMPLATE_FILE% %CUR_DIR%\%OUT_FILE% !(NAME)=Mouse
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result1.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out2.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% --render %CUR_DIR%\%TEMPLATE_FILE% %CUR_DIR%\%OUT_FILE% !(NAME)=Mouse !(VENDOR)=Acme VENDOR=1
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result2.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,39 @@
+#!/bin/sh
+
+TEST_NAME="Compiled template"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+TEMPLATE_FILE=test_template.tmp
+
+rm -f "$CUR_DIR/$TEMPLATE_FILE"
+$TOOL --compile "$CUR_DIR/input.txt" "$CUR_DIR/$TEMPLATE_FILE" "!(NAME)" "!(VENDOR)"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL --render "$CUR_DIR/$TEMPLATE_FILE" "$CUR_DIR/$OUT_FILE" "!(NAME)=Mouse"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result1.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL --render "$CUR_DIR/$TEMPLATE_FILE" "$CUR_DIR/$OUT_FILE" "!(NAME)=Mouse" "!(VENDOR)=Acme" VENDOR=1
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result2.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,73 @@
+@echo off
+
+set TEST_NAME=Expand values
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Chained values are expanded once, with the result of passes
+
+set OUT_FILE=test_out1.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" !(MODEL)=M100 !(VENDOR)=Acme
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out2.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --expand "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" !(MODEL)=M100 !(VENDOR)=Acme
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Cycle of keys which the template does not use is not an error
+
+set OUT_FILE=test_out3.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --expand "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" !(MODEL)=M100 !(VENDOR)=Acme !(LOOP)=!(LOOP)
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Cycle of used keys is an error of values
+
+set OUT_FILE=test_out4.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --expand "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" !(MODEL)=!(TITLE) !(VENDOR)=Acme >NUL 2>NUL
+if NOT %ERRORLEVEL%==253 goto error
+
+rem Cycle of keys in pruned meta blocks or in meta headers is not rendered, so it is not an error
+
+set OUT_FILE=test_out5.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input2.txt %CUR_DIR%\%OUT_FILE% --expand "!(A)=!(A)!" !(B)=b
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result2.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out6.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input3.txt %CUR_DIR%\%OUT_FILE% --expand "!(A)=!(A)!" !(B)=b
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result2.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
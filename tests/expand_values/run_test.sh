@@ -0,0 +1,74 @@
+#!/bin/sh
+
+TEST_NAME="Expand values"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Chained values are expanded once, with the result of passes
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" "!(MODEL)=M100" "!(VENDOR)=Acme"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" --expand "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" "!(MODEL)=M100" "!(VENDOR)=Acme"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Cycle of keys which the template does not use is not an error
+
+OUT_FILE=test_out3.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" --expand "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" "!(MODEL)=M100" "!(VENDOR)=Acme" "!(LOOP)=!(LOOP)"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Cycle of used keys is an error of values
+
+OUT_FILE=test_out4.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" --expand "!(TITLE)=!(NAME) by !(VENDOR)" "!(NAME)=!(MODEL) mouse" "!(MODEL)=!(TITLE)" "!(VENDOR)=Acme" >/dev/null 2>&1
+[ $? -eq 253 ] || error
+
+# Cycle of keys in pruned meta blocks or in meta headers is not rendered, so it is not an error
+
+OUT_FILE=test_out5.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input2.txt" "$CUR_DIR/$OUT_FILE" --expand "!(A)=!(A)!" "!(B)=b"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result2.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out6.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input3.txt" "$CUR_DIR/$OUT_FILE" --expand "!(A)=!(A)!" "!(B)=b"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result2.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
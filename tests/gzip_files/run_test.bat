@@ -0,0 +1,70 @@
+@echo off
+
+set TEST_NAME=Gzip files
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem HAVE_ZLIB is set by the build with zlib, other builds do not decode gzip
+
+if NOT "%HAVE_ZLIB%"=="1" (
+  echo Skipped, built without zlib
+  echo Test PASSED
+  exit /b 0
+)
+
+rem Compressed template and @file value are decoded
+
+set OUT_FILE=test_out1.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt.gz %CUR_DIR%\%OUT_FILE% !(NAME)=Mouse !(VENDOR)=@%CUR_DIR%\vendor.txt.gz
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Output with .gz extension is compressed, it is decoded as template and as @file value
+
+set GZ_FILE=test_out2.tmp.gz
+
+del /f /q %CUR_DIR%\%GZ_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt.gz %CUR_DIR%\%GZ_FILE% !(NAME)=Mouse !(VENDOR)=@%CUR_DIR%\vendor.txt.gz
+if NOT %ERRORLEVEL%==0 goto error
+
+fc /b %CUR_DIR%\%GZ_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==1 goto error
+
+set OUT_FILE=test_out3.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\%GZ_FILE% %CUR_DIR%\%OUT_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out4.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\page.txt %CUR_DIR%\%OUT_FILE% !(PAGE)=@%CUR_DIR%\%GZ_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Truncated input is a processing error
+
+set OUT_FILE=test_out5.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\truncated.txt.gz %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+if NOT %ERRORLEVEL%==252 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,71 @@
+#!/bin/sh
+
+TEST_NAME="Gzip files"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# HAVE_ZLIB is set by the build with zlib, other builds do not decode gzip
+
+if [ "$HAVE_ZLIB" != "1" ]; then
+  echo "Skipped, built without zlib"
+  echo "Test PASSED"
+  exit 0
+fi
+
+# Compressed template and @file value are decoded
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt.gz" "$CUR_DIR/$OUT_FILE" "!(NAME)=Mouse" "!(VENDOR)=@$CUR_DIR/vendor.txt.gz"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Output with .gz extension is compressed, it is decoded as template and as @file value
+
+GZ_FILE=test_out2.tmp.gz
+
+rm -f "$CUR_DIR/$GZ_FILE"
+$TOOL "$CUR_DIR/input.txt.gz" "$CUR_DIR/$GZ_FILE" "!(NAME)=Mouse" "!(VENDOR)=@$CUR_DIR/vendor.txt.gz"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$GZ_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 1 ] || error
+
+OUT_FILE=test_out3.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/$GZ_FILE" "$CUR_DIR/$OUT_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out4.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/page.txt" "$CUR_DIR/$OUT_FILE" "!(PAGE)=@$CUR_DIR/$GZ_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Truncated input is a processing error
+
+OUT_FILE=test_out5.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/truncated.txt.gz" "$CUR_DIR/$OUT_FILE" >/dev/null 2>&1
+[ $? -eq 252 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,24 @@
+#!/bin/sh
+
+OUT_FILE=usbdev_test_out.tmp
+TEST_NAME=INF_Replace
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/usbdev.inx" "$CUR_DIR/$OUT_FILE" "!(DEVICES_NAMES)=@$CUR_DIR/devices_names.inx" "!(DEVICES_VID_PID)=@$CUR_DIR/devices_vidpid.inx"
+
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,23 @@
+@echo off
+
+set OUT_FILE=test_out.tmp
+set TEST_NAME=Lazy values
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% !(NAME)=@%CUR_DIR%\name.txt !(VENDOR)=@%CUR_DIR%\vendor.txt !(RELEASE)=@%CUR_DIR%\release.txt !(UNUSED)=@%CUR_DIR%\release.txt
+
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,31 @@
+@echo off
+
+set TEST_NAME=Manifest order
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Jobs are listed in reverse order of their dependencies: the first job takes
+rem output of the second one as infile, the second one output of the third one as value
+
+set OUT_FILE=test_out.tmp
+set MANIFEST=%CUR_DIR%\test_manifest.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% %CUR_DIR%\page_out.tmp %CUR_DIR%\header_out.tmp >NUL 2>NUL
+echo "%CUR_DIR%\page_out.tmp" "%CUR_DIR%\%OUT_FILE%" !(DATE)=2024-01-01> %MANIFEST%
+echo "%CUR_DIR%\page.txt" "%CUR_DIR%\page_out.tmp" "!(HEADER)=@%CUR_DIR%\header_out.tmp">> %MANIFEST%
+echo "%CUR_DIR%\header.txt" "%CUR_DIR%\header_out.tmp" !(NAME)=Mouse !(VENDOR)=Contoso>> %MANIFEST%
+
+%TOOL% --manifest %MANIFEST% --jobs=3 !(VENDOR)=Acme
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,32 @@
+#!/bin/sh
+
+TEST_NAME="Manifest order"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Jobs are listed in reverse order of their dependencies: the first job takes
+# output of the second one as infile, the second one output of the third one as value
+
+OUT_FILE=test_out.tmp
+MANIFEST="$CUR_DIR/test_manifest.tmp"
+
+rm -f "$CUR_DIR/$OUT_FILE" "$CUR_DIR/page_out.tmp" "$CUR_DIR/header_out.tmp"
+echo "\"$CUR_DIR/page_out.tmp\" \"$CUR_DIR/$OUT_FILE\" !(DATE)=2024-01-01" > "$MANIFEST"
+echo "\"$CUR_DIR/page.txt\" \"$CUR_DIR/page_out.tmp\" \"!(HEADER)=@$CUR_DIR/header_out.tmp\"" >> "$MANIFEST"
+echo "\"$CUR_DIR/header.txt\" \"$CUR_DIR/header_out.tmp\" !(NAME)=Mouse !(VENDOR)=Contoso" >> "$MANIFEST"
+
+$TOOL --manifest "$MANIFEST" --jobs=3 "!(VENDOR)=Acme"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
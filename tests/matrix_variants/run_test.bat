@@ -0,0 +1,35 @@
+@echo off
+
+set TEST_NAME=Matrix variants
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Each variant is rendered to the outfile pattern with NAME replaced by the variant name.
+rem Shared values override command line values, variant values override both
+
+del /f /q %CUR_DIR%\test_out_mouse.tmp %CUR_DIR%\test_out_keyboard.tmp >NUL 2>NUL
+%TOOL% --matrix %CUR_DIR%\input.txt %CUR_DIR%\variants.txt %CUR_DIR%\test_out_NAME.tmp !(VERSION)=1.0 !(VENDOR)=Other
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\test_out_mouse.tmp %CUR_DIR%\expected_mouse.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\test_out_keyboard.tmp %CUR_DIR%\expected_keyboard.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Expanded values and placeholders are not supported
+
+%TOOL% --matrix %CUR_DIR%\input.txt %CUR_DIR%\variants.txt %CUR_DIR%\test_out_NAME.tmp --expand !(VERSION)=1.0 >NUL 2>NUL
+if NOT %ERRORLEVEL%==254 goto error
+
+%TOOL% --matrix %CUR_DIR%\input.txt %CUR_DIR%\variants.txt %CUR_DIR%\test_out_NAME.tmp --placeholders !(VERSION)=1.0 >NUL 2>NUL
+if NOT %ERRORLEVEL%==254 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,36 @@
+#!/bin/sh
+
+TEST_NAME="Matrix variants"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Each variant is rendered to the outfile pattern with NAME replaced by the variant name.
+# Shared values override command line values, variant values override both
+
+rm -f "$CUR_DIR/test_out_mouse.tmp" "$CUR_DIR/test_out_keyboard.tmp"
+$TOOL --matrix "$CUR_DIR/input.txt" "$CUR_DIR/variants.txt" "$CUR_DIR/test_out_NAME.tmp" "!(VERSION)=1.0" "!(VENDOR)=Other"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/test_out_mouse.tmp" "$CUR_DIR/expected_mouse.txt"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/test_out_keyboard.tmp" "$CUR_DIR/expected_keyboard.txt"
+[ $? -eq 0 ] || error
+
+# Expanded values and placeholders are not supported
+
+$TOOL --matrix "$CUR_DIR/input.txt" "$CUR_DIR/variants.txt" "$CUR_DIR/test_out_NAME.tmp" --expand "!(VERSION)=1.0" >/dev/null 2>&1
+[ $? -eq 254 ] || error
+
+$TOOL --matrix "$CUR_DIR/input.txt" "$CUR_DIR/variants.txt" "$CUR_DIR/test_out_NAME.tmp" --placeholders "!(VERSION)=1.0" >/dev/null 2>&1
+[ $? -eq 254 ] || error
+
+echo "Test PASSED"
+exit 0
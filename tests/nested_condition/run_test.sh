@@ -0,0 +1,42 @@
+#!/bin/sh
+
+TEST_NAME="Nested conditions"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result1.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" OUTER=1
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result2.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out3.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" OUTER=1 INNER=1
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result3.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
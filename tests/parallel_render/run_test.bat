@@ -0,0 +1,68 @@
+@echo off
+
+set TEST_NAME=Parallel render
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Template of 3 MB is rendered by chunks, IFSET and IFCONTAINS blocks span all chunk bounds
+
+set BODY_FILE=test_body.tmp
+set IN_FILE=test_in.tmp
+
+copy /y /b %CUR_DIR%\body.txt %CUR_DIR%\%BODY_FILE% >NUL
+for /l %%i in (1,1,11) do (
+  copy /y /b %CUR_DIR%\%BODY_FILE%+%CUR_DIR%\%BODY_FILE% %CUR_DIR%\%BODY_FILE%2 >NUL
+  move /y %CUR_DIR%\%BODY_FILE%2 %CUR_DIR%\%BODY_FILE% >NUL
+)
+copy /y /b %CUR_DIR%\header.txt+%CUR_DIR%\%BODY_FILE%+%CUR_DIR%\footer.txt %CUR_DIR%\%IN_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Output of parallel rendering is the same as of one thread
+
+set OUT_FILE1=test_out1.tmp
+set OUT_FILE2=test_out2.tmp
+
+rem Blocks are kept
+
+del /f /q %CUR_DIR%\%OUT_FILE1% %CUR_DIR%\%OUT_FILE2% >NUL 2>NUL
+%TOOL% %CUR_DIR%\%IN_FILE% %CUR_DIR%\%OUT_FILE1% !(NAME)=Mouse !(MODEL)=M100 RELEASE=1 !(VENDOR)=Acme DETAILS=1
+if NOT %ERRORLEVEL%==0 goto error
+
+%TOOL% %CUR_DIR%\%IN_FILE% %CUR_DIR%\%OUT_FILE2% --parallel --jobs=4 !(NAME)=Mouse !(MODEL)=M100 RELEASE=1 !(VENDOR)=Acme DETAILS=1
+if NOT %ERRORLEVEL%==0 goto error
+
+fc /b %CUR_DIR%\%OUT_FILE1% %CUR_DIR%\%OUT_FILE2% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Inner IFCONTAINS block is removed
+
+del /f /q %CUR_DIR%\%OUT_FILE1% %CUR_DIR%\%OUT_FILE2% >NUL 2>NUL
+%TOOL% %CUR_DIR%\%IN_FILE% %CUR_DIR%\%OUT_FILE1% !(NAME)=Mouse !(MODEL)=M100 RELEASE=1 !(VENDOR)=Contoso
+if NOT %ERRORLEVEL%==0 goto error
+
+%TOOL% %CUR_DIR%\%IN_FILE% %CUR_DIR%\%OUT_FILE2% --parallel --jobs=4 !(NAME)=Mouse !(MODEL)=M100 RELEASE=1 !(VENDOR)=Contoso
+if NOT %ERRORLEVEL%==0 goto error
+
+fc /b %CUR_DIR%\%OUT_FILE1% %CUR_DIR%\%OUT_FILE2% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Outer IFSET block is removed
+
+del /f /q %CUR_DIR%\%OUT_FILE1% %CUR_DIR%\%OUT_FILE2% >NUL 2>NUL
+%TOOL% %CUR_DIR%\%IN_FILE% %CUR_DIR%\%OUT_FILE1% !(NAME)=Mouse !(MODEL)=M100 !(VENDOR)=Acme
+if NOT %ERRORLEVEL%==0 goto error
+
+%TOOL% %CUR_DIR%\%IN_FILE% %CUR_DIR%\%OUT_FILE2% --parallel --jobs=4 !(NAME)=Mouse !(MODEL)=M100 !(VENDOR)=Acme
+if NOT %ERRORLEVEL%==0 goto error
+
+fc /b %CUR_DIR%\%OUT_FILE1% %CUR_DIR%\%OUT_FILE2% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,69 @@
+#!/bin/sh
+
+TEST_NAME="Parallel render"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Template of 3 MB is rendered by chunks, IFSET and IFCONTAINS blocks span all chunk bounds
+
+BODY_FILE=test_body.tmp
+IN_FILE=test_in.tmp
+
+cp "$CUR_DIR/body.txt" "$CUR_DIR/$BODY_FILE"
+for i in 1 2 3 4 5 6 7 8 9 10 11; do
+  cat "$CUR_DIR/$BODY_FILE" "$CUR_DIR/$BODY_FILE" > "$CUR_DIR/${BODY_FILE}2"
+  mv -f "$CUR_DIR/${BODY_FILE}2" "$CUR_DIR/$BODY_FILE"
+done
+cat "$CUR_DIR/header.txt" "$CUR_DIR/$BODY_FILE" "$CUR_DIR/footer.txt" > "$CUR_DIR/$IN_FILE"
+[ $? -eq 0 ] || error
+
+# Output of parallel rendering is the same as of one thread
+
+OUT_FILE1=test_out1.tmp
+OUT_FILE2=test_out2.tmp
+
+# Blocks are kept
+
+rm -f "$CUR_DIR/$OUT_FILE1" "$CUR_DIR/$OUT_FILE2"
+$TOOL "$CUR_DIR/$IN_FILE" "$CUR_DIR/$OUT_FILE1" "!(NAME)=Mouse" "!(MODEL)=M100" RELEASE=1 "!(VENDOR)=Acme" DETAILS=1
+[ $? -eq 0 ] || error
+
+$TOOL "$CUR_DIR/$IN_FILE" "$CUR_DIR/$OUT_FILE2" --parallel --jobs=4 "!(NAME)=Mouse" "!(MODEL)=M100" RELEASE=1 "!(VENDOR)=Acme" DETAILS=1
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE1" "$CUR_DIR/$OUT_FILE2"
+[ $? -eq 0 ] || error
+
+# Inner IFCONTAINS block is removed
+
+rm -f "$CUR_DIR/$OUT_FILE1" "$CUR_DIR/$OUT_FILE2"
+$TOOL "$CUR_DIR/$IN_FILE" "$CUR_DIR/$OUT_FILE1" "!(NAME)=Mouse" "!(MODEL)=M100" RELEASE=1 "!(VENDOR)=Contoso"
+[ $? -eq 0 ] || error
+
+$TOOL "$CUR_DIR/$IN_FILE" "$CUR_DIR/$OUT_FILE2" --parallel --jobs=4 "!(NAME)=Mouse" "!(MODEL)=M100" RELEASE=1 "!(VENDOR)=Contoso"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE1" "$CUR_DIR/$OUT_FILE2"
+[ $? -eq 0 ] || error
+
+# Outer IFSET block is removed
+
+rm -f "$CUR_DIR/$OUT_FILE1" "$CUR_DIR/$OUT_FILE2"
+$TOOL "$CUR_DIR/$IN_FILE" "$CUR_DIR/$OUT_FILE1" "!(NAME)=Mouse" "!(MODEL)=M100" "!(VENDOR)=Acme"
+[ $? -eq 0 ] || error
+
+$TOOL "$CUR_DIR/$IN_FILE" "$CUR_DIR/$OUT_FILE2" --parallel --jobs=4 "!(NAME)=Mouse" "!(MODEL)=M100" "!(VENDOR)=Acme"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE1" "$CUR_DIR/$OUT_FILE2"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,42 @@
+@echo off
+
+set TEST_NAME=Placeholders
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Only keys of {NAME} form are replaced, other keys are used by meta conditions
+
+set OUT_FILE=test_out1.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --placeholders={NAME} {NAME}=@%CUR_DIR%\name.txt {MODEL}=M100 {VENDOR}=Acme !(NAME)=Other RELEASE=1
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Used keys are looked up in compiled table, entry with missing file is not used
+
+set TABLE_FILE=test_table.tmp
+
+del /f /q %CUR_DIR%\%TABLE_FILE% >NUL 2>NUL
+%TOOL% --compile-table %CUR_DIR%\values.txt %CUR_DIR%\%TABLE_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out2.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --placeholders={NAME} --table=%CUR_DIR%\%TABLE_FILE% !(NAME)=Other RELEASE=1
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
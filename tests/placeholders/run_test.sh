@@ -0,0 +1,43 @@
+#!/bin/sh
+
+TEST_NAME=Placeholders
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Only keys of {NAME} form are replaced, other keys are used by meta conditions
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--placeholders={NAME}" "{NAME}=@$CUR_DIR/name.txt" "{MODEL}=M100" "{VENDOR}=Acme" "!(NAME)=Other" RELEASE=1
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Used keys are looked up in compiled table, entry with missing file is not used
+
+TABLE_FILE=test_table.tmp
+
+rm -f "$CUR_DIR/$TABLE_FILE"
+$TOOL --compile-table "$CUR_DIR/values.txt" "$CUR_DIR/$TABLE_FILE"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--placeholders={NAME}" "--table=$CUR_DIR/$TABLE_FILE" "!(NAME)=Other" RELEASE=1
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,55 @@
+@echo off
+
+set TEST_NAME=Record replay
+set TOOL=filereplace.exe
+set REPLAY_TOOL=replay.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem replay is built only as a separate target
+
+if NOT exist %REPLAY_TOOL% (
+  echo Skipped, %REPLAY_TOOL% is not built
+  echo Test PASSED
+  exit /b 0
+)
+
+rem Record one <infile> <outfile> run and one compile and render run
+
+set CORPUS_DIR=test_corpus.tmp
+set OUT_FILE=test_out1.tmp
+set TEMPLATE_FILE=test_template.tmp
+
+rmdir /s /q %CUR_DIR%\%CORPUS_DIR% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --record=%CUR_DIR%\%CORPUS_DIR% !(NAME)=Mouse !(VENDOR)=@%CUR_DIR%\vendor.txt RELEASE=1
+if NOT %ERRORLEVEL%==0 goto error
+
+%TOOL% --compile %CUR_DIR%\input.txt %CUR_DIR%\%TEMPLATE_FILE% --record=%CUR_DIR%\%CORPUS_DIR% !(NAME) !(VENDOR)
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out2.tmp
+
+%TOOL% --render %CUR_DIR%\%TEMPLATE_FILE% %CUR_DIR%\%OUT_FILE% --record=%CUR_DIR%\%CORPUS_DIR% !(NAME)=Keyboard !(VENDOR)=Contoso
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Replay gives the recorded outputs
+
+%REPLAY_TOOL% %CUR_DIR%\%CORPUS_DIR% --repeats=1 >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Changed template in corpus gives other outputs
+
+for %%O in (%CUR_DIR%\%CORPUS_DIR%\objects\*) do (
+  fc /b %%O %CUR_DIR%\input.txt >NUL && echo Changed !(NAME)>>%%O
+)
+
+%REPLAY_TOOL% %CUR_DIR%\%CORPUS_DIR% --repeats=1 >NUL 2>NUL
+if NOT %ERRORLEVEL%==252 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
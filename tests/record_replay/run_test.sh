@@ -0,0 +1,56 @@
+#!/bin/sh
+
+TEST_NAME="Record replay"
+TOOL=./filereplace
+REPLAY_TOOL=./replay
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# replay is built only as a separate target
+
+if [ ! -x "$REPLAY_TOOL" ]; then
+  echo "Skipped, $REPLAY_TOOL is not built"
+  echo "Test PASSED"
+  exit 0
+fi
+
+# Record one <infile> <outfile> run and one compile and render run
+
+CORPUS_DIR=test_corpus.tmp
+OUT_FILE=test_out1.tmp
+TEMPLATE_FILE=test_template.tmp
+
+rm -rf "$CUR_DIR/$CORPUS_DIR"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--record=$CUR_DIR/$CORPUS_DIR" "!(NAME)=Mouse" "!(VENDOR)=@$CUR_DIR/vendor.txt" RELEASE=1
+[ $? -eq 0 ] || error
+
+$TOOL --compile "$CUR_DIR/input.txt" "$CUR_DIR/$TEMPLATE_FILE" "--record=$CUR_DIR/$CORPUS_DIR" "!(NAME)" "!(VENDOR)"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+$TOOL --render "$CUR_DIR/$TEMPLATE_FILE" "$CUR_DIR/$OUT_FILE" "--record=$CUR_DIR/$CORPUS_DIR" "!(NAME)=Keyboard" "!(VENDOR)=Contoso"
+[ $? -eq 0 ] || error
+
+# Replay gives the recorded outputs
+
+$REPLAY_TOOL "$CUR_DIR/$CORPUS_DIR" --repeats=1 >/dev/null
+[ $? -eq 0 ] || error
+
+# Changed template in corpus gives other outputs
+
+for OBJECT in "$CUR_DIR/$CORPUS_DIR"/objects/*; do
+  cmp -s "$OBJECT" "$CUR_DIR/input.txt" && echo "Changed !(NAME)" >> "$OBJECT"
+done
+
+$REPLAY_TOOL "$CUR_DIR/$CORPUS_DIR" --repeats=1 >/dev/null 2>&1
+[ $? -eq 252 ] || error
+
+echo "Test PASSED"
+exit 0
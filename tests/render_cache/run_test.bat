@@ -0,0 +1,71 @@
+@echo off
+
+set TEST_NAME=Render cache
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+set OUT_FILE=test_out.tmp
+set INFO_FILE=%CUR_DIR%\test_info.tmp
+set CACHE_DIR=%CUR_DIR%\test_cache.tmp
+set VENDOR_FILE=%CUR_DIR%\test_vendor.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+rmdir /s /q %CACHE_DIR% >NUL 2>NUL
+copy /y %CUR_DIR%\vendor1.txt %VENDOR_FILE% >NUL
+
+rem The first run renders the output
+
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --cache=%CACHE_DIR% !(NAME)=Mouse !(VENDOR)=@%VENDOR_FILE% > %INFO_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Render cache: 0 hits, 1 misses, hit rate 0%%" %INFO_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result1.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem The same run is a hit, the output is not written again
+
+for /f %%T in ('powershell -NoProfile -Command "(Get-Item '%CUR_DIR%\%OUT_FILE%').LastWriteTimeUtc.Ticks"') do set OUT_TIME1=%%T
+
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --cache=%CACHE_DIR% !(NAME)=Mouse !(VENDOR)=@%VENDOR_FILE% > %INFO_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Render cache: 1 hits, 0 misses, hit rate 100%%" %INFO_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+for /f %%T in ('powershell -NoProfile -Command "(Get-Item '%CUR_DIR%\%OUT_FILE%').LastWriteTimeUtc.Ticks"') do set OUT_TIME2=%%T
+if NOT "%OUT_TIME1%"=="%OUT_TIME2%" goto error
+
+rem Changed value is a miss
+
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --cache=%CACHE_DIR% !(NAME)=Keyboard !(VENDOR)=@%VENDOR_FILE% > %INFO_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Render cache: 0 hits, 1 misses, hit rate 0%%" %INFO_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result2.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Changed content of value file is a miss
+
+copy /y %CUR_DIR%\vendor2.txt %VENDOR_FILE% >NUL
+
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --cache=%CACHE_DIR% !(NAME)=Keyboard !(VENDOR)=@%VENDOR_FILE% > %INFO_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Render cache: 0 hits, 1 misses, hit rate 0%%" %INFO_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result3.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,73 @@
+#!/bin/sh
+
+TEST_NAME="Render cache"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+OUT_FILE=test_out.tmp
+INFO_FILE="$CUR_DIR/test_info.tmp"
+CACHE_DIR="$CUR_DIR/test_cache.tmp"
+VENDOR_FILE="$CUR_DIR/test_vendor.tmp"
+
+rm -f "$CUR_DIR/$OUT_FILE"
+rm -rf "$CACHE_DIR"
+cp -f "$CUR_DIR/vendor1.txt" "$VENDOR_FILE"
+
+# The first run renders the output
+
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--cache=$CACHE_DIR" "!(NAME)=Mouse" "!(VENDOR)=@$VENDOR_FILE" > "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Render cache: 0 hits, 1 misses, hit rate 0%' "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result1.txt"
+[ $? -eq 0 ] || error
+
+# The same run is a hit, the output is not written again
+
+TIME_FILE="$CUR_DIR/test_time.tmp"
+touch "$TIME_FILE"
+sleep 1
+
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--cache=$CACHE_DIR" "!(NAME)=Mouse" "!(VENDOR)=@$VENDOR_FILE" > "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Render cache: 1 hits, 0 misses, hit rate 100%' "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+[ "$CUR_DIR/$OUT_FILE" -nt "$TIME_FILE" ] && error
+
+# Changed value is a miss
+
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--cache=$CACHE_DIR" "!(NAME)=Keyboard" "!(VENDOR)=@$VENDOR_FILE" > "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Render cache: 0 hits, 1 misses, hit rate 0%' "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result2.txt"
+[ $? -eq 0 ] || error
+
+# Changed content of value file is a miss
+
+cp -f "$CUR_DIR/vendor2.txt" "$VENDOR_FILE"
+
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--cache=$CACHE_DIR" "!(NAME)=Keyboard" "!(VENDOR)=@$VENDOR_FILE" > "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Render cache: 0 hits, 1 misses, hit rate 0%' "$INFO_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result3.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
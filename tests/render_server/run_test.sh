@@ -0,0 +1,74 @@
+#!/bin/sh
+
+TEST_NAME="Render server"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+SOCKET_FILE="$CUR_DIR/test_socket.tmp"
+SERVER_PID=
+
+error() {
+  [ -n "$SERVER_PID" ] && kill $SERVER_PID 2>/dev/null
+  echo "Test FAILED"
+  exit 255
+}
+
+# Server values are shared by requests, request values are added to them
+
+rm -f "$SOCKET_FILE"
+$TOOL --serve "$SOCKET_FILE" --jobs=2 "!(VENDOR)=Acme" &
+SERVER_PID=$!
+
+WAIT_COUNT=0
+while [ ! -S "$SOCKET_FILE" ]; do
+  [ $WAIT_COUNT -lt 100 ] || error
+  WAIT_COUNT=$((WAIT_COUNT + 1))
+  sleep 0.1
+done
+
+TEMPLATE_FILE="$CUR_DIR/test_template.tmp"
+OUT_FILE=test_out1.tmp
+
+cp -f "$CUR_DIR/input1.txt" "$TEMPLATE_FILE"
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL --client "$SOCKET_FILE" "$TEMPLATE_FILE" "$CUR_DIR/$OUT_FILE" "!(NAME)=Mouse"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result1.txt"
+[ $? -eq 0 ] || error
+
+# Changed template is loaded again
+
+OUT_FILE=test_out2.tmp
+
+sleep 1
+cp -f "$CUR_DIR/input2.txt" "$TEMPLATE_FILE"
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL --client "$SOCKET_FILE" "$TEMPLATE_FILE" "$CUR_DIR/$OUT_FILE" "!(NAME)=Keyboard"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result2.txt"
+[ $? -eq 0 ] || error
+
+# Client exits with exit code of its request
+
+$TOOL --client "$SOCKET_FILE" "$CUR_DIR/missing.txt" "$CUR_DIR/$OUT_FILE" >/dev/null 2>&1
+[ $? -eq 252 ] || error
+
+# Removed template is not rendered from memory
+
+rm -f "$TEMPLATE_FILE"
+$TOOL --client "$SOCKET_FILE" "$TEMPLATE_FILE" "$CUR_DIR/$OUT_FILE" "!(NAME)=Keyboard" >/dev/null 2>&1
+[ $? -eq 252 ] || error
+
+# Server stops on SIGTERM
+
+kill $SERVER_PID
+wait $SERVER_PID
+[ $? -eq 0 ] || error
+SERVER_PID=
+
+echo "Test PASSED"
+exit 0
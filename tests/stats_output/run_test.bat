@@ -0,0 +1,46 @@
+@echo off
+
+set TEST_NAME=Stats output
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Value of !(NAME) has !(VENDOR) key, which is replaced by the second pass
+
+set OUT_FILE=test_out.tmp
+set STATS_FILE=%CUR_DIR%\test_stats.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% %STATS_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% --stats=%STATS_FILE% !(NAME)=@%CUR_DIR%\name.txt !(VENDOR)=Acme
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"\"cache_hit\": false," %STATS_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"\"passes\": 3," %STATS_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"\"replacements\": 3," %STATS_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+for %%P in (load values meta replace write) do (
+  findstr /C:"\"%%P\": { \"seconds\": " %STATS_FILE% >NUL
+  if errorlevel 1 goto error
+)
+
+findstr /C:"\"!(NAME)\": [1, 0, 0]" %STATS_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"\"!(VENDOR)\": [1, 1, 0]" %STATS_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,46 @@
+#!/bin/sh
+
+TEST_NAME="Stats output"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Value of !(NAME) has !(VENDOR) key, which is replaced by the second pass
+
+OUT_FILE=test_out.tmp
+STATS_FILE="$CUR_DIR/test_stats.tmp"
+
+rm -f "$CUR_DIR/$OUT_FILE" "$STATS_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "--stats=$STATS_FILE" "!(NAME)=@$CUR_DIR/name.txt" "!(VENDOR)=Acme"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+grep -qF '"cache_hit": false,' "$STATS_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF '"passes": 3,' "$STATS_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF '"replacements": 3,' "$STATS_FILE"
+[ $? -eq 0 ] || error
+
+for PHASE in load values meta replace write; do
+  grep -qF "\"$PHASE\": { \"seconds\": " "$STATS_FILE" || error
+done
+
+grep -qF '"!(NAME)": [1, 0, 0]' "$STATS_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF '"!(VENDOR)": [1, 1, 0]' "$STATS_FILE"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,45 @@
+@echo off
+
+set TEST_NAME=Stream window
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Key !(VENDOR) starts 4 bytes before the end of the first window
+
+set OUT_FILE=test_out1.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% -s --window-size=4096 !(VENDOR)=Acme !(NAME)=Mouse
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out2.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% - - --stream --window-size=4096 !(VENDOR)=Acme !(NAME)=Mouse < %CUR_DIR%\input.txt > %CUR_DIR%\%OUT_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Syntax error keeps the previous output
+
+set OUT_FILE=test_out3.tmp
+
+copy /y %CUR_DIR%\expected_result.txt %CUR_DIR%\%OUT_FILE% >NUL
+%TOOL% %CUR_DIR%\bad_input.txt %CUR_DIR%\%OUT_FILE% -s !(NAME)=Mouse >NUL 2>NUL
+if NOT %ERRORLEVEL%==252 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
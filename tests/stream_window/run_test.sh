@@ -0,0 +1,46 @@
+#!/bin/sh
+
+TEST_NAME="Stream window"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Key !(VENDOR) starts 4 bytes before the end of the first window
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" -s --window-size=4096 "!(VENDOR)=Acme" "!(NAME)=Mouse"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL - - --stream --window-size=4096 "!(VENDOR)=Acme" "!(NAME)=Mouse" < "$CUR_DIR/input.txt" > "$CUR_DIR/$OUT_FILE"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Syntax error keeps the previous output
+
+OUT_FILE=test_out3.tmp
+
+cp -f "$CUR_DIR/expected_result.txt" "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/bad_input.txt" "$CUR_DIR/$OUT_FILE" -s "!(NAME)=Mouse" >/dev/null 2>&1
+[ $? -eq 252 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
@@ -0,0 +1,53 @@
+@echo off
+
+set TEST_NAME=Table file
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Table overrides values before it, values after it override the table
+
+set OUT_FILE=test_out1.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% !(VENDOR)=Contoso --table=%CUR_DIR%\strings.txt !(TITLE)=Override
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Compiled table gives the same result
+
+set TABLE_FILE=test_table.tmp
+
+del /f /q %CUR_DIR%\%TABLE_FILE% >NUL 2>NUL
+%TOOL% --compile-table %CUR_DIR%\strings.txt %CUR_DIR%\%TABLE_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+set OUT_FILE=test_out2.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% !(VENDOR)=Contoso --table=%CUR_DIR%\%TABLE_FILE% !(TITLE)=Override
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Placeholder mode looks up only used keys in the compiled table
+
+set OUT_FILE=test_out3.tmp
+
+del /f /q %CUR_DIR%\%OUT_FILE% >NUL 2>NUL
+%TOOL% %CUR_DIR%\input.txt %CUR_DIR%\%OUT_FILE% !(VENDOR)=Contoso --table=%CUR_DIR%\%TABLE_FILE% !(TITLE)=Override --placeholders
+if NOT %ERRORLEVEL%==0 goto error
+
+fc %CUR_DIR%\%OUT_FILE% %CUR_DIR%\expected_result.txt >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
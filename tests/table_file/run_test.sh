@@ -0,0 +1,54 @@
+#!/bin/sh
+
+TEST_NAME="Table file"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Table overrides values before it, values after it override the table
+
+OUT_FILE=test_out1.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "!(VENDOR)=Contoso" "--table=$CUR_DIR/strings.txt" "!(TITLE)=Override"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Compiled table gives the same result
+
+TABLE_FILE=test_table.tmp
+
+rm -f "$CUR_DIR/$TABLE_FILE"
+$TOOL --compile-table "$CUR_DIR/strings.txt" "$CUR_DIR/$TABLE_FILE"
+[ $? -eq 0 ] || error
+
+OUT_FILE=test_out2.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "!(VENDOR)=Contoso" "--table=$CUR_DIR/$TABLE_FILE" "!(TITLE)=Override"
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+# Placeholder mode looks up only used keys in the compiled table
+
+OUT_FILE=test_out3.tmp
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" "!(VENDOR)=Contoso" "--table=$CUR_DIR/$TABLE_FILE" "!(TITLE)=Override" --placeholders
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
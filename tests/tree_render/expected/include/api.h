@@ -0,0 +1,2 @@
+// Mouse API by Acme
+#define VERSION "1.2"
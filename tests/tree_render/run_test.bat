@@ -0,0 +1,50 @@
+@echo off
+
+set TEST_NAME=Tree render
+set TOOL=filereplace.exe
+
+set CUR_DIR=%0\..
+echo [%TEST_NAME% TEST]
+
+rem Headers and docs are rendered, images and other files are copied
+
+set OUT_DIR=test_out.tmp
+set LOG_FILE=test_log.tmp
+set GLOBS=--include=*.h --include=docs/** --exclude=docs/images/**
+
+rmdir /s /q %CUR_DIR%\%OUT_DIR% >NUL 2>NUL
+%TOOL% --tree %CUR_DIR%\source %CUR_DIR%\%OUT_DIR% %GLOBS% !(NAME)=Mouse !(VENDOR)=Acme !(VERSION)=1.2 RELEASE=1 > %CUR_DIR%\%LOG_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Rendered 2, copied 2, skipped 0, failed 0 files" %CUR_DIR%\%LOG_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+for %%F in (readme.txt include\api.h docs\guide.txt docs\images\logo.txt) do (
+  fc %CUR_DIR%\%OUT_DIR%\%%F %CUR_DIR%\expected\%%F >NUL
+  if errorlevel 1 goto error
+)
+
+if NOT exist %CUR_DIR%\%OUT_DIR%\.filereplace-state goto error
+
+rem Second run skips files which are not changed, by state file
+
+%TOOL% --tree %CUR_DIR%\source %CUR_DIR%\%OUT_DIR% %GLOBS% !(NAME)=Mouse !(VENDOR)=Acme !(VERSION)=1.2 RELEASE=1 > %CUR_DIR%\%LOG_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Rendered 0, copied 0, skipped 4, failed 0 files" %CUR_DIR%\%LOG_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+rem Changed value renders files again, copied files are still skipped
+
+%TOOL% --tree %CUR_DIR%\source %CUR_DIR%\%OUT_DIR% %GLOBS% !(NAME)=Mouse !(VENDOR)=Acme !(VERSION)=1.3 RELEASE=1 > %CUR_DIR%\%LOG_FILE%
+if NOT %ERRORLEVEL%==0 goto error
+
+findstr /C:"Rendered 2, copied 0, skipped 2, failed 0 files" %CUR_DIR%\%LOG_FILE% >NUL
+if NOT %ERRORLEVEL%==0 goto error
+
+echo Test PASSED
+exit /b 0
+
+:error
+echo Test FAILED
+exit /b 255
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+TEST_NAME="Tree render"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+# Headers and docs are rendered, images and other files are copied
+
+OUT_DIR=test_out.tmp
+LOG_FILE=test_log.tmp
+
+rm -rf "$CUR_DIR/$OUT_DIR"
+$TOOL --tree "$CUR_DIR/source" "$CUR_DIR/$OUT_DIR" "--include=*.h" "--include=docs/**" "--exclude=docs/images/**" "!(NAME)=Mouse" "!(VENDOR)=Acme" "!(VERSION)=1.2" RELEASE=1 > "$CUR_DIR/$LOG_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Rendered 2, copied 2, skipped 0, failed 0 files' "$CUR_DIR/$LOG_FILE"
+[ $? -eq 0 ] || error
+
+for FILE in readme.txt include/api.h docs/guide.txt docs/images/logo.txt; do
+  cmp -s "$CUR_DIR/$OUT_DIR/$FILE" "$CUR_DIR/expected/$FILE" || error
+done
+
+[ -f "$CUR_DIR/$OUT_DIR/.filereplace-state" ] || error
+
+# Second run skips files which are not changed, by state file
+
+$TOOL --tree "$CUR_DIR/source" "$CUR_DIR/$OUT_DIR" "--include=*.h" "--include=docs/**" "--exclude=docs/images/**" "!(NAME)=Mouse" "!(VENDOR)=Acme" "!(VERSION)=1.2" RELEASE=1 > "$CUR_DIR/$LOG_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Rendered 0, copied 0, skipped 4, failed 0 files' "$CUR_DIR/$LOG_FILE"
+[ $? -eq 0 ] || error
+
+# Changed value renders files again, copied files are still skipped
+
+$TOOL --tree "$CUR_DIR/source" "$CUR_DIR/$OUT_DIR" "--include=*.h" "--include=docs/**" "--exclude=docs/images/**" "!(NAME)=Mouse" "!(VENDOR)=Acme" "!(VERSION)=1.3" RELEASE=1 > "$CUR_DIR/$LOG_FILE"
+[ $? -eq 0 ] || error
+
+grep -qF 'Rendered 2, copied 0, skipped 2, failed 0 files' "$CUR_DIR/$LOG_FILE"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
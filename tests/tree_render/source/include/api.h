@@ -0,0 +1,2 @@
+// !(NAME) API by !(VENDOR)
+#define VERSION "!(VERSION)"
@@ -0,0 +1,24 @@
+#!/bin/sh
+
+OUT_FILE=test_out.tmp
+TEST_NAME="UTF16 BE replace"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+error() {
+  echo "Test FAILED"
+  exit 255
+}
+
+rm -f "$CUR_DIR/$OUT_FILE"
+$TOOL "$CUR_DIR/input.txt" "$CUR_DIR/$OUT_FILE" -w "!(NAME)=Mouse" "!(VENDOR)=@$CUR_DIR/vendor.txt"
+
+[ $? -eq 0 ] || error
+
+cmp -s "$CUR_DIR/$OUT_FILE" "$CUR_DIR/expected_result.txt"
+[ $? -eq 0 ] || error
+
+echo "Test PASSED"
+exit 0
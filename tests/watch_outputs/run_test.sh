@@ -0,0 +1,64 @@
+#!/bin/sh
+
+TEST_NAME="Watch outputs"
+TOOL=./filereplace
+
+CUR_DIR=$(dirname "$0")
+echo "[$TEST_NAME TEST]"
+
+WATCH_PID=
+
+error() {
+  [ -n "$WATCH_PID" ] && kill $WATCH_PID 2>/dev/null
+  echo "Test FAILED"
+  exit 255
+}
+
+# Wait up to 10 seconds until output is the same as expected file
+wait_output() {
+  WAIT_COUNT=0
+  until cmp -s "$1" "$2"; do
+    [ $WAIT_COUNT -lt 100 ] || error
+    WAIT_COUNT=$((WAIT_COUNT + 1))
+    sleep 0.1
+  done
+}
+
+TEMPLATE_FILE="$CUR_DIR/test_template.tmp"
+VENDOR_FILE="$CUR_DIR/test_vendor.tmp"
+OUT_FILE="$CUR_DIR/test_out.tmp"
+EXPECTED_FILE="$CUR_DIR/test_expected.tmp"
+
+cp -f "$CUR_DIR/input.txt" "$TEMPLATE_FILE"
+cp -f "$CUR_DIR/vendor1.txt" "$VENDOR_FILE"
+rm -f "$OUT_FILE"
+
+# Output is rendered at start
+
+$TOOL "$TEMPLATE_FILE" "$OUT_FILE" --watch=50 "!(NAME)=Mouse" "!(VENDOR)=@$VENDOR_FILE" RELEASE=1 >/dev/null &
+WATCH_PID=$!
+
+printf 'Hello Mouse from Acme\r\n\r\nRelease of Mouse\r\n\r\n' > "$EXPECTED_FILE"
+wait_output "$OUT_FILE" "$EXPECTED_FILE"
+
+# Changed value file renders output again
+
+cp -f "$CUR_DIR/vendor2.txt" "$VENDOR_FILE"
+printf 'Hello Mouse from Contoso\r\n\r\nRelease of Mouse\r\n\r\n' > "$EXPECTED_FILE"
+wait_output "$OUT_FILE" "$EXPECTED_FILE"
+
+# Changed template renders output again
+
+printf 'Bye !(NAME) from !(VENDOR)\r\n' > "$TEMPLATE_FILE"
+printf 'Bye Mouse from Contoso\r\n' > "$EXPECTED_FILE"
+wait_output "$OUT_FILE" "$EXPECTED_FILE"
+
+# Watcher stops on SIGTERM
+
+kill $WATCH_PID
+wait $WATCH_PID
+[ $? -eq 0 ] || error
+WATCH_PID=
+
+echo "Test PASSED"
+exit 0